@@ -0,0 +1,313 @@
+/* Compares two result files written by rfxbench and exits with a non-zero
+ * status if any benchmark regressed significantly. */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <json.h>
+
+#define DEFAULT_THRESHOLD	5.0
+#define DEFAULT_ALPHA		0.05
+#define BOOTSTRAP_SAMPLES	2000
+#define MAX_RUNS		1000
+
+/* Exit status when a regression was found; errors use EXIT_FAILURE. */
+#define EXIT_REGRESSION		3
+
+struct runs
+{
+	double v[MAX_RUNS];
+	unsigned int n;
+};
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/* Median of n values, reordering them. */
+static double median(double *v, unsigned int n)
+{
+	qsort(v, n, sizeof(*v), cmp_double);
+	return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2.0;
+}
+
+/* xorshift32, so that confidence intervals are reproducible. */
+static unsigned long rnd(unsigned long *state)
+{
+	unsigned long x = *state;
+
+	x ^= (x << 13) & 0xFFFFFFFFUL;
+	x ^= x >> 17;
+	x ^= (x << 5) & 0xFFFFFFFFUL;
+	*state = x;
+	return x;
+}
+
+/* Two-sided p-value of the Mann-Whitney U test, using the normal
+ * approximation with tie and continuity corrections. */
+static double mann_whitney(const struct runs *a, const struct runs *b)
+{
+	struct rank
+	{
+		double v;
+		int group;
+	} r[2 * MAX_RUNS], tmp;
+	unsigned int n = a->n + b->n, i, j;
+	double ra = 0.0, ties = 0.0, u, mean, var, z;
+
+	for(i = 0; i < a->n; i++)
+	{
+		r[i].v = a->v[i];
+		r[i].group = 0;
+	}
+
+	for(i = 0; i < b->n; i++)
+	{
+		r[a->n + i].v = b->v[i];
+		r[a->n + i].group = 1;
+	}
+
+	/* Insertion sort; run counts are small. */
+	for(i = 1; i < n; i++)
+	{
+		tmp = r[i];
+		for(j = i; j > 0 && r[j - 1].v > tmp.v; j--)
+			r[j] = r[j - 1];
+		r[j] = tmp;
+	}
+
+	for(i = 0; i < n; i = j)
+	{
+		double t, avg;
+		unsigned int k;
+
+		for(j = i + 1; j < n && r[j].v == r[i].v; j++)
+			;
+
+		t = j - i;
+		avg = (i + 1 + j) / 2.0;
+		ties += t * t * t - t;
+
+		for(k = i; k < j; k++)
+		{
+			if(r[k].group == 0)
+				ra += avg;
+		}
+	}
+
+	u = ra - a->n * (a->n + 1) / 2.0;
+	mean = a->n * (double)b->n / 2.0;
+	var = a->n * (double)b->n / 12.0 *
+		((n + 1) - ties / ((double)n * (n - 1)));
+
+	if(var <= 0.0)
+		return 1.0;
+
+	z = (fabs(u - mean) - 0.5) / sqrt(var);
+	if(z < 0.0)
+		z = 0.0;
+
+	return erfc(z / sqrt(2.0));
+}
+
+/* Bootstrap 95% confidence interval of the ratio of medians new/base. */
+static void bootstrap(const struct runs *base, const struct runs *cur,
+		double *lo, double *hi)
+{
+	static double ratios[BOOTSTRAP_SAMPLES];
+	double rb[MAX_RUNS], rc[MAX_RUNS];
+	unsigned long state = 0x9E3779B9UL;
+	unsigned int s, i;
+
+	for(s = 0; s < BOOTSTRAP_SAMPLES; s++)
+	{
+		for(i = 0; i < base->n; i++)
+			rb[i] = base->v[rnd(&state) % base->n];
+
+		for(i = 0; i < cur->n; i++)
+			rc[i] = cur->v[rnd(&state) % cur->n];
+
+		ratios[s] = median(rc, cur->n) / median(rb, base->n);
+	}
+
+	qsort(ratios, BOOTSTRAP_SAMPLES, sizeof(*ratios), cmp_double);
+	*lo = ratios[(unsigned int)(BOOTSTRAP_SAMPLES * 0.025)];
+	*hi = ratios[(unsigned int)(BOOTSTRAP_SAMPLES * 0.975) - 1];
+}
+
+/* Reads the per-repetition timings of a benchmark. Returns 0 if there are
+ * none. */
+static int get_runs(const struct json *bench, struct runs *r)
+{
+	const struct json *a = json_get(bench, "runs_ns_per_sample");
+	const struct json *v;
+
+	r->n = 0;
+	if(a == NULL || a->type != JSON_ARRAY)
+		return 0;
+
+	for(v = a->child; v != NULL && r->n < MAX_RUNS; v = v->next)
+	{
+		if(v->type == JSON_NUMBER)
+			r->v[r->n++] = v->number;
+	}
+
+	return r->n > 0;
+}
+
+static const struct json *find_bench(const struct json *list, const char *name)
+{
+	const struct json *b;
+
+	for(b = list->child; b != NULL; b = b->next)
+	{
+		const struct json *n = json_get(b, "name");
+
+		if(n != NULL && n->type == JSON_STRING &&
+			strcmp(n->string, name) == 0)
+			return b;
+	}
+
+	return NULL;
+}
+
+/* Prints the compiler, build and render kernel of a result file. */
+static void print_source(const char *label, const struct json *result)
+{
+	const struct json *compiler = json_get(result, "compiler");
+	const struct json *build = json_get(result, "build");
+	const struct json *kernel = json_get(result, "kernel");
+
+	printf("%s: %s, %s build, %s kernel\n", label,
+		compiler != NULL && compiler->type == JSON_STRING ?
+			compiler->string : "unknown compiler",
+		build != NULL && build->type == JSON_STRING ?
+			build->string : "default",
+		kernel != NULL && kernel->type == JSON_STRING ?
+			kernel->string : "unknown");
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: benchcmp [options] base.json new.json\n"
+		"Options:\n"
+		"  --threshold PCT  Slowdown of the median treated as a regression"
+		" (default %.0f)\n"
+		"  --alpha P        Significance level of the Mann-Whitney U test"
+		" (default %.2f)\n"
+		"Exits with status %d if any benchmark is slower by more than the"
+		" threshold\nwith significance.\n",
+		DEFAULT_THRESHOLD, DEFAULT_ALPHA, EXIT_REGRESSION);
+}
+
+int main(int argc, char *argv[])
+{
+	double threshold = DEFAULT_THRESHOLD;
+	double alpha = DEFAULT_ALPHA;
+	struct json *base = NULL, *cur = NULL;
+	const struct json *base_list, *cur_list, *b;
+	unsigned int regressions = 0, compared = 0;
+	double log_ratios = 0.0;
+	int ret = EXIT_FAILURE;
+	int i;
+
+	for(i = 1; i < argc - 2; i++)
+	{
+		if(strcmp(argv[i], "--threshold") == 0 && i + 1 < argc - 2)
+			threshold = atof(argv[++i]);
+		else if(strcmp(argv[i], "--alpha") == 0 && i + 1 < argc - 2)
+			alpha = atof(argv[++i]);
+		else
+			break;
+	}
+
+	if(i != argc - 2)
+	{
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	base = json_load(argv[i]);
+	cur = json_load(argv[i + 1]);
+	if(base == NULL || cur == NULL)
+	{
+		fprintf(stderr, "Unable to read %s\n",
+			base == NULL ? argv[i] : argv[i + 1]);
+		goto out;
+	}
+
+	base_list = json_get(base, "benchmarks");
+	cur_list = json_get(cur, "benchmarks");
+	if(base_list == NULL || cur_list == NULL ||
+		base_list->type != JSON_ARRAY || cur_list->type != JSON_ARRAY)
+	{
+		fprintf(stderr, "Not a benchmark result file\n");
+		goto out;
+	}
+
+	print_source("base", base);
+	print_source("new", cur);
+	printf("%-20s %10s %10s %8s %19s %8s\n", "benchmark", "base ns",
+		"new ns", "delta", "95% CI", "p");
+
+	for(b = base_list->child; b != NULL; b = b->next)
+	{
+		static struct runs rb, rc;
+		const struct json *name = json_get(b, "name");
+		const struct json *c;
+		double mb, mc, delta, lo, hi, p;
+		const char *verdict = "";
+
+		if(name == NULL || name->type != JSON_STRING)
+			continue;
+
+		c = find_bench(cur_list, name->string);
+		if(c == NULL || !get_runs(b, &rb) || !get_runs(c, &rc))
+		{
+			printf("%-20s missing from one of the results\n",
+				name->string);
+			continue;
+		}
+
+		bootstrap(&rb, &rc, &lo, &hi);
+		p = mann_whitney(&rb, &rc);
+		mb = median(rb.v, rb.n);
+		mc = median(rc.v, rc.n);
+		delta = (mc / mb - 1.0) * 100.0;
+
+		if(p < alpha && delta > threshold)
+		{
+			verdict = "REGRESSION";
+			regressions++;
+		}
+		else if(p < alpha && delta < -threshold)
+			verdict = "improvement";
+
+		printf("%-20s %10.3f %10.3f %+7.1f%% [%+7.1f%%, %+7.1f%%] "
+			"%8.4f %s\n", name->string, mb, mc, delta,
+			(lo - 1.0) * 100.0, (hi - 1.0) * 100.0, p, verdict);
+		log_ratios += log(mc / mb);
+		compared++;
+	}
+
+	if(compared > 0)
+	{
+		double ratio = exp(log_ratios / compared);
+
+		printf("geometric mean: %+.1f%% time, %.3fx speed\n",
+			(ratio - 1.0) * 100.0, 1.0 / ratio);
+	}
+
+	printf("%u compared, %u regressed by more than %.1f%% (p < %.2f)\n",
+		compared, regressions, threshold, alpha);
+
+	ret = regressions > 0 ? EXIT_REGRESSION : EXIT_SUCCESS;
+
+out:
+	json_free(base);
+	json_free(cur);
+	return ret;
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "corpus.h"
+
+static const char *const wave_names[] = {
+	"square", "sawtooth", "sine", "noise"
+};
+
+static const struct
+{
+	const char *name;
+	unsigned int features;
+} feature_sets[] = {
+	{ "plain",	0 },
+	{ "lpf",	CORPUS_LPF },
+	{ "hpf",	CORPUS_HPF },
+	{ "phaser",	CORPUS_PHASER },
+	{ "vibrato",	CORPUS_VIBRATO },
+	{ "repeat",	CORPUS_REPEAT },
+	{ "arpeggio",	CORPUS_ARPEGGIO },
+	{ "all",	CORPUS_ALL }
+};
+
+#define WAVE_COUNT	(sizeof(wave_names) / sizeof(*wave_names))
+#define FEATURE_COUNT	(sizeof(feature_sets) / sizeof(*feature_sets))
+
+/* xorshift32; fixed width arithmetic so the corpus is the same everywhere. */
+static float rnd(unsigned long *state, float lo, float hi)
+{
+	unsigned long x = *state;
+
+	x ^= (x << 13) & 0xFFFFFFFFUL;
+	x ^= x >> 17;
+	x ^= (x << 5) & 0xFFFFFFFFUL;
+	*state = x;
+
+	return lo + (hi - lo) * (float)((x >> 8) & 0xFFFFFF) / 16777216.0f;
+}
+
+/* The preset classes follow every wave and feature combination. */
+#define FEATURE_CLASSES	(WAVE_COUNT * FEATURE_COUNT)
+
+unsigned int corpus_class_count(void)
+{
+	return FEATURE_CLASSES + WAVE_PRESET_COUNT;
+}
+
+void corpus_class(struct corpus_class *c, unsigned int cls)
+{
+	unsigned int w = cls / FEATURE_COUNT;
+	unsigned int f = cls % FEATURE_COUNT;
+
+	if(cls >= FEATURE_CLASSES)
+	{
+		snprintf(c->name, sizeof(c->name), "preset/%s",
+			GetWavePresetName((WavePreset)(cls - FEATURE_CLASSES)));
+		c->wave_type = -1;
+		c->features = 0;
+		return;
+	}
+
+	snprintf(c->name, sizeof(c->name), "%s/%s", wave_names[w],
+		feature_sets[f].name);
+	c->wave_type = (int)w;
+	c->features = feature_sets[f].features;
+}
+
+void corpus_effect(WaveParams *wp, unsigned int cls, unsigned int index,
+		unsigned long seed)
+{
+	struct corpus_class c;
+	unsigned long state;
+	unsigned int i;
+
+	corpus_class(&c, cls);
+
+	/* Mix class and index into the seed, then discard a few outputs so
+	 * neighbouring effects are uncorrelated. */
+	state = (seed * 2654435761UL + cls * 40503UL + index * 9973UL + 1) &
+		0xFFFFFFFFUL;
+	if(state == 0)
+		state = 1;
+
+	for(i = 0; i < 8; i++)
+		rnd(&state, 0.0f, 1.0f);
+
+	if(cls >= FEATURE_CLASSES)
+	{
+		GenerateWavePreset(wp, (WavePreset)(cls - FEATURE_CLASSES),
+			(unsigned int)state);
+		return;
+	}
+
+	memset(wp, 0, sizeof(*wp));
+
+	wp->randSeed = 1 + (int)rnd(&state, 0.0f, 30000.0f);
+	wp->waveTypeValue = c.wave_type;
+
+	wp->attackTimeValue = rnd(&state, 0.0f, 0.1f);
+	wp->sustainTimeValue = rnd(&state, 0.2f, 0.5f);
+	wp->sustainPunchValue = rnd(&state, 0.0f, 0.5f);
+	wp->decayTimeValue = rnd(&state, 0.2f, 0.6f);
+	wp->startFrequencyValue = rnd(&state, 0.2f, 0.7f);
+	wp->squareDutyValue = rnd(&state, 0.0f, 0.5f);
+	wp->lpfCutoffValue = 1.0f;
+
+	if(c.features & CORPUS_SLIDE)
+	{
+		wp->slideValue = rnd(&state, -0.2f, 0.2f);
+		wp->deltaSlideValue = rnd(&state, -0.05f, 0.05f);
+		wp->dutySweepValue = rnd(&state, -0.3f, 0.3f);
+	}
+
+	if(c.features & CORPUS_LPF)
+	{
+		wp->lpfCutoffValue = rnd(&state, 0.1f, 0.8f);
+		wp->lpfCutoffSweepValue = rnd(&state, -0.3f, 0.3f);
+		wp->lpfResonanceValue = rnd(&state, 0.0f, 0.8f);
+	}
+
+	if(c.features & CORPUS_HPF)
+	{
+		wp->hpfCutoffValue = rnd(&state, 0.05f, 0.5f);
+		wp->hpfCutoffSweepValue = rnd(&state, -0.3f, 0.3f);
+	}
+
+	if(c.features & CORPUS_PHASER)
+	{
+		wp->phaserOffsetValue = rnd(&state, -0.8f, 0.8f);
+		wp->phaserSweepValue = rnd(&state, -0.5f, 0.5f);
+	}
+
+	if(c.features & CORPUS_VIBRATO)
+	{
+		wp->vibratoDepthValue = rnd(&state, 0.1f, 0.6f);
+		wp->vibratoSpeedValue = rnd(&state, 0.2f, 0.8f);
+	}
+
+	if(c.features & CORPUS_REPEAT)
+		wp->repeatSpeedValue = rnd(&state, 0.3f, 0.8f);
+
+	if(c.features & CORPUS_ARPEGGIO)
+	{
+		wp->changeAmountValue = rnd(&state, -0.8f, 0.8f);
+		wp->changeSpeedValue = rnd(&state, 0.3f, 0.8f);
+	}
+}
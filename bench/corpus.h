@@ -0,0 +1,41 @@
+#pragma once
+
+#include <rfxgen.h>
+
+/* Optional synthesis features enabled in an effect class. */
+#define CORPUS_LPF	(1 << 0)
+#define CORPUS_HPF	(1 << 1)
+#define CORPUS_PHASER	(1 << 2)
+#define CORPUS_VIBRATO	(1 << 3)
+#define CORPUS_REPEAT	(1 << 4)
+#define CORPUS_ARPEGGIO	(1 << 5)
+#define CORPUS_SLIDE	(1 << 6)
+#define CORPUS_ALL	0x7F
+
+/* Effects generated for every class. */
+#define CORPUS_EFFECTS_PER_CLASS	8
+
+/* Default seed of the corpus; changing it changes every effect. */
+#define CORPUS_SEED	0x5EEDu
+
+struct corpus_class
+{
+	/* Name of the class, "wave/features", or "preset/name" for effects
+	 * made by GenerateWavePreset(). */
+	char name[32];
+	/* Wave type, or -1 for preset classes, which mix wave types. */
+	int wave_type;
+	/* CORPUS_* features, always 0 for preset classes. */
+	unsigned int features;
+};
+
+/* Returns the number of effect classes in the corpus. */
+unsigned int corpus_class_count(void);
+
+/* Describes effect class cls, which must be less than corpus_class_count(). */
+void corpus_class(struct corpus_class *c, unsigned int cls);
+
+/* Fills wp with effect number index of class cls. The same class, index and
+ * seed always produce the same parameters, on every platform. */
+void corpus_effect(WaveParams *wp, unsigned int cls, unsigned int index,
+		unsigned long seed);
@@ -0,0 +1,189 @@
+/* Required for syscall(). */
+#define _DEFAULT_SOURCE
+
+#include "counters.h"
+
+#ifdef __linux__
+# include <errno.h>
+# include <string.h>
+# include <unistd.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <linux/perf_event.h>
+#endif
+
+static const char *const names[COUNTER_EVENTS] = {
+	"cycles", "instructions", "branches", "branch_misses",
+	"cache_references", "cache_misses"
+};
+
+const char *counters_name(enum counter_event e)
+{
+	return names[e];
+}
+
+int counters_available(const struct counters *c, enum counter_event e)
+{
+	return c->fd[e] >= 0;
+}
+
+#ifdef __linux__
+
+static const unsigned long long configs[COUNTER_EVENTS] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+	PERF_COUNT_HW_BRANCH_MISSES,
+	PERF_COUNT_HW_CACHE_REFERENCES,
+	PERF_COUNT_HW_CACHE_MISSES
+};
+
+/* Layout of read() with the total time formats below. */
+struct reading
+{
+	unsigned long long value;
+	unsigned long long time_enabled;
+	unsigned long long time_running;
+};
+
+unsigned int counters_open(struct counters *c)
+{
+	unsigned int opened = 0;
+	int e, err = 0;
+
+	c->error = NULL;
+
+	for(e = 0; e < COUNTER_EVENTS; e++)
+	{
+		struct perf_event_attr attr;
+
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = configs[e];
+		attr.disabled = 1;
+		/* Counting user space only is permitted up to
+		 * perf_event_paranoid 2, the default of most distributions. */
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+			PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		c->fd[e] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+			0);
+
+		if(c->fd[e] >= 0)
+			opened++;
+		else if(err == 0)
+			err = errno;
+	}
+
+	if(opened == 0)
+	{
+		switch(err)
+		{
+		case EACCES:
+		case EPERM:
+			c->error = "not permitted, see "
+				"/proc/sys/kernel/perf_event_paranoid";
+			break;
+
+		case ENOENT:
+		case EOPNOTSUPP:
+			c->error = "not supported by this CPU or hypervisor";
+			break;
+
+		case ENOSYS:
+			c->error = "not supported by this kernel";
+			break;
+
+		default:
+			c->error = strerror(err);
+			break;
+		}
+	}
+
+	return opened;
+}
+
+void counters_close(struct counters *c)
+{
+	int e;
+
+	for(e = 0; e < COUNTER_EVENTS; e++)
+	{
+		if(c->fd[e] >= 0)
+			close(c->fd[e]);
+
+		c->fd[e] = -1;
+	}
+}
+
+void counters_start(struct counters *c)
+{
+	int e;
+
+	for(e = 0; e < COUNTER_EVENTS; e++)
+	{
+		if(c->fd[e] < 0)
+			continue;
+
+		ioctl(c->fd[e], PERF_EVENT_IOC_RESET, 0);
+		ioctl(c->fd[e], PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+void counters_stop(struct counters *c, double values[COUNTER_EVENTS])
+{
+	int e;
+
+	for(e = 0; e < COUNTER_EVENTS; e++)
+	{
+		if(c->fd[e] >= 0)
+			ioctl(c->fd[e], PERF_EVENT_IOC_DISABLE, 0);
+	}
+
+	for(e = 0; e < COUNTER_EVENTS; e++)
+	{
+		struct reading r;
+
+		if(c->fd[e] < 0 ||
+			read(c->fd[e], &r, sizeof(r)) != (ssize_t)sizeof(r) ||
+			r.time_running == 0)
+			continue;
+
+		values[e] += (double)r.value *
+			((double)r.time_enabled / (double)r.time_running);
+	}
+}
+
+#else
+
+unsigned int counters_open(struct counters *c)
+{
+	int e;
+
+	for(e = 0; e < COUNTER_EVENTS; e++)
+		c->fd[e] = -1;
+
+	c->error = "only supported on Linux";
+	return 0;
+}
+
+void counters_close(struct counters *c)
+{
+	(void)c;
+}
+
+void counters_start(struct counters *c)
+{
+	(void)c;
+}
+
+void counters_stop(struct counters *c, double values[COUNTER_EVENTS])
+{
+	(void)c;
+	(void)values;
+}
+
+#endif
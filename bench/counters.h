@@ -0,0 +1,43 @@
+#pragma once
+
+/* Hardware performance counters read around benchmark measurements. Uses
+ * perf_event_open() on Linux; elsewhere, or where the kernel does not permit
+ * it, no counter is available and measurements only record wall time. */
+
+enum counter_event
+{
+	COUNTER_CYCLES,
+	COUNTER_INSTRUCTIONS,
+	COUNTER_BRANCHES,
+	COUNTER_BRANCH_MISSES,
+	COUNTER_CACHE_REFERENCES,
+	COUNTER_CACHE_MISSES,
+	COUNTER_EVENTS
+};
+
+struct counters
+{
+	/* File descriptor of each event, or -1 if it is unavailable. */
+	int fd[COUNTER_EVENTS];
+	/* Why no event could be opened, if none could. */
+	const char *error;
+};
+
+/* Opens every event that can be counted for this process in user space.
+ * Returns the number of events opened; error describes why if it is 0. */
+unsigned int counters_open(struct counters *c);
+
+void counters_close(struct counters *c);
+
+/* Returns whether event e is being counted. */
+int counters_available(const struct counters *c, enum counter_event e);
+
+/* Resets and starts all opened events. */
+void counters_start(struct counters *c);
+
+/* Stops all opened events and adds their counts since counters_start() to
+ * values, scaled up if the kernel multiplexed them with other events. */
+void counters_stop(struct counters *c, double values[COUNTER_EVENTS]);
+
+/* Returns the JSON member name of event e, such as "branch_misses". */
+const char *counters_name(enum counter_event e);
@@ -0,0 +1,51 @@
+/* Times GenerateWave() on an effect whose filter state decays into the
+ * subnormal range. Build with and without RFXGEN_NO_FLUSH_DENORMALS to compare
+ * render times; see the bench-denormal target in the Makefile. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <rfxgen.h>
+
+#define RENDERS	20
+
+int main(void)
+{
+	WaveParams wp = { 0 };
+	clock_t start, end;
+	unsigned long samples = 0;
+	double secs;
+	int i;
+
+	/* Slow square wave through a low cutoff LPF and a strong HPF: between
+	 * edges both filters settle exponentially toward zero. */
+	wp.randSeed = 1;
+	wp.waveTypeValue = 0;
+	wp.sustainTimeValue = 1.0f;
+	wp.decayTimeValue = 1.0f;
+	wp.startFrequencyValue = 0.05f;
+	wp.lpfCutoffValue = 0.1f;
+	wp.hpfCutoffValue = 1.0f;
+
+	start = clock();
+
+	for(i = 0; i < RENDERS; i++)
+	{
+		Wave w = GenerateWave(&wp, NULL);
+		samples += w.sampleCount;
+		UnloadWave(w, NULL);
+	}
+
+	end = clock();
+	secs = (double)(end - start) / CLOCKS_PER_SEC;
+
+	printf("%s: %d renders, %lu samples, %.3f s, %.1f ns/sample\n",
+#ifdef RFXGEN_NO_FLUSH_DENORMALS
+		"denormals",
+#else
+		"flushed",
+#endif
+		RENDERS, samples, secs, secs * 1e9 / samples);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,1295 @@
+/* Renders the effect corpus and compares the output against stored golden
+ * hashes, so that optimizations cannot silently change how effects sound.
+ * Exact renderers must reproduce the golden hashes bit for bit. Approximate
+ * renderers are compared sample by sample against the reference renderer,
+ * which is itself checked against the hashes, using a maximum absolute error
+ * and a minimum signal-to-noise ratio. Every render kernel the CPU supports is
+ * checked as an exact renderer, including its sample conversion, as is
+ * rendering in blocks with LoadWaveGenerator() and rendering several effects
+ * side by side with GenerateWaves() on every kernel. Playing an effect through
+ * the real-time mixer must give the samples of the reference, but for the
+ * sign of zeros. WAV data exported to memory must match, byte for byte, the
+ * file written from the reference wave, and so must a few effects streamed
+ * through a shared memory ring. A ring with a corrupt header must be refused
+ * by its consumer. With --server, effects are instead rendered by a running
+ * render daemon and compared with the golden hashes. */
+#define _POSIX_C_SOURCE 200112L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+# include <errno.h>
+# include <time.h>
+# include <unistd.h>
+# include <sys/socket.h>
+# include <sys/un.h>
+#endif
+
+#include <dr_wav.h>
+#include <rfxgen.h>
+#include <ring.h>
+#include <server.h>
+#include <thread.h>
+#include "corpus.h"
+
+#define DEFAULT_MAX_ERROR	1e-4
+#define DEFAULT_MIN_SNR		60.0
+
+/* Identifies an effect in the golden file, "class index". */
+#define NAME_LEN		48
+
+/* Renderers, the reference first. */
+#define MAX_RENDERERS		16
+
+/* Gain applied when comparing sample conversion, so that clamping is
+ * exercised too. */
+#define CONVERT_GAIN		1.5f
+
+/* How the output of a renderer must match: the golden hashes bit for bit,
+ * the samples of the reference renderer in value, so that a zero may differ
+ * in sign, or those samples within the error and signal-to-noise limits. */
+enum match
+{
+	MATCH_CLOSE,
+	MATCH_HASH,
+	MATCH_VALUE
+};
+
+struct renderer
+{
+	const char *name;
+	Wave (*render)(WaveParams *wp, WaveStats *stats);
+	/* Render kernel selected before rendering, or NULL for any. */
+	const char *kernel;
+	enum match match;
+};
+
+struct golden
+{
+	char name[NAME_LEN];
+	unsigned int index;
+	unsigned int samples;
+	unsigned long long checksum;
+};
+
+static Wave render_reference(WaveParams *wp, WaveStats *stats)
+{
+	return GenerateWaveEx(wp, NULL, stats, NULL, NULL);
+}
+
+/* Samples rendered per call by render_blocks(), not a divisor of the overview
+ * bin or conversion block sizes. */
+#define RENDER_BLOCK		1000
+
+/* Renders with the block API of the library. */
+static Wave render_blocks(WaveParams *wp, WaveStats *stats)
+{
+	const unsigned int max = MAX_WAVE_LENGTH_SECONDS * WAVE_SAMPLE_RATE;
+	WaveGenerator *gen = LoadWaveGenerator(wp, NULL);
+	Wave w = { 0, WAVE_SAMPLE_RATE, 32, 1, NULL };
+	float *buf = malloc(max * sizeof(float));
+	unsigned int n;
+
+	if(gen == NULL || buf == NULL)
+	{
+		free(buf);
+		if(gen != NULL)
+			UnloadWaveGenerator(gen, NULL);
+
+		ResetWaveStats(stats);
+		return w;
+	}
+
+	do
+	{
+		n = RenderWaveBlock(gen, buf + w.sampleCount, RENDER_BLOCK);
+		w.sampleCount += n;
+	} while(n == RENDER_BLOCK);
+
+	GetWaveGeneratorStats(gen, stats);
+	UnloadWaveGenerator(gen, NULL);
+	w.data = buf;
+	return w;
+}
+
+/* Mixes the effect as the only voice of a mixer into buf until the voice
+ * stops, in blocks of RENDER_BLOCK samples up to sample single_from and of one
+ * sample after it. Returns the number of samples mixed, and stores the first
+ * sample of the block the voice stopped in in last, or returns 0 on error. */
+static unsigned int mix_voice(const WaveParams *wp, float *buf,
+		unsigned int single_from, unsigned int *last)
+{
+	const unsigned int max = MAX_WAVE_LENGTH_SECONDS * WAVE_SAMPLE_RATE;
+	WaveMixer *mixer = LoadWaveMixer(1, 1, NULL);
+	unsigned int mixed = 0;
+	WaveMixerStats ms;
+
+	if(mixer == NULL || !TriggerWaveVoice(mixer, wp, 1.0f))
+	{
+		UnloadWaveMixer(mixer, NULL);
+		return 0;
+	}
+
+	do
+	{
+		unsigned int block = mixed < single_from ? RENDER_BLOCK : 1;
+
+		*last = mixed;
+		MixWaveBlock(mixer, buf + mixed, block);
+		mixed += block;
+		GetWaveMixerStats(mixer, &ms);
+	} while(ms.activeVoices > 0 && mixed <= max);
+
+	UnloadWaveMixer(mixer, NULL);
+	return ms.activeVoices > 0 ? 0 : mixed;
+}
+
+/* Plays the effect as the only voice of a real-time mixer. A voice at volume
+ * 1 is added to silence, so its samples keep their values, though a negative
+ * zero becomes a positive one. The voice stops in the block that runs past its
+ * last sample, so the effect is mixed again one sample at a time through that
+ * block to find its length, and the rest of the first mix must be silent. */
+static Wave render_mixer(WaveParams *wp, WaveStats *stats)
+{
+	const unsigned int max = MAX_WAVE_LENGTH_SECONDS * WAVE_SAMPLE_RATE;
+	Wave w = { 0, WAVE_SAMPLE_RATE, 32, 1, NULL };
+	float *buf = malloc((max + RENDER_BLOCK) * sizeof(float));
+	float *again = malloc((max + RENDER_BLOCK) * sizeof(float));
+	unsigned int mixed = 0, length = 0, last, i;
+
+	ResetWaveStats(stats);
+
+	if(buf != NULL && again != NULL)
+		mixed = mix_voice(wp, buf, max + 1, &last);
+
+	/* The voice stopped in the single sample block starting at its end. */
+	if(mixed > 0 && mix_voice(wp, again, last, &length) > 0 &&
+		memcmp(buf, again, length * sizeof(float)) == 0)
+	{
+		for(i = length; i < mixed && buf[i] == 0.0f; i++)
+			;
+
+		if(i < mixed)
+			length = 0;
+	}
+	else
+		length = 0;
+
+	free(again);
+	w.data = buf;
+	w.sampleCount = length;
+	stats->sampleCount = length;
+	return w;
+}
+
+/* Waves rendered together by render_lanes(), more than fit in the lanes. */
+#define LANE_WAVES		(WAVE_LANES + WAVE_LANES / 2)
+
+/* Renders the effect last of a batch of variations of it with GenerateWaves(),
+ * so that it starts in a lane another wave ended in while the other lanes are
+ * halfway through theirs. */
+static Wave render_lanes(WaveParams *wp, WaveStats *stats)
+{
+	WaveParams batch[LANE_WAVES];
+	WaveStats batch_stats[LANE_WAVES];
+	Wave waves[LANE_WAVES];
+	unsigned int i;
+	int generated;
+
+	for(i = 0; i < LANE_WAVES - 1; i++)
+	{
+		batch[i] = *wp;
+		MutateWaveParams(&batch[i], 0.3f, i + 1);
+		batch[i].waveTypeValue = (int)(i % 4);
+	}
+
+	batch[LANE_WAVES - 1] = *wp;
+	generated = GenerateWaves(batch, LANE_WAVES, waves, batch_stats, NULL);
+
+	for(i = 0; i < LANE_WAVES - 1; i++)
+		UnloadWave(waves[i], NULL);
+
+	/* An empty wave fails the comparison. */
+	if(generated < LANE_WAVES)
+	{
+		UnloadWave(waves[LANE_WAVES - 1], NULL);
+		memset(&waves[LANE_WAVES - 1], 0, sizeof(Wave));
+	}
+
+	*stats = batch_stats[LANE_WAVES - 1];
+	return waves[LANE_WAVES - 1];
+}
+
+static struct renderer renderers[MAX_RENDERERS] = {
+	{ "reference", render_reference, "generic", MATCH_HASH },
+	{ "blocks", render_blocks, "generic", MATCH_HASH },
+	{ "mixer", render_mixer, "generic", MATCH_VALUE },
+	{ "lanes", render_lanes, "generic", MATCH_HASH }
+};
+
+static unsigned int renderer_count = 4;
+
+/* Names of the lane renderers of other kernels, "lanes/kernel". */
+static char lane_names[MAX_RENDERERS][NAME_LEN];
+
+/* Adds a renderer and a lane renderer for each render kernel the CPU
+ * supports, besides the one of the reference. */
+static void add_kernel_renderers(void)
+{
+	int k;
+
+	for(k = 0; k < GetWaveKernelCount(); k++)
+	{
+		const char *name = GetWaveKernelName(k);
+
+		if(strcmp(name, renderers[0].kernel) == 0 ||
+			!IsWaveKernelSupported(name) ||
+			renderer_count + 2 > MAX_RENDERERS)
+			continue;
+
+		renderers[renderer_count].name = name;
+		renderers[renderer_count].render = render_reference;
+		renderers[renderer_count].kernel = name;
+		renderers[renderer_count].match = MATCH_HASH;
+		renderer_count++;
+
+		sprintf(lane_names[renderer_count], "lanes/%.32s", name);
+		renderers[renderer_count].name = lane_names[renderer_count];
+		renderers[renderer_count].render = render_lanes;
+		renderers[renderer_count].kernel = name;
+		renderers[renderer_count].match = MATCH_HASH;
+		renderer_count++;
+	}
+}
+
+/* Checks that sample conversion with kernel gives the same integer samples as
+ * with the kernel of the reference. Returns 0 if any differ. */
+static int compare_conversion(const Wave *w, const char *kernel)
+{
+	static unsigned char a[MAX_WAVE_LENGTH_SECONDS * WAVE_SAMPLE_RATE * 3];
+	static unsigned char b[MAX_WAVE_LENGTH_SECONDS * WAVE_SAMPLE_RATE * 3];
+	static const unsigned int sizes[] = { 8, 16, 24 };
+	unsigned int i, len;
+
+	for(i = 0; i < sizeof(sizes) / sizeof(*sizes); i++)
+	{
+		SetWaveKernel(renderers[0].kernel);
+		len = ConvertWaveSamples(a, w->data, w->sampleCount, sizes[i],
+			CONVERT_GAIN);
+		SetWaveKernel(kernel);
+		ConvertWaveSamples(b, w->data, w->sampleCount, sizes[i],
+			CONVERT_GAIN);
+
+		if(memcmp(a, b, len) != 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+/* Samples of the NaN conversion check, more than the widest kernel converts at
+ * once, so that NaN reaches both its vector loop and its scalar tail. */
+#define NAN_SAMPLES	37
+
+/* Checks that every kernel converts NaN samples as it converts -1, which the
+ * vector kernels clamp them to, by converting a ramp with NaN in some places
+ * and the same ramp with -1 in those places. Returns the failures. */
+static unsigned int check_nan_conversion(void)
+{
+	static const unsigned int sizes[] = { 8, 16, 24 };
+	static const unsigned int nans[] = { 0, 7, 20, 33, 36 };
+	float with_nan[NAN_SAMPLES], with_min[NAN_SAMPLES];
+	unsigned char a[NAN_SAMPLES * 3], b[NAN_SAMPLES * 3];
+	unsigned int failures = 0, i, len;
+	int k;
+
+	for(i = 0; i < NAN_SAMPLES; i++)
+		with_nan[i] = with_min[i] = (float)i / NAN_SAMPLES * 2.0f - 1.0f;
+
+	for(i = 0; i < sizeof(nans) / sizeof(*nans); i++)
+	{
+		with_nan[nans[i]] = NAN;
+		with_min[nans[i]] = -1.0f;
+	}
+
+	for(k = 0; k < GetWaveKernelCount(); k++)
+	{
+		const char *name = GetWaveKernelName(k);
+
+		if(!IsWaveKernelSupported(name))
+			continue;
+
+		SetWaveKernel(name);
+		for(i = 0; i < sizeof(sizes) / sizeof(*sizes); i++)
+		{
+			len = ConvertWaveSamples(a, with_nan, NAN_SAMPLES,
+				sizes[i], CONVERT_GAIN);
+			ConvertWaveSamples(b, with_min, NAN_SAMPLES, sizes[i],
+				CONVERT_GAIN);
+
+			if(memcmp(a, b, len) != 0)
+			{
+				printf("FAIL %-10s NaN converted to %u bits "
+					"differs from -1\n", name, sizes[i]);
+				failures++;
+			}
+		}
+	}
+
+	return failures;
+}
+
+static size_t write_file(void *f, const void *data, size_t len)
+{
+	return fwrite(data, 1, len, f);
+}
+
+static drwav_bool32 seek_file(void *f, int offset, drwav_seek_origin origin)
+{
+	return fseek(f, offset, origin == drwav_seek_origin_current ?
+		SEEK_CUR : SEEK_SET) == 0;
+}
+
+/* Writes wave as a WAV file in format, the way rfx2wav does, and reads the
+ * file back. Returns its size, or 0 on failure. */
+static size_t write_wav_file(const Wave *w, const WaveStats *stats,
+	const WaveFormat *format, unsigned char *data, size_t size)
+{
+	static unsigned char block[4096 * 4];
+	drwav_data_format df;
+	drwav wav;
+	float gain = 1.0f;
+	unsigned int i, n;
+	size_t len;
+	FILE *f = tmpfile();
+
+	if(f == NULL)
+		return 0;
+
+	if(format->normalize == WAVE_NORMALIZE_PEAK)
+		gain = GetWavePeakGain(stats, format->targetDb);
+	else if(format->normalize == WAVE_NORMALIZE_RMS)
+		gain = GetWaveRmsGain(stats, format->targetDb);
+
+	df.container = drwav_container_riff;
+	df.format = format->sampleSize == 32 ?
+		DR_WAVE_FORMAT_IEEE_FLOAT : DR_WAVE_FORMAT_PCM;
+	df.channels = w->channels;
+	df.sampleRate = w->sampleRate;
+	df.bitsPerSample = format->sampleSize;
+
+	if(!drwav_init_write(&wav, &df, write_file, seek_file, f, NULL))
+	{
+		fclose(f);
+		return 0;
+	}
+
+	for(i = 0; i < w->sampleCount; i += n)
+	{
+		n = w->sampleCount - i < 4096 ? w->sampleCount - i : 4096;
+		ConvertWaveSamples(block, (const float *)w->data + i, n,
+			format->sampleSize, gain);
+		drwav_write_pcm_frames(&wav, n, block);
+	}
+
+	drwav_uninit(&wav);
+
+	rewind(f);
+	len = fread(data, 1, size, f);
+	fclose(f);
+	return len;
+}
+
+/* Checks that ExportWaveToMemory() and ExportWaveToBuffer() give the bytes
+ * of the WAV file written from ref, for a few formats. Returns 0 if any
+ * differ. */
+static int compare_export(const WaveParams *base, const Wave *ref,
+	const WaveStats *stats)
+{
+	static unsigned char file[MAX_WAVE_LENGTH_SECONDS * WAVE_SAMPLE_RATE * 4 +
+		1024];
+	static unsigned char buffer[sizeof(file)];
+	static const WaveFormat formats[] = {
+		{ 32, WAVE_NORMALIZE_NONE, 0.0f },
+		{ 16, WAVE_NORMALIZE_PEAK, -1.0f },
+		{ 24, WAVE_NORMALIZE_RMS, -12.0f }
+	};
+	unsigned int i;
+
+	for(i = 0; i < sizeof(formats) / sizeof(*formats); i++)
+	{
+		size_t len = write_wav_file(ref, stats, &formats[i], file,
+			sizeof(file));
+		size_t size = 0;
+		unsigned char *data;
+		int ok;
+
+		data = ExportWaveToMemory(base, formats[i], NULL, &size);
+		ok = data != NULL && len > 0 && size == len &&
+			memcmp(data, file, len) == 0;
+		UnloadWaveData(data, NULL);
+
+		/* Too small a buffer only reports the size needed. */
+		ok = ok && ExportWaveToBuffer(base, formats[i], NULL, buffer,
+			len / 2) == len;
+		ok = ok && ExportWaveToBuffer(base, formats[i], NULL, buffer,
+			sizeof(buffer)) == len && memcmp(buffer, file, len) == 0;
+
+		if(!ok)
+			return 0;
+	}
+
+	return 1;
+}
+
+/* Effects at the edges of the parameter ranges, in addition to the corpus. */
+static void edge_effect(WaveParams *wp, unsigned int index)
+{
+	memset(wp, 0, sizeof(*wp));
+	wp->randSeed = 1;
+	wp->sustainTimeValue = 0.3f;
+	wp->decayTimeValue = 0.4f;
+	wp->startFrequencyValue = 0.3f;
+	wp->lpfCutoffValue = 1.0f;
+
+	switch(index)
+	{
+	case 0: /* Longest envelope. */
+		wp->attackTimeValue = 1.0f;
+		wp->sustainTimeValue = 1.0f;
+		wp->decayTimeValue = 1.0f;
+		break;
+
+	case 1: /* Unseeded noise. */
+		wp->randSeed = 0;
+		wp->waveTypeValue = 3;
+		break;
+
+	case 2: /* Negative seed. */
+		wp->randSeed = -12345;
+		wp->waveTypeValue = 3;
+		break;
+
+	case 3: /* Falling pitch cut off by the minimum frequency. */
+		wp->slideValue = -0.4f;
+		wp->deltaSlideValue = -0.5f;
+		wp->minFrequencyValue = 0.2f;
+		break;
+
+	case 4: /* Highest pitch, period clamped. */
+		wp->startFrequencyValue = 1.0f;
+		wp->waveTypeValue = 1;
+		break;
+
+	case 5: /* Maximum resonance and filter sweeps. */
+		wp->waveTypeValue = 1;
+		wp->lpfCutoffValue = 0.3f;
+		wp->lpfResonanceValue = 1.0f;
+		wp->lpfCutoffSweepValue = 1.0f;
+		wp->hpfCutoffValue = 0.2f;
+		wp->hpfCutoffSweepValue = -1.0f;
+		break;
+
+	case 6: /* Filter state decaying into the subnormal range. */
+		wp->sustainTimeValue = 1.0f;
+		wp->decayTimeValue = 1.0f;
+		wp->startFrequencyValue = 0.05f;
+		wp->lpfCutoffValue = 0.1f;
+		wp->hpfCutoffValue = 1.0f;
+		break;
+
+	case 7: /* Loud, clipping square with full punch. */
+		wp->sustainPunchValue = 1.0f;
+		wp->squareDutyValue = 1.0f;
+		wp->dutySweepValue = -1.0f;
+		wp->phaserOffsetValue = 0.0f;
+		wp->phaserSweepValue = 1.0f;
+		break;
+	}
+}
+
+#define EDGE_EFFECTS	8
+
+/* Returns the total number of effects checked. */
+static unsigned int effect_count(void)
+{
+	return corpus_class_count() * CORPUS_EFFECTS_PER_CLASS + EDGE_EFFECTS;
+}
+
+/* Fills in effect number n and its name. */
+static void get_effect(unsigned int n, WaveParams *wp, char *name,
+		unsigned int *index)
+{
+	unsigned int corpus = corpus_class_count() * CORPUS_EFFECTS_PER_CLASS;
+
+	if(n < corpus)
+	{
+		struct corpus_class c;
+
+		corpus_class(&c, n / CORPUS_EFFECTS_PER_CLASS);
+		snprintf(name, NAME_LEN, "%s", c.name);
+		*index = n % CORPUS_EFFECTS_PER_CLASS;
+		corpus_effect(wp, n / CORPUS_EFFECTS_PER_CLASS, *index,
+			CORPUS_SEED);
+	}
+	else
+	{
+		snprintf(name, NAME_LEN, "edge");
+		*index = n - corpus;
+		edge_effect(wp, *index);
+	}
+}
+
+/* Reads the golden file into an array of effect_count() entries. */
+static int load_golden(const char *path, struct golden *g, unsigned int count)
+{
+	FILE *f = fopen(path, "r");
+	char line[256];
+	unsigned int n = 0;
+
+	if(f == NULL)
+	{
+		fprintf(stderr, "Unable to open %s\n", path);
+		return 0;
+	}
+
+	while(fgets(line, sizeof(line), f) != NULL)
+	{
+		if(line[0] == '#' || line[0] == '\n')
+			continue;
+
+		if(n == count || sscanf(line, "%47s %u %u %llx", g[n].name,
+			&g[n].index, &g[n].samples, &g[n].checksum) != 4)
+		{
+			fprintf(stderr, "%s: unexpected line %u\n", path, n + 1);
+			fclose(f);
+			return 0;
+		}
+
+		n++;
+	}
+
+	fclose(f);
+
+	if(n != count)
+	{
+		fprintf(stderr, "%s: expected %u effects, found %u\n", path,
+			count, n);
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Compares two renders sample by sample. Returns the SNR of b relative to a
+ * in dB and stores the largest absolute difference in max_err. */
+static double compare_waves(const Wave *a, const Wave *b, double *max_err)
+{
+	const float *x = a->data, *y = b->data;
+	double signal = 0.0, noise = 0.0;
+	unsigned int i;
+
+	*max_err = 0.0;
+
+	if(a->sampleCount != b->sampleCount)
+	{
+		*max_err = INFINITY;
+		return -INFINITY;
+	}
+
+	for(i = 0; i < a->sampleCount; i++)
+	{
+		double d = fabs((double)x[i] - y[i]);
+
+		if(d > *max_err)
+			*max_err = d;
+
+		signal += (double)x[i] * x[i];
+		noise += d * d;
+	}
+
+	if(noise == 0.0)
+		return INFINITY;
+
+	return 10.0 * log10(signal / noise);
+}
+
+/* Effects whose variations check_variations() renders, and how many of each,
+ * more than fit in the lanes. */
+#define VARIATION_EFFECTS	16
+#define VARIATION_COUNT		(WAVE_LANES + 3)
+
+/* Checks that the variations GenerateWaveVariations() renders in memory are
+ * those of MutateWaveParams(), each rendered on its own, and that the length
+ * of each is predicted exactly, as GenerateWaves() sizes its buffers by it. */
+static unsigned int check_variations(unsigned int count)
+{
+	WaveParams variations[VARIATION_COUNT];
+	WaveStats stats[VARIATION_COUNT];
+	Wave waves[VARIATION_COUNT];
+	unsigned int failures = 0, n, v;
+
+	for(n = 0; n < count && n < VARIATION_EFFECTS; n++)
+	{
+		char name[NAME_LEN];
+		unsigned int index;
+		WaveParams base;
+		int generated;
+
+		get_effect(n, &base, name, &index);
+		generated = GenerateWaveVariations(&base, 0.3f, n, VARIATION_COUNT,
+			variations, waves, stats, NULL);
+
+		if(generated != VARIATION_COUNT)
+		{
+			printf("FAIL variation %s %u: generated %d of %d\n", name,
+				index, generated, VARIATION_COUNT);
+			failures++;
+		}
+
+		for(v = 0; v < VARIATION_COUNT; v++)
+		{
+			WaveParams wp = base;
+			WaveStats ref_stats;
+			Wave ref;
+			int same;
+
+			/* Compared first, as rendering adjusts the parameters. */
+			MutateWaveParams(&wp, 0.3f, n + v);
+			same = memcmp(&wp, &variations[v], sizeof(wp)) == 0;
+			ref = GenerateWaveEx(&wp, NULL, &ref_stats, NULL, NULL);
+
+			if(!same || stats[v].sampleCount != ref_stats.sampleCount ||
+				stats[v].checksum != ref_stats.checksum)
+			{
+				printf("FAIL variation %s %u: variation %u differs\n",
+					name, index, v);
+				failures++;
+			}
+
+			if(GetWaveSampleCount(&variations[v]) != ref_stats.sampleCount)
+			{
+				printf("FAIL variation %s %u: predicted %u samples of "
+					"variation %u, rendered %u\n", name, index,
+					GetWaveSampleCount(&variations[v]), v,
+					ref_stats.sampleCount);
+				failures++;
+			}
+
+			UnloadWave(ref, NULL);
+			UnloadWave(waves[v], NULL);
+		}
+	}
+
+	return failures;
+}
+
+#ifndef _WIN32
+/* Effects streamed through a ring by check_ring(), and its capacity in bytes,
+ * small enough for every effect to wrap around it many times. */
+#define RING_EFFECTS		16
+#define RING_TEST_CAPACITY	4096
+#define RING_TEST_FRAMES	500
+
+struct ring_producer
+{
+	struct thread thread;
+	struct ring *ring;
+	const WaveParams *wp;
+};
+
+/* Renders an effect into the ring in blocks as 32 bit float samples, the way
+ * rfx2wav --shm does. */
+static void ring_producer_main(void *arg)
+{
+	struct ring_producer *p = arg;
+	float samples[RING_TEST_FRAMES];
+	unsigned char block[RING_TEST_FRAMES * 4];
+	WaveGenerator *gen = LoadWaveGenerator(p->wp, NULL);
+	unsigned int n;
+	size_t len;
+
+	if(gen == NULL)
+	{
+		ring_finish(p->ring, RING_FAILED);
+		return;
+	}
+
+	do
+	{
+		n = RenderWaveBlock(gen, samples, RING_TEST_FRAMES);
+		len = ConvertWaveSamples(block, samples, n, 32, 1.0f);
+
+		if(ring_write(p->ring, block, len, 10000) != len)
+		{
+			ring_finish(p->ring, RING_FAILED);
+			break;
+		}
+	} while(n == RING_TEST_FRAMES);
+
+	if(ring_state(p->ring) == RING_STREAMING)
+		ring_finish(p->ring, RING_FINISHED);
+
+	UnloadWaveGenerator(gen, NULL);
+}
+
+/* Reads a ring as its consumer until the stream ends, hashing the bytes as
+ * WaveStats.checksum. Returns the number of bytes read. */
+static unsigned long consume_ring(struct ring *r, unsigned long long *checksum)
+{
+	struct timespec ts = { 0, 100000 };
+	unsigned char buf[777];
+	unsigned long total = 0;
+	size_t n, i;
+
+	*checksum = 0xcbf29ce484222325ULL;
+
+	for(;;)
+	{
+		/* Read the state first, so nothing written before it ended is
+		 * missed. */
+		int ended = ring_state(r) != RING_STREAMING;
+
+		n = ring_read(r, buf, sizeof(buf));
+
+		for(i = 0; i < n; i++)
+		{
+			*checksum ^= buf[i];
+			*checksum *= 0x100000001b3ULL;
+		}
+
+		total += n;
+
+		if(n == 0)
+		{
+			if(ended)
+				break;
+
+			nanosleep(&ts, NULL);
+		}
+	}
+
+	return total;
+}
+
+/* Streams the first effects through a small ring from a producer thread to a
+ * consumer mapping of it, and checks that a consumer refuses rings with a
+ * corrupt capacity. Returns the number of failures. */
+static unsigned int check_ring(const struct golden *golden, unsigned int count)
+{
+	char name[64];
+	unsigned int failures = 0, n;
+	struct ring producer, consumer;
+
+	sprintf(name, "/rfxgolden-%ld", (long)getpid());
+
+	for(n = 0; n < count && n < RING_EFFECTS; n++)
+	{
+		struct ring_producer p;
+		char effect[NAME_LEN];
+		unsigned int index;
+		unsigned long long checksum = 0;
+		unsigned long len = 0;
+		WaveParams wp, rp;
+		WaveStats stats;
+		Wave ref;
+		int ok;
+
+		get_effect(n, &wp, effect, &index);
+
+		rp = wp;
+		ref = GenerateWaveEx(&rp, NULL, &stats, NULL, NULL);
+		UnloadWave(ref, NULL);
+
+		if(ring_create(&producer, name, RING_TEST_CAPACITY,
+			WAVE_SAMPLE_RATE, 1, 32) != 0)
+		{
+			failures++;
+			break;
+		}
+
+		p.ring = &producer;
+		p.wp = &wp;
+		ok = ring_open(&consumer, name) == 0;
+
+		if(ok && thread_start(&p.thread, ring_producer_main, &p) == 0)
+		{
+			len = consume_ring(&consumer, &checksum);
+			thread_join(&p.thread);
+			ok = ring_state(&producer) == RING_FINISHED;
+		}
+		else
+			ok = 0;
+
+		ok = ok && len == golden[n].samples * 4UL &&
+			(stats.clipCount > 0 || checksum == golden[n].checksum);
+
+		if(!ok)
+		{
+			printf("FAIL %-10s %s %u: %lu samples, %016llx "
+				"(expected %u, %016llx)\n", "ring", effect, index,
+				len / 4, checksum, golden[n].samples,
+				golden[n].checksum);
+			failures++;
+		}
+
+		if(consumer.header != NULL)
+			ring_close(&consumer);
+
+		ring_close(&producer);
+	}
+
+	if(ring_create(&producer, name, RING_TEST_CAPACITY, WAVE_SAMPLE_RATE, 1,
+		32) != 0)
+		return failures + 1;
+
+	producer.header->capacity = RING_TEST_CAPACITY - 1;
+	if(ring_open(&consumer, name) == 0)
+	{
+		printf("FAIL ring: capacity that is not a power of two "
+			"accepted\n");
+		ring_close(&consumer);
+		failures++;
+	}
+
+	producer.header->capacity = RING_TEST_CAPACITY * 2;
+	if(ring_open(&consumer, name) == 0)
+	{
+		printf("FAIL ring: capacity larger than the object accepted\n");
+		ring_close(&consumer);
+		failures++;
+	}
+
+	ring_close(&producer);
+	return failures;
+}
+#else
+static unsigned int check_ring(const struct golden *golden, unsigned int count)
+{
+	(void)golden;
+	(void)count;
+	return 0;
+}
+#endif
+
+#ifndef _WIN32
+/* Time given to the render daemon to start listening, in milliseconds. */
+#define SERVER_WAIT_MS		5000
+
+/* Connects to the render daemon at path, waiting up to SERVER_WAIT_MS for it
+ * to start listening. Returns the socket, or -1. */
+static int server_connect(const char *path)
+{
+	struct sockaddr_un addr;
+	struct timespec ts = { 0, 10000000 };
+	unsigned int waited;
+
+	if(strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	for(waited = 0; waited <= SERVER_WAIT_MS; waited += 10)
+	{
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if(fd < 0)
+			return -1;
+
+		if(connect(fd, (const struct sockaddr *)&addr,
+			sizeof(addr)) == 0)
+			return fd;
+
+		close(fd);
+		if(errno != ENOENT && errno != ECONNREFUSED)
+			return -1;
+
+		nanosleep(&ts, NULL);
+	}
+
+	return -1;
+}
+
+static int send_full(int fd, const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+
+	while(len > 0)
+	{
+		ssize_t n = write(fd, p, len);
+
+		if(n <= 0)
+			return -1;
+
+		p += n;
+		len -= (size_t)n;
+	}
+
+	return 0;
+}
+
+static int recv_full(int fd, void *buf, size_t len)
+{
+	unsigned char *p = buf;
+
+	while(len > 0)
+	{
+		ssize_t n = read(fd, p, len);
+
+		if(n <= 0)
+			return -1;
+
+		p += n;
+		len -= (size_t)n;
+	}
+
+	return 0;
+}
+
+/* Sends a request to the daemon and reads the response into buf, which holds
+ * cap bytes. Returns the status, or -1 if the exchange failed. */
+static int server_request(int fd, enum server_command command,
+	const void *payload, unsigned long length, unsigned char *buf,
+	size_t cap, unsigned long *len)
+{
+	unsigned char h[SERVER_REQUEST_SIZE];
+	unsigned char r[SERVER_RESPONSE_SIZE];
+	unsigned int i;
+
+	memcpy(h, SERVER_MAGIC, 4);
+	h[4] = (unsigned char)command;
+	h[5] = SERVER_OUTPUT_PCM;
+	h[6] = 32;
+	h[7] = WAVE_NORMALIZE_NONE;
+	memset(h + 8, 0, 4);
+	for(i = 0; i < 4; i++)
+		h[12 + i] = (unsigned char)((length >> (i * 8)) & 0xFF);
+
+	if(send_full(fd, h, sizeof(h)) != 0 ||
+		send_full(fd, payload, length) != 0 ||
+		recv_full(fd, r, sizeof(r)) != 0)
+		return -1;
+
+	*len = (unsigned long)r[4] | (unsigned long)r[5] << 8 |
+		(unsigned long)r[6] << 16 | (unsigned long)r[7] << 24;
+
+	if(*len > cap || recv_full(fd, buf, *len) != 0)
+		return -1;
+
+	return r[0];
+}
+
+/* Renders every effect with the daemon at path as 32 bit float samples over
+ * one connection, and compares them with the golden hashes. Samples are
+ * clamped on conversion, so the hashes of effects that clip only match in
+ * length. Returns the number of failures. */
+static unsigned int check_server(const char *path, const struct golden *golden,
+	unsigned int count, int verbose)
+{
+	static unsigned char buf[MAX_WAVE_LENGTH_SECONDS * WAVE_SAMPLE_RATE * 4];
+	unsigned int failures = 0, n;
+	unsigned long len;
+	int fd = server_connect(path);
+
+	if(fd < 0)
+	{
+		fprintf(stderr, "Unable to connect to %s\n", path);
+		return 1;
+	}
+
+	for(n = 0; n < count; n++)
+	{
+		char name[NAME_LEN];
+		unsigned int index;
+		unsigned long long checksum = 0xcbf29ce484222325ULL;
+		unsigned long i;
+		WaveParams wp, rp;
+		WaveStats stats;
+		Wave ref;
+		int status, ok;
+
+		get_effect(n, &wp, name, &index);
+
+		rp = wp;
+		ref = GenerateWaveEx(&rp, NULL, &stats, NULL, NULL);
+		UnloadWave(ref, NULL);
+
+		status = server_request(fd, SERVER_RENDER_PARAMS, &wp, sizeof(wp),
+			buf, sizeof(buf), &len);
+		if(status < 0)
+		{
+			fprintf(stderr, "Lost connection to %s\n", path);
+			failures++;
+			break;
+		}
+
+		/* FNV-1a, as WaveStats.checksum. */
+		for(i = 0; i < len; i++)
+		{
+			checksum ^= buf[i];
+			checksum *= 0x100000001b3ULL;
+		}
+
+		ok = status == SERVER_OK && len == golden[n].samples * 4UL &&
+			(stats.clipCount > 0 || checksum == golden[n].checksum);
+
+		if(!ok || verbose)
+		{
+			printf("%-4s %-10s %s %u: status %d, %lu samples, "
+				"%016llx%s (expected %u, %016llx)\n",
+				ok ? "ok" : "FAIL", "server", name, index, status,
+				len / 4, checksum, stats.clipCount > 0 ?
+				" clipped" : "", golden[n].samples,
+				golden[n].checksum);
+		}
+
+		if(!ok)
+			failures++;
+	}
+
+	if(server_request(fd, SERVER_STATS, NULL, 0, buf, sizeof(buf) - 1,
+		&len) != SERVER_OK)
+	{
+		printf("FAIL server: stats request failed\n");
+		failures++;
+	}
+
+	close(fd);
+	return failures;
+}
+#else
+static unsigned int check_server(const char *path, const struct golden *golden,
+	unsigned int count, int verbose)
+{
+	(void)golden;
+	(void)count;
+	(void)verbose;
+
+	fprintf(stderr, "Unable to connect to %s: not supported on Windows\n",
+		path);
+	return 1;
+}
+#endif
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: rfxgolden [options] golden.txt\n"
+		"Options:\n"
+		"  --update         Rewrite golden.txt from the reference renderer\n"
+		"  --max-error E    Largest sample error of approximate renderers"
+		" (default %g)\n"
+		"  --min-snr DB     Smallest SNR of approximate renderers"
+		" (default %g)\n"
+		"  --server SOCKET  Render with the daemon listening on SOCKET\n"
+		"                   instead, see rfx2wav --daemon\n"
+		"  --verbose        Report every effect, not only failures\n",
+		DEFAULT_MAX_ERROR, DEFAULT_MIN_SNR);
+}
+
+int main(int argc, char *argv[])
+{
+	double max_error = DEFAULT_MAX_ERROR;
+	double min_snr = DEFAULT_MIN_SNR;
+	const char *server = NULL;
+	int update = 0, verbose = 0;
+	unsigned int count = effect_count();
+	unsigned int failures = 0, n, r;
+	struct golden *golden;
+	FILE *out = NULL;
+	int i;
+
+	for(i = 1; i < argc - 1; i++)
+	{
+		if(strcmp(argv[i], "--update") == 0)
+			update = 1;
+		else if(strcmp(argv[i], "--verbose") == 0)
+			verbose = 1;
+		else if(strcmp(argv[i], "--max-error") == 0 && i + 1 < argc - 1)
+			max_error = atof(argv[++i]);
+		else if(strcmp(argv[i], "--min-snr") == 0 && i + 1 < argc - 1)
+			min_snr = atof(argv[++i]);
+		else if(strcmp(argv[i], "--server") == 0 && i + 1 < argc - 1)
+			server = argv[++i];
+		else
+			break;
+	}
+
+	if(i != argc - 1 || (update && server != NULL))
+	{
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	add_kernel_renderers();
+
+	golden = calloc(count, sizeof(*golden));
+	if(golden == NULL)
+		return EXIT_FAILURE;
+
+	if(update)
+	{
+		out = fopen(argv[i], "w");
+		if(out == NULL)
+		{
+			fprintf(stderr, "Unable to open %s\n", argv[i]);
+			free(golden);
+			return EXIT_FAILURE;
+		}
+
+		fprintf(out, "# Golden output of the reference renderer: "
+			"class index samples checksum\n"
+			"# Regenerate with: make golden-update\n");
+	}
+	else if(!load_golden(argv[i], golden, count))
+	{
+		free(golden);
+		return EXIT_FAILURE;
+	}
+
+	if(server != NULL)
+	{
+		failures = check_server(server, golden, count, verbose);
+		free(golden);
+
+		printf("%u effects, rendered by %s, %u failures\n", count, server,
+			failures);
+		return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	for(n = 0; n < count; n++)
+	{
+		char name[NAME_LEN];
+		unsigned int index;
+		WaveParams base, wp;
+		WaveStats ref_stats;
+		Wave ref;
+
+		get_effect(n, &base, name, &index);
+
+		wp = base;
+		SetWaveKernel(renderers[0].kernel);
+		ref = renderers[0].render(&wp, &ref_stats);
+
+		if(update)
+		{
+			fprintf(out, "%s %u %u %016llx\n", name, index,
+				ref_stats.sampleCount, ref_stats.checksum);
+			UnloadWave(ref, NULL);
+			continue;
+		}
+
+		if(strcmp(golden[n].name, name) != 0 || golden[n].index != index)
+		{
+			fprintf(stderr, "Golden file does not match the corpus at "
+				"%s %u\n", name, index);
+			UnloadWave(ref, NULL);
+			failures++;
+			break;
+		}
+
+		if(GetWaveSampleCount(&base) != ref_stats.sampleCount)
+		{
+			printf("FAIL %s %u: predicted %u samples, rendered %u\n",
+				name, index, GetWaveSampleCount(&base),
+				ref_stats.sampleCount);
+			failures++;
+		}
+
+		if(!compare_export(&base, &ref, &ref_stats))
+		{
+			printf("FAIL %-10s %s %u: exported WAV data differs\n",
+				"export", name, index);
+			failures++;
+		}
+
+		for(r = 0; r < renderer_count; r++)
+		{
+			const struct renderer *rd = &renderers[r];
+			WaveStats stats;
+			Wave w = ref;
+			int ok;
+
+			if(r == 0)
+				stats = ref_stats;
+			else
+			{
+				wp = base;
+				SetWaveKernel(rd->kernel);
+				w = rd->render(&wp, &stats);
+			}
+
+			if(rd->match == MATCH_HASH)
+			{
+				ok = stats.sampleCount == golden[n].samples &&
+					stats.checksum == golden[n].checksum;
+
+				if(ok && r != 0 && !compare_conversion(&w, rd->kernel))
+				{
+					printf("FAIL %-10s %s %u: sample conversion "
+						"differs\n", rd->name, name, index);
+					failures++;
+				}
+
+				if(!ok || verbose)
+				{
+					printf("%-4s %-10s %s %u: %u samples, "
+						"%016llx (expected %u, %016llx)\n",
+						ok ? "ok" : "FAIL", rd->name,
+						name, index, stats.sampleCount,
+						stats.checksum, golden[n].samples,
+						golden[n].checksum);
+				}
+			}
+			else
+			{
+				double err, snr = compare_waves(&ref, &w, &err);
+
+				if(rd->match == MATCH_VALUE)
+					ok = err == 0.0;
+				else
+					ok = err <= max_error && snr >= min_snr;
+
+				if(!ok || verbose)
+				{
+					printf("%-4s %-10s %s %u: max error %g, "
+						"SNR %.1f dB\n", ok ? "ok" : "FAIL",
+						rd->name, name, index, err, snr);
+				}
+			}
+
+			if(!ok)
+				failures++;
+
+			if(r != 0)
+				UnloadWave(w, NULL);
+		}
+
+		UnloadWave(ref, NULL);
+	}
+
+	if(!update)
+	{
+		failures += check_variations(count);
+		failures += check_nan_conversion();
+		failures += check_ring(golden, count);
+	}
+
+	free(golden);
+
+	if(update)
+	{
+		fclose(out);
+		printf("Wrote %u golden outputs to %s\n", count, argv[i]);
+		return EXIT_SUCCESS;
+	}
+
+	printf("%u effects, %u renderers, %u failures\n", count,
+		renderer_count, failures);
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,337 @@
+/* Runs the real-time mixer headless against a null output sink and prints the
+ * time taken by each audio callback as JSON. The sink asks for a block at the
+ * pace a sound card would while producer threads trigger effects of the corpus
+ * at random, so the worst callback time can be compared with the time the
+ * block lasts. The harness runs at normal priority, so on a busy machine the
+ * worst case includes preemption that a real audio thread would not see. */
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <time.h>
+#endif
+
+#include <rfxgen.h>
+#include <thread.h>
+#include "corpus.h"
+
+#define DEFAULT_VOICES		32
+#define DEFAULT_BLOCK		256
+#define DEFAULT_SECONDS		10
+#define DEFAULT_PRODUCERS	2
+#define DEFAULT_RATE		20
+#define DEFAULT_QUEUE		64
+
+#define MAX_PRODUCERS		64
+
+/* A game thread triggering effects. */
+struct producer
+{
+	struct thread thread;
+	WaveMixer *mixer;
+	const WaveParams *effects;
+	unsigned int effect_count;
+	/* Triggers per second. */
+	double rate;
+	double start_ns;
+	double end_ns;
+	unsigned long state;
+	unsigned long triggered;
+	unsigned long refused;
+};
+
+/* Returns a monotonic time in nanoseconds. */
+static double now_ns(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq, count;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (double)count.QuadPart * 1e9 / (double)freq.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+static void sleep_until(double ns)
+{
+	double wait = ns - now_ns();
+
+	if(wait <= 0.0)
+		return;
+
+#ifdef _WIN32
+	Sleep((DWORD)(wait / 1e6));
+#else
+	{
+		struct timespec ts;
+
+		ts.tv_sec = (time_t)(wait / 1e9);
+		ts.tv_nsec = (long)(wait - (double)ts.tv_sec * 1e9);
+		nanosleep(&ts, NULL);
+	}
+#endif
+}
+
+/* xorshift32, as the corpus uses. */
+static unsigned long next_random(unsigned long *state)
+{
+	unsigned long x = *state;
+
+	x ^= (x << 13) & 0xFFFFFFFFUL;
+	x ^= x >> 17;
+	x ^= (x << 5) & 0xFFFFFFFFUL;
+	*state = x;
+	return x;
+}
+
+static void producer_main(void *arg)
+{
+	struct producer *p = arg;
+	double at = p->start_ns;
+
+	for(;;)
+	{
+		/* Exponential gaps, so triggers sometimes bunch up as in a game. */
+		double u = (double)((next_random(&p->state) >> 8) + 1) / 16777217.0;
+		const WaveParams *wp;
+		float volume;
+
+		at += -1e9 / p->rate * log(u);
+		if(at >= p->end_ns)
+			break;
+
+		sleep_until(at);
+
+		wp = &p->effects[next_random(&p->state) % p->effect_count];
+		volume = 0.25f + (float)(next_random(&p->state) % 256) / 1024.0f;
+
+		if(TriggerWaveVoice(p->mixer, wp, volume))
+			p->triggered++;
+		else
+			p->refused++;
+	}
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/* Returns the callback time at quantile q of the sorted times. */
+static double quantile(const double *sorted, unsigned long count, double q)
+{
+	unsigned long i = (unsigned long)(q * (double)(count - 1) + 0.5);
+
+	return sorted[i];
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: rfxmixer [options]\n"
+		"Options:\n"
+		"  --voices N     Voices of the mixer (default %d)\n"
+		"  --block N      Samples per callback (default %d)\n"
+		"  --seconds S    Length of the run (default %d)\n"
+		"  --producers N  Threads triggering effects (default %d)\n"
+		"  --rate R       Average triggers per second of each producer\n"
+		"                 (default %d)\n"
+		"  --queue N      Capacity of the trigger queue (default %d)\n"
+		"  --seed N       Seed of the effect corpus and the triggers\n"
+		"                 (default %u)\n"
+		"  --max-load F   Fail if a callback takes more than F times the\n"
+		"                 length of its block\n"
+		"  --out FILE     Write results to FILE instead of stdout\n",
+		DEFAULT_VOICES, DEFAULT_BLOCK, DEFAULT_SECONDS,
+		DEFAULT_PRODUCERS, DEFAULT_RATE, DEFAULT_QUEUE, CORPUS_SEED);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int voices = DEFAULT_VOICES;
+	unsigned int block = DEFAULT_BLOCK;
+	double seconds = DEFAULT_SECONDS;
+	unsigned int producer_count = DEFAULT_PRODUCERS;
+	double rate = DEFAULT_RATE;
+	unsigned int queue = DEFAULT_QUEUE;
+	unsigned long seed = CORPUS_SEED;
+	double max_load = 0.0;
+	FILE *out = stdout;
+	struct producer producers[MAX_PRODUCERS];
+	unsigned int effect_count = corpus_class_count() *
+		CORPUS_EFFECTS_PER_CLASS;
+	unsigned long blocks, b, overruns = 0, triggered = 0, refused = 0;
+	WaveParams *effects;
+	WaveMixer *mixer;
+	WaveMixerStats ms;
+	double *times, *sorted;
+	double start, budget, sum = 0.0;
+	float *buffer;
+	unsigned int n;
+	int i, ret = EXIT_SUCCESS;
+
+	for(i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--voices") == 0 && i + 1 < argc)
+			voices = (unsigned int)atoi(argv[++i]);
+		else if(strcmp(argv[i], "--block") == 0 && i + 1 < argc)
+			block = (unsigned int)atoi(argv[++i]);
+		else if(strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+			seconds = atof(argv[++i]);
+		else if(strcmp(argv[i], "--producers") == 0 && i + 1 < argc)
+			producer_count = (unsigned int)atoi(argv[++i]);
+		else if(strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+			rate = atof(argv[++i]);
+		else if(strcmp(argv[i], "--queue") == 0 && i + 1 < argc)
+			queue = (unsigned int)atoi(argv[++i]);
+		else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = strtoul(argv[++i], NULL, 0);
+		else if(strcmp(argv[i], "--max-load") == 0 && i + 1 < argc)
+			max_load = atof(argv[++i]);
+		else if(strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+		{
+			out = fopen(argv[++i], "w");
+			if(out == NULL)
+			{
+				fprintf(stderr, "Unable to open %s\n", argv[i]);
+				return EXIT_FAILURE;
+			}
+		}
+		else
+		{
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	blocks = (unsigned long)(seconds * WAVE_SAMPLE_RATE / (block ? block : 1));
+
+	if(voices == 0 || block == 0 || blocks == 0 || queue == 0 ||
+		producer_count > MAX_PRODUCERS || rate <= 0.0)
+	{
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	effects = malloc(effect_count * sizeof(*effects));
+	times = malloc(blocks * sizeof(*times));
+	sorted = malloc(blocks * sizeof(*sorted));
+	buffer = malloc(block * sizeof(*buffer));
+	mixer = LoadWaveMixer(voices, queue, NULL);
+
+	if(effects == NULL || times == NULL || sorted == NULL ||
+		buffer == NULL || mixer == NULL)
+	{
+		fprintf(stderr, "Unable to allocate memory.\n");
+		return EXIT_FAILURE;
+	}
+
+	for(n = 0; n < effect_count; n++)
+	{
+		corpus_effect(&effects[n], n / CORPUS_EFFECTS_PER_CLASS,
+			n % CORPUS_EFFECTS_PER_CLASS, seed);
+	}
+
+	/* Budget of a callback: the time its block takes to play. */
+	budget = (double)block * 1e9 / WAVE_SAMPLE_RATE;
+	start = now_ns() + 1e6;
+
+	for(n = 0; n < producer_count; n++)
+	{
+		struct producer *p = &producers[n];
+
+		p->mixer = mixer;
+		p->effects = effects;
+		p->effect_count = effect_count;
+		p->rate = rate;
+		p->start_ns = start;
+		p->end_ns = start + (double)blocks * budget;
+		p->state = ((seed + n) * 2654435761UL + 1) & 0xFFFFFFFFUL;
+		p->triggered = 0;
+		p->refused = 0;
+
+		if(p->state == 0)
+			p->state = 1;
+
+		if(thread_start(&p->thread, producer_main, p) != 0)
+		{
+			fprintf(stderr, "Unable to start producer thread.\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* The null sink: asks for each block when a sound card would, and
+	 * discards it. */
+	for(b = 0; b < blocks; b++)
+	{
+		double t;
+
+		sleep_until(start + (double)b * budget);
+
+		t = now_ns();
+		MixWaveBlock(mixer, buffer, block);
+		times[b] = now_ns() - t;
+
+		sum += times[b];
+		if(times[b] > budget)
+			overruns++;
+	}
+
+	for(n = 0; n < producer_count; n++)
+	{
+		thread_join(&producers[n].thread);
+		triggered += producers[n].triggered;
+		refused += producers[n].refused;
+	}
+
+	GetWaveMixerStats(mixer, &ms);
+
+	memcpy(sorted, times, blocks * sizeof(*times));
+	qsort(sorted, blocks, sizeof(*sorted), cmp_double);
+
+	fprintf(out, "{\n\"version\": 1,\n\"kernel\": \"%s\",\n"
+		"\"voices\": %u,\n\"block\": %u,\n\"blocks\": %lu,\n"
+		"\"producers\": %u,\n\"rate\": %g,\n\"queue\": %u,\n"
+		"\"budget_us\": %.3f,\n", GetActiveWaveKernel(), voices, block,
+		blocks, producer_count, rate, queue, budget / 1e3);
+	fprintf(out, "\"callback_us\": {\"mean\": %.3f, \"p50\": %.3f, "
+		"\"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f},\n",
+		sum / (double)blocks / 1e3, quantile(sorted, blocks, 0.5) / 1e3,
+		quantile(sorted, blocks, 0.99) / 1e3,
+		quantile(sorted, blocks, 0.999) / 1e3,
+		sorted[blocks - 1] / 1e3);
+	fprintf(out, "\"worst_load\": %.4f,\n\"overruns\": %lu,\n"
+		"\"triggered\": %lu,\n\"refused\": %lu,\n"
+		"\"started\": %llu,\n\"stolen\": %llu,\n"
+		"\"peak_voices\": %u\n}\n", sorted[blocks - 1] / budget,
+		overruns, triggered, refused, ms.triggerCount, ms.stealCount,
+		ms.peakVoices);
+
+	if(max_load > 0.0 && sorted[blocks - 1] > max_load * budget)
+	{
+		fprintf(stderr, "Worst callback took %.1f%% of its block\n",
+			100.0 * sorted[blocks - 1] / budget);
+		ret = EXIT_FAILURE;
+	}
+
+	if(out != stdout)
+		fclose(out);
+
+	UnloadWaveMixer(mixer, NULL);
+	free(buffer);
+	free(sorted);
+	free(times);
+	free(effects);
+	return ret;
+}
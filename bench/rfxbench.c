@@ -0,0 +1,367 @@
+/* Benchmarks GenerateWave() in-process over the effect corpus and prints the
+ * results as JSON. With --lanes the effects of each class are rendered side by
+ * side with GenerateWaves() instead. */
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <time.h>
+#endif
+
+#include <rfxgen.h>
+#include "corpus.h"
+#include "counters.h"
+
+#define STRINGIFY(x)	#x
+#define XSTRINGIFY(x)	STRINGIFY(x)
+
+#if defined(__VERSION__)
+# define COMPILER	__VERSION__
+#elif defined(_MSC_FULL_VER)
+# define COMPILER	"MSVC " XSTRINGIFY(_MSC_FULL_VER)
+#else
+# define COMPILER	"unknown"
+#endif
+
+/* Set by the pgo target of the Makefile for the optimized build. */
+#ifdef RFXBENCH_PGO
+# define BUILD		"pgo"
+#else
+# define BUILD		"default"
+#endif
+
+#define DEFAULT_WARMUP		2
+#define DEFAULT_REPETITIONS	10
+#define MAX_REPETITIONS		1000
+
+struct counting_allocator
+{
+	unsigned long count;
+};
+
+static void *count_malloc(size_t size, void *user)
+{
+	((struct counting_allocator *)user)->count++;
+	return malloc(size);
+}
+
+static void *count_realloc(void *ptr, size_t size, void *user)
+{
+	((struct counting_allocator *)user)->count++;
+	return realloc(ptr, size);
+}
+
+static void count_free(void *ptr, void *user)
+{
+	(void)user;
+	free(ptr);
+}
+
+/* Returns a monotonic time in nanoseconds. */
+static double now_ns(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq, count;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (double)count.QuadPart * 1e9 / (double)freq.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+/* Writes the counts of the timed renders of a class per sample, and the
+ * ratios derived from them, as a JSON object. */
+static void print_counters(FILE *out, const struct counters *c,
+		const double values[COUNTER_EVENTS], double samples)
+{
+	int e, first = 1;
+
+	fputs(", \"counters\": {", out);
+
+	for(e = 0; e < COUNTER_EVENTS; e++)
+	{
+		if(!counters_available(c, (enum counter_event)e))
+			continue;
+
+		fprintf(out, "%s\"%s_per_sample\": %.4f", first ? "" : ", ",
+			counters_name((enum counter_event)e), values[e] / samples);
+		first = 0;
+	}
+
+	if(counters_available(c, COUNTER_CYCLES) &&
+		counters_available(c, COUNTER_INSTRUCTIONS) &&
+		values[COUNTER_CYCLES] > 0.0)
+	{
+		fprintf(out, ", \"ipc\": %.3f",
+			values[COUNTER_INSTRUCTIONS] / values[COUNTER_CYCLES]);
+	}
+
+	if(counters_available(c, COUNTER_BRANCHES) &&
+		counters_available(c, COUNTER_BRANCH_MISSES) &&
+		values[COUNTER_BRANCHES] > 0.0)
+	{
+		fprintf(out, ", \"branch_miss_rate\": %.5f",
+			values[COUNTER_BRANCH_MISSES] / values[COUNTER_BRANCHES]);
+	}
+
+	if(counters_available(c, COUNTER_CACHE_REFERENCES) &&
+		counters_available(c, COUNTER_CACHE_MISSES) &&
+		values[COUNTER_CACHE_REFERENCES] > 0.0)
+	{
+		fprintf(out, ", \"cache_miss_rate\": %.5f",
+			values[COUNTER_CACHE_MISSES] /
+			values[COUNTER_CACHE_REFERENCES]);
+	}
+
+	fputc('}', out);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/* Renders every effect of a class once, returning the number of samples. */
+static unsigned long render_class(const WaveParams *effects,
+		const WaveAllocator *allocator, int lanes)
+{
+	unsigned long samples = 0;
+	unsigned int i;
+
+	if(lanes)
+	{
+		Wave waves[CORPUS_EFFECTS_PER_CLASS];
+
+		if(GenerateWaves(effects, CORPUS_EFFECTS_PER_CLASS, waves,
+			NULL, allocator) < CORPUS_EFFECTS_PER_CLASS)
+		{
+			fprintf(stderr, "Out of memory rendering waves\n");
+			exit(1);
+		}
+
+		for(i = 0; i < CORPUS_EFFECTS_PER_CLASS; i++)
+		{
+			samples += waves[i].sampleCount;
+			UnloadWave(waves[i], allocator);
+		}
+
+		return samples;
+	}
+
+	for(i = 0; i < CORPUS_EFFECTS_PER_CLASS; i++)
+	{
+		/* GenerateWave() may adjust the parameters it is given. */
+		WaveParams wp = effects[i];
+		Wave w = GenerateWave(&wp, allocator);
+
+		samples += w.sampleCount;
+		UnloadWave(w, allocator);
+	}
+
+	return samples;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: rfxbench [options]\n"
+		"Options:\n"
+		"  --warmup N    Untimed renders of each class (default %d)\n"
+		"  --reps N      Timed renders of each class (default %d)\n"
+		"  --filter STR  Only run classes whose name contains STR\n"
+		"  --seed N      Seed of the effect corpus (default %u)\n"
+		"  --kernel NAME Render with kernel NAME instead of the best one the CPU\n"
+		"                supports\n"
+		"  --lanes       Render the effects of a class side by side with\n"
+		"                GenerateWaves()\n"
+		"  --counters    Read hardware performance counters around each\n"
+		"                timed render, where the system permits it\n"
+		"  --out FILE    Write results to FILE instead of stdout\n",
+		DEFAULT_WARMUP, DEFAULT_REPETITIONS, CORPUS_SEED);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int warmup = DEFAULT_WARMUP;
+	unsigned int reps = DEFAULT_REPETITIONS;
+	unsigned long seed = CORPUS_SEED;
+	const char *filter = NULL;
+	const char *kernel = NULL;
+	FILE *out = stdout;
+	struct counting_allocator counter;
+	struct counters hw;
+	int use_counters = 0;
+	int lanes = 0;
+	WaveAllocator allocator;
+	unsigned int cls, classes = corpus_class_count();
+	int first = 1;
+	int i;
+
+	for(i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+			warmup = (unsigned int)atoi(argv[++i]);
+		else if(strcmp(argv[i], "--reps") == 0 && i + 1 < argc)
+			reps = (unsigned int)atoi(argv[++i]);
+		else if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+			filter = argv[++i];
+		else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = strtoul(argv[++i], NULL, 0);
+		else if(strcmp(argv[i], "--kernel") == 0 && i + 1 < argc)
+			kernel = argv[++i];
+		else if(strcmp(argv[i], "--lanes") == 0)
+			lanes = 1;
+		else if(strcmp(argv[i], "--counters") == 0)
+			use_counters = 1;
+		else if(strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+		{
+			out = fopen(argv[++i], "w");
+			if(out == NULL)
+			{
+				fprintf(stderr, "Unable to open %s\n", argv[i]);
+				return EXIT_FAILURE;
+			}
+		}
+		else
+		{
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(reps == 0 || reps > MAX_REPETITIONS)
+	{
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	if(kernel != NULL && SetWaveKernel(kernel) == false)
+	{
+		fprintf(stderr, "Render kernel %s is not supported\n", kernel);
+		return EXIT_FAILURE;
+	}
+
+	/* Benchmarks run without counters if none can be opened. */
+	if(use_counters && counters_open(&hw) == 0)
+	{
+		fprintf(stderr, "Performance counters unavailable: %s\n",
+			hw.error);
+		use_counters = 0;
+	}
+
+	allocator.userData = &counter;
+	allocator.onMalloc = count_malloc;
+	allocator.onRealloc = count_realloc;
+	allocator.onFree = count_free;
+
+	fprintf(out, "{\n\"version\": 1,\n\"compiler\": \"%s\",\n\"build\": \"%s\",\n\"kernel\": \"%s\",\n\"renderer\": \"%s\",\n\"seed\": %lu,\n\"warmup\": %u,\n"
+		"\"repetitions\": %u,\n\"effects_per_class\": %d,\n", COMPILER, BUILD,
+		GetActiveWaveKernel(), lanes ? "lanes" : "single", seed, warmup, reps,
+		CORPUS_EFFECTS_PER_CLASS);
+
+	if(use_counters)
+	{
+		int e, n = 0;
+
+		fputs("\"counters\": [", out);
+		for(e = 0; e < COUNTER_EVENTS; e++)
+		{
+			if(counters_available(&hw, (enum counter_event)e))
+				fprintf(out, "%s\"%s\"", n++ ? ", " : "",
+					counters_name((enum counter_event)e));
+		}
+		fputs("],\n", out);
+	}
+
+	fputs("\"benchmarks\": [", out);
+
+	for(cls = 0; cls < classes; cls++)
+	{
+		WaveParams effects[CORPUS_EFFECTS_PER_CLASS];
+		double runs[MAX_REPETITIONS];
+		double sorted[MAX_REPETITIONS];
+		double counts[COUNTER_EVENTS] = { 0 };
+		struct corpus_class c;
+		unsigned long samples;
+		double median, allocs;
+		unsigned int e, r;
+
+		corpus_class(&c, cls);
+		if(filter != NULL && strstr(c.name, filter) == NULL)
+			continue;
+
+		for(e = 0; e < CORPUS_EFFECTS_PER_CLASS; e++)
+			corpus_effect(&effects[e], cls, e, seed);
+
+		/* The first warmup pass also counts allocations. */
+		counter.count = 0;
+		samples = render_class(effects, &allocator, lanes);
+		allocs = (double)counter.count / CORPUS_EFFECTS_PER_CLASS;
+
+		for(r = 1; r < warmup; r++)
+			render_class(effects, &allocator, lanes);
+
+		for(r = 0; r < reps; r++)
+		{
+			double start;
+
+			if(use_counters)
+				counters_start(&hw);
+
+			start = now_ns();
+			render_class(effects, &allocator, lanes);
+			runs[r] = (now_ns() - start) / (double)(samples ? samples : 1);
+
+			if(use_counters)
+				counters_stop(&hw, counts);
+		}
+
+		memcpy(sorted, runs, reps * sizeof(*runs));
+		qsort(sorted, reps, sizeof(*sorted), cmp_double);
+		median = reps % 2 ? sorted[reps / 2] :
+			(sorted[reps / 2 - 1] + sorted[reps / 2]) / 2.0;
+
+		fprintf(out, "%s\n{\"name\": \"%s\", \"wave_type\": %d, "
+			"\"features\": %u, \"samples\": %lu, "
+			"\"ns_per_sample\": %.3f, \"min_ns_per_sample\": %.3f, "
+			"\"samples_per_sec\": %.0f, \"allocs_per_effect\": %.2f, "
+			"\"runs_ns_per_sample\": [",
+			first ? "" : ",", c.name, c.wave_type, c.features,
+			samples, median, sorted[0], 1e9 / median, allocs);
+
+		for(r = 0; r < reps; r++)
+			fprintf(out, "%s%.3f", r ? ", " : "", runs[r]);
+
+		fputc(']', out);
+
+		if(use_counters)
+		{
+			print_counters(out, &hw, counts,
+				(double)(samples ? samples : 1) * reps);
+		}
+
+		fputs("}", out);
+		fflush(out);
+		first = 0;
+	}
+
+	fputs("\n]\n}\n", out);
+
+	if(out != stdout)
+		fclose(out);
+
+	if(use_counters)
+		counters_close(&hw);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+/* Minimal JSON reader for the result files written by the benchmarks and the
+ * statistics written by rfx2wav --shard. */
+
+enum json_type
+{
+	JSON_NULL,
+	JSON_BOOL,
+	JSON_NUMBER,
+	JSON_STRING,
+	JSON_ARRAY,
+	JSON_OBJECT
+};
+
+struct json
+{
+	enum json_type type;
+	/* Value of numbers, and 0 or 1 for booleans. */
+	double number;
+	/* Value of strings. */
+	char *string;
+	/* Member name when the value is part of an object. */
+	char *key;
+	/* First element of arrays and first member of objects. */
+	struct json *child;
+	/* Next element or member of the parent. */
+	struct json *next;
+};
+
+/* Parses a NUL terminated JSON document. Returns NULL on a syntax error or if
+ * memory could not be allocated. */
+struct json *json_parse(const char *text);
+
+/* Parses the JSON document in a file. Returns NULL if the file could not be
+ * read or parsed. */
+struct json *json_load(const char *path);
+
+/* Frees a value returned by json_parse() or json_load(). */
+void json_free(struct json *j);
+
+/* Returns the member of an object called key, or NULL if there is none. */
+const struct json *json_get(const struct json *obj, const char *key);
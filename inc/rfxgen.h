@@ -1,10 +1,75 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+
+// Functions marked RFXGENAPI make up the API of librfxgen, the only symbols the shared
+// library exports. Define RFXGEN_BUILD_SHARED when building the shared library and
+// RFXGEN_USE_SHARED when linking against the Windows DLL.
+#if defined(_WIN32)
+    #if defined(RFXGEN_BUILD_SHARED)
+        #define RFXGENAPI __declspec(dllexport)
+    #elif defined(RFXGEN_USE_SHARED)
+        #define RFXGENAPI __declspec(dllimport)
+    #endif
+#elif defined(RFXGEN_BUILD_SHARED) && (defined(__GNUC__) || defined(__clang__))
+    #define RFXGENAPI __attribute__((visibility("default")))
+#endif
+
+#ifndef RFXGENAPI
+    #define RFXGENAPI
+#endif
+
 #define MAX_WAVE_LENGTH_SECONDS  10     // Max length for wave: 10 seconds
 #define WAVE_SAMPLE_RATE      44100     // Default sample rate
+#define WAVE_LANES                8     // Waves rendered side by side by a lane generator
+
+// Wave parameters type (96 bytes), stored as-is in .rfx files
+typedef struct WaveParams {
+	// Random seed used to generate the wave
+	int randSeed;
+
+	// Wave type (square, sawtooth, sine, noise)
+	int waveTypeValue;
+
+	// Wave envelope parameters
+	float attackTimeValue;
+	float sustainTimeValue;
+	float sustainPunchValue;
+	float decayTimeValue;
+
+	// Frequency parameters
+	float startFrequencyValue;
+	float minFrequencyValue;
+	float slideValue;
+	float deltaSlideValue;
+	float vibratoDepthValue;
+	float vibratoSpeedValue;
+	//float vibratoPhaseDelayValue;
+
+	// Tone change parameters
+	float changeAmountValue;
+	float changeSpeedValue;
 
-typedef struct WaveParams WaveParams;
+	// Square wave parameters
+	float squareDutyValue;
+	float dutySweepValue;
+
+	// Repeat parameters
+	float repeatSpeedValue;
+
+	// Phaser parameters
+	float phaserOffsetValue;
+	float phaserSweepValue;
+
+	// Filter parameters
+	float lpfCutoffValue;
+	float lpfCutoffSweepValue;
+	float lpfResonanceValue;
+	float hpfCutoffValue;
+	float hpfCutoffSweepValue;
+} WaveParams;
 
 // Wave type, defines audio wave data
 typedef struct Wave {
@@ -15,5 +80,181 @@ typedef struct Wave {
 	void *data;                     // Buffer data pointer
 } Wave;
 
-WaveParams *LoadWaveParams(const char *fileName);                 // Load wave parameters from file
-Wave GenerateWave(WaveParams *params);                            // Generate wave data from parameters
+// Statistics of generated samples, accumulated while generating
+typedef struct WaveStats {
+	unsigned int sampleCount;       // Number of samples the statistics cover
+	float peak;                     // Largest absolute sample value
+	unsigned int clipCount;         // Samples clamped to [-1..1]
+	double sum;                     // Sum of sample values, for DC offset
+	double sumSquares;              // Sum of squared sample values, for RMS
+	unsigned long long checksum;    // FNV-1a 64 bit hash of the 32 bit float samples (little-endian)
+} WaveStats;
+
+// Waveform overview, min/max of consecutive samples at several resolutions for drawing thumbnails
+// NOTE: Level 0 has a bin for every WAVE_OVERVIEW_BIN_SIZE samples, every further level
+// combines pairs of bins of the level before it, down to a single bin.
+#define WAVE_OVERVIEW_BIN_SIZE       64
+#define WAVE_OVERVIEW_MAX_LEVELS     16
+#define WAVE_OVERVIEW_MAX_BINS       ((MAX_WAVE_LENGTH_SECONDS*WAVE_SAMPLE_RATE + WAVE_OVERVIEW_BIN_SIZE - 1)/WAVE_OVERVIEW_BIN_SIZE)
+
+typedef struct WaveOverview {
+	unsigned int sampleCount;                       // Number of samples the overview covers
+	unsigned int levelCount;                        // Number of levels
+	unsigned int binCount[WAVE_OVERVIEW_MAX_LEVELS];    // Number of bins in each level
+	unsigned int levelOffset[WAVE_OVERVIEW_MAX_LEVELS]; // Index in bins of the first bin of each level
+	float bins[WAVE_OVERVIEW_MAX_BINS*2][2];        // Minimum and maximum sample of each bin
+} WaveOverview;
+
+// Stages of wave generation, timed separately by the profiler
+typedef enum {
+	WAVE_STAGE_PARAMS = 0,          // Per sample slides, arpeggio, repeat, vibrato and envelope
+	WAVE_STAGE_OSCILLATOR,          // Base waveform of each supersample
+	WAVE_STAGE_FILTER,              // LP and HP filters
+	WAVE_STAGE_PHASER,              // Phaser
+	WAVE_STAGE_SUPERSAMPLE,         // Envelope and averaging of the supersamples
+	WAVE_STAGE_OUTPUT,              // Clamping, statistics and overview
+	WAVE_STAGE_COUNT
+} WaveStage;
+
+// Time spent in each stage of generation and counts of events that affect it
+// NOTE: Only recorded when built with RFXGEN_PROFILE, see IsWaveProfileEnabled().
+// Ticks are CPU timestamp counter ticks on x86 and generic timer ticks on AArch64,
+// they are zero on other targets.
+typedef struct WaveProfile {
+	unsigned long long ticks[WAVE_STAGE_COUNT];     // Ticks spent in each stage
+	unsigned long long sampleCount;                 // Number of samples the profile covers
+	unsigned long long periodWraps;                 // Oscillator phase wrapped around the period
+	unsigned long long noiseRefills;                // Noise buffer refilled with random values
+	unsigned long long repeatResets;                // Parameters reset by the repeat speed
+	unsigned long long arpeggioFires;               // Arpeggio frequency changes
+	unsigned long long clampHits;                   // Parameters or samples forced back into range
+} WaveProfile;
+
+// Categories of effects made by GenerateWavePreset(), the preset buttons of rFXGen and sfxr
+typedef enum {
+	WAVE_PRESET_PICKUP = 0,         // Pickup/coin
+	WAVE_PRESET_LASER,              // Laser/shoot
+	WAVE_PRESET_EXPLOSION,          // Explosion
+	WAVE_PRESET_POWERUP,            // Powerup
+	WAVE_PRESET_HIT,                // Hit/hurt
+	WAVE_PRESET_JUMP,               // Jump
+	WAVE_PRESET_BLIP,               // Blip/select
+	WAVE_PRESET_COUNT
+} WavePreset;
+
+// Level normalization of exported waves
+typedef enum {
+	WAVE_NORMALIZE_NONE = 0,        // Samples as generated
+	WAVE_NORMALIZE_PEAK,            // Scale so that the peak is at targetDb dBFS
+	WAVE_NORMALIZE_RMS              // Scale so that the RMS level is at targetDb dBFS, without the peak exceeding 0 dBFS
+} WaveNormalize;
+
+// Sample format and level of exported WAV data
+typedef struct WaveFormat {
+	unsigned int sampleSize;        // Bits per sample: 8, 16 or 24 bit PCM, or 32 bit float
+	WaveNormalize normalize;        // Normalization of the level
+	float targetDb;                 // Target level of normalization in dBFS
+} WaveFormat;
+
+// Memory allocation callbacks, same layout as drwav_allocation_callbacks
+// NOTE: Functions taking a NULL allocator use malloc(), realloc() and free()
+typedef struct WaveAllocator {
+	void *userData;                                         // Passed to every callback
+	void *(*onMalloc)(size_t size, void *userData);
+	void *(*onRealloc)(void *ptr, size_t size, void *userData);
+	void (*onFree)(void *ptr, void *userData);
+} WaveAllocator;
+
+// Bump allocator for a single conversion job, reset between jobs
+// NOTE: After the first job, a job of equal or smaller size allocates nothing from the system
+typedef struct WaveArena {
+	struct WaveArenaBlock *block;   // Current block, older blocks are chained behind it
+	size_t used;                    // Bytes used by the current job across all blocks
+	size_t peak;                    // Most bytes used by a single job since init
+	unsigned long allocCount;       // Allocations served since init
+	unsigned long systemAllocCount; // Blocks requested from the system since init
+} WaveArena;
+
+// Generator of a wave rendered block by block, see LoadWaveGenerator()
+typedef struct WaveGenerator WaveGenerator;
+
+// Generator of up to WAVE_LANES waves rendered side by side in SIMD lanes, see LoadWaveLanes()
+typedef struct WaveLanes WaveLanes;
+
+// Real-time mixer of a fixed pool of voices, see LoadWaveMixer()
+typedef struct WaveMixer WaveMixer;
+
+// Counters of a mixer since it was loaded
+// NOTE: Read them on the audio thread, or while it is not mixing
+typedef struct WaveMixerStats {
+	unsigned long long blockCount;      // Blocks mixed
+	unsigned long long sampleCount;     // Samples mixed
+	unsigned long long triggerCount;    // Voices started
+	unsigned long long stealCount;      // Voices cut short to start a newer one
+	unsigned long long dropCount;       // Triggers refused because the queue was full
+	unsigned int activeVoices;          // Voices playing after the last block
+	unsigned int peakVoices;            // Most voices playing at the end of a block
+} WaveMixerStats;
+
+RFXGENAPI WaveParams *LoadWaveParams(const char *fileName, const WaveAllocator *allocator); // Load wave parameters from file
+RFXGENAPI void UnloadWaveParams(WaveParams *params, const WaveAllocator *allocator); // Unload wave parameters
+RFXGENAPI bool SaveWaveParams(const WaveParams *params, const char *fileName);      // Save wave parameters to file
+RFXGENAPI void MutateWaveParams(WaveParams *params, float amount, unsigned int seed); // Randomly perturb wave parameters by up to amount
+RFXGENAPI void GenerateWavePreset(WaveParams *params, WavePreset preset, unsigned int seed); // Generate random wave parameters of a category
+RFXGENAPI const char *GetWavePresetName(WavePreset preset);                         // Get name of a preset category, NULL if out of range
+RFXGENAPI Wave GenerateWave(WaveParams *params, const WaveAllocator *allocator);    // Generate wave data from parameters
+RFXGENAPI Wave GenerateWaveEx(WaveParams *params, const WaveAllocator *allocator, WaveStats *stats,
+		WaveOverview *overview, WaveProfile *profile);                      // Generate wave data, its statistics, overview and profile
+RFXGENAPI void UnloadWave(Wave wave, const WaveAllocator *allocator);               // Unload wave data
+RFXGENAPI unsigned int GetWaveSampleCount(const WaveParams *params);                // Get number of samples a wave will have, without generating it
+
+RFXGENAPI WaveGenerator *LoadWaveGenerator(const WaveParams *params, const WaveAllocator *allocator); // Derive generator state from wave parameters
+RFXGENAPI void ResetWaveGenerator(WaveGenerator *generator, const WaveParams *params); // Restart generator with new parameters, without allocating
+RFXGENAPI unsigned int RenderWaveBlock(WaveGenerator *generator, float *buffer, unsigned int count); // Render up to count samples, fewer once the wave ends
+RFXGENAPI void GetWaveGeneratorStats(const WaveGenerator *generator, WaveStats *stats); // Get statistics of the samples rendered so far
+RFXGENAPI void UnloadWaveGenerator(WaveGenerator *generator, const WaveAllocator *allocator); // Unload generator
+
+RFXGENAPI WaveLanes *LoadWaveLanes(const WaveAllocator *allocator);                  // Load lane generator with every lane empty
+RFXGENAPI void SetWaveLane(WaveLanes *lanes, int lane, const WaveParams *params);  // Start a wave in a lane, or empty it if params is NULL, without allocating
+RFXGENAPI unsigned int RenderWaveLanes(WaveLanes *lanes, float *const *buffers, unsigned int count,
+		unsigned int *rendered);                                            // Render up to count samples of every lane, returns mask of lanes still playing
+RFXGENAPI void GetWaveLaneStats(const WaveLanes *lanes, int lane, WaveStats *stats); // Get statistics of the samples of a lane since its wave started
+RFXGENAPI void UnloadWaveLanes(WaveLanes *lanes, const WaveAllocator *allocator);  // Unload lane generator
+RFXGENAPI int GenerateWaves(const WaveParams *params, int count, Wave *waves, WaveStats *stats,
+		const WaveAllocator *allocator);                                    // Generate several waves side by side, returns the number generated
+RFXGENAPI int GenerateWaveVariations(const WaveParams *params, float amount, unsigned int seed, int count,
+		WaveParams *variations, Wave *waves, WaveStats *stats, const WaveAllocator *allocator); // Generate random variations of a wave side by side, returns the number generated
+
+RFXGENAPI WaveMixer *LoadWaveMixer(unsigned int voiceCount, unsigned int queueCapacity, const WaveAllocator *allocator); // Preallocate mixer voices and trigger queue
+RFXGENAPI bool TriggerWaveVoice(WaveMixer *mixer, const WaveParams *params, float volume); // Queue a wave to play, from any thread, false if the queue is full
+RFXGENAPI void MixWaveBlock(WaveMixer *mixer, float *buffer, unsigned int count); // Mix count samples of the playing voices, from the audio thread
+RFXGENAPI void GetWaveMixerStats(const WaveMixer *mixer, WaveMixerStats *stats); // Get counters of the mixer
+RFXGENAPI void UnloadWaveMixer(WaveMixer *mixer, const WaveAllocator *allocator); // Unload mixer and its voices
+
+RFXGENAPI void ResetWaveStats(WaveStats *stats);                                    // Reset statistics to an empty wave
+RFXGENAPI void MergeWaveStats(WaveStats *total, const WaveStats *stats);            // Add wave statistics to a total
+RFXGENAPI float GetWavePeakGain(const WaveStats *stats, float targetDb);            // Get gain normalizing peak to targetDb dBFS
+RFXGENAPI float GetWaveRmsGain(const WaveStats *stats, float targetDb);             // Get gain normalizing RMS to targetDb dBFS
+RFXGENAPI bool IsWaveProfileEnabled(void);                                          // Check if profiles are recorded
+RFXGENAPI void ResetWaveProfile(WaveProfile *profile);                              // Reset profile to an empty wave
+RFXGENAPI void MergeWaveProfile(WaveProfile *total, const WaveProfile *profile);    // Add wave profile to a total
+RFXGENAPI const char *GetWaveStageName(WaveStage stage);                            // Get name of a generation stage
+RFXGENAPI bool ExportWaveOverview(const WaveOverview *overview, float gain, const char *fileName); // Export overview to a sidecar file
+RFXGENAPI unsigned int ConvertWaveSamples(void *dst, const float *src, unsigned int count,
+		unsigned int sampleSize, float gain);                               // Convert float samples to 8/16/24 bit PCM or 32 bit float
+RFXGENAPI unsigned char *ExportWaveToMemory(const WaveParams *params, WaveFormat format,
+		const WaveAllocator *allocator, size_t *dataSize);                  // Render wave to WAV file data in memory
+RFXGENAPI size_t ExportWaveToBuffer(const WaveParams *params, WaveFormat format,
+		const WaveAllocator *allocator, void *buffer, size_t bufferSize);   // Render wave to WAV file data in a caller buffer, returns the size needed
+RFXGENAPI void UnloadWaveData(unsigned char *data, const WaveAllocator *allocator); // Unload WAV file data exported to memory
+
+RFXGENAPI int GetWaveKernelCount(void);                     // Get number of render kernels built in
+RFXGENAPI const char *GetWaveKernelName(int index);         // Get name of a built in render kernel, NULL if out of range
+RFXGENAPI bool IsWaveKernelSupported(const char *name);     // Check if a render kernel is built in and supported by the CPU
+RFXGENAPI bool SetWaveKernel(const char *name);             // Select render kernel by name, NULL for the best supported
+RFXGENAPI const char *GetActiveWaveKernel(void);            // Get name of the render kernel in use
+
+RFXGENAPI bool InitWaveArena(WaveArena *arena, size_t capacity); // Initialise arena with an initial block of capacity bytes
+RFXGENAPI void ResetWaveArena(WaveArena *arena);            // Release all allocations, keeping memory for the next job
+RFXGENAPI void FreeWaveArena(WaveArena *arena);             // Return all arena memory to the system
+RFXGENAPI WaveAllocator GetWaveArenaAllocator(WaveArena *arena); // Get allocation callbacks serving from arena
@@ -0,0 +1,106 @@
+#pragma once
+
+/* Single producer, single consumer ring buffer of audio in POSIX shared
+ * memory, so that a player in another process can start playing a wave while
+ * it is still being rendered, without copying it through a socket or file.
+ *
+ * Layout of the shared memory object, all integers in native byte order:
+ *   offset size
+ *        0    4  RING_MAGIC
+ *        4    4  RING_VERSION
+ *        8    4  sample rate in Hz
+ *       12    4  channels
+ *       16    4  bits per sample: 8 bit unsigned, 16 or 24 bit signed PCM,
+ *                or 32 bit float, as in WAV files
+ *       20    4  capacity of the data area in bytes, a power of two
+ *       24    4  state, enum ring_state
+ *       64    8  write position, total bytes written by the producer
+ *      128    8  read position, total bytes consumed by the consumer
+ *      192       data area
+ * Byte n of the stream is at data[n % capacity]. The producer only writes
+ * the write position and the consumer only the read position, each on its
+ * own cache line. The producer stores the data before the write position and
+ * the consumer reads the data before storing the read position, both with
+ * release semantics, so no locks are needed. The stream has ended once the
+ * state is no longer RING_STREAMING and the read position has reached the
+ * write position. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RING_MAGIC		"RFXR"
+#define RING_VERSION		1
+
+enum ring_state
+{
+	/* The header is still being written. */
+	RING_INIT = 0,
+	RING_STREAMING,
+	/* All data has been written. */
+	RING_FINISHED,
+	/* The producer failed; data may be incomplete. */
+	RING_FAILED
+};
+
+struct ring_header
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t sample_rate;
+	uint32_t channels;
+	uint32_t bits;
+	uint32_t capacity;
+	uint32_t state;
+	unsigned char reserved0[36];
+	uint64_t write;
+	unsigned char reserved1[56];
+	uint64_t read;
+	unsigned char reserved2[56];
+};
+
+struct ring
+{
+	struct ring_header *header;
+	unsigned char *data;
+	/* Capacity of the data area, checked when the ring was mapped, as the
+	 * header can be written by the other process at any time. */
+	size_t capacity;
+	size_t map_size;
+	/* Name to unlink on ring_close(), or NULL for consumers. */
+	char *name;
+};
+
+/* Creates the shared memory object name, replacing any existing one, with a
+ * data area of at least capacity bytes. Returns 0 on success. */
+int ring_create(struct ring *r, const char *name, size_t capacity,
+		unsigned int sample_rate, unsigned int channels,
+		unsigned int bits);
+
+/* Maps the existing ring name as its consumer. Returns 0 on success, or -1
+ * if it does not exist, its producer has not finished creating it, or it is
+ * not a valid ring. */
+int ring_open(struct ring *r, const char *name);
+
+/* Writes len bytes, waiting for the consumer to free space as needed. Gives
+ * up once the consumer makes no progress for timeout_ms milliseconds.
+ * Returns the number of bytes written. */
+size_t ring_write(struct ring *r, const void *buf, size_t len,
+		unsigned int timeout_ms);
+
+/* Reads up to len bytes that are available without waiting. Returns the
+ * number of bytes read. */
+size_t ring_read(struct ring *r, void *buf, size_t len);
+
+/* Ends the stream, as RING_FINISHED or RING_FAILED. */
+void ring_finish(struct ring *r, enum ring_state state);
+
+/* Returns the state of the ring. */
+enum ring_state ring_state(const struct ring *r);
+
+/* Waits up to timeout_ms milliseconds for the consumer to read all data.
+ * Returns 0 if it did. */
+int ring_wait_drained(struct ring *r, unsigned int timeout_ms);
+
+/* Unmaps the ring, and removes the shared memory object if this process
+ * created it. */
+void ring_close(struct ring *r);
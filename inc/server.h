@@ -0,0 +1,75 @@
+#pragma once
+
+/* Render server. A pool of workers with preallocated memory renders effects
+ * requested over a Unix domain socket, so that tools previewing many effects
+ * avoid starting a process, loading the generator and writing a temporary
+ * file for each one.
+ *
+ * Protocol: a client connects to the socket and sends requests, reading one
+ * response for each request in order. A connection may carry any number of
+ * requests and is served by one worker until it is closed, or until it has
+ * been idle for SERVER_IDLE_TIMEOUT seconds, after which the server closes it.
+ * All integers are little-endian.
+ *
+ * Request header, SERVER_REQUEST_SIZE bytes:
+ *   offset size
+ *        0    4  SERVER_MAGIC
+ *        4    1  command, enum server_command
+ *        5    1  output, enum server_output
+ *        6    1  bits per sample: 8, 16 or 24 bit PCM, or 32 bit float
+ *        7    1  normalization, WaveNormalize: 0 none, 1 peak, 2 RMS
+ *        8    4  target level of normalization in dBFS, IEEE float
+ *       12    4  length of the payload that follows
+ * The payload is the 96 bytes of WaveParams as stored in .rfx files for
+ * SERVER_RENDER_PARAMS, the path of an .rfx file readable by the server for
+ * SERVER_RENDER_FILE, and empty for SERVER_STATS.
+ *
+ * Response header, SERVER_RESPONSE_SIZE bytes:
+ *   offset size
+ *        0    4  status, enum server_status
+ *        4    4  length of the payload that follows
+ * The payload is the WAV file or the PCM samples of a render, a JSON object
+ * of request counts and latency histograms for SERVER_STATS, or an error
+ * message. The server closes the connection after a malformed request. */
+
+#define SERVER_MAGIC		"RFXS"
+#define SERVER_REQUEST_SIZE	16
+#define SERVER_RESPONSE_SIZE	8
+
+/* Seconds a connection may wait between requests, or take to send or read
+ * one, before the server closes it to free its worker for other clients. */
+#define SERVER_IDLE_TIMEOUT	10
+
+/* Most workers a server runs, however many are asked for. */
+#define SERVER_MAX_WORKERS	256
+
+/* Longest path of a SERVER_RENDER_FILE request, including its terminator. */
+#define SERVER_MAX_PATH		4096
+
+enum server_command
+{
+	SERVER_RENDER_PARAMS = 0,
+	SERVER_RENDER_FILE = 1,
+	SERVER_STATS = 2
+};
+
+enum server_output
+{
+	/* A complete WAV file. */
+	SERVER_OUTPUT_WAV = 0,
+	/* Samples only, mono at WAVE_SAMPLE_RATE. */
+	SERVER_OUTPUT_PCM = 1
+};
+
+enum server_status
+{
+	SERVER_OK = 0,
+	SERVER_BAD_REQUEST = 1,
+	SERVER_RENDER_FAILED = 2
+};
+
+/* Serves requests on a new socket at path with worker_count workers, at most
+ * SERVER_MAX_WORKERS, until the process receives SIGINT or SIGTERM. Replaces
+ * any socket already at path and removes it on exit. Prints each request to
+ * stderr if verbose. Returns 0 after a clean shutdown. */
+int server_run(const char *path, unsigned int worker_count, int verbose);
@@ -0,0 +1,44 @@
+#pragma once
+
+/* Minimal portable threads, using POSIX threads or the Win32 API. */
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <pthread.h>
+#endif
+
+struct thread
+{
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+	void (*fn)(void *arg);
+	void *arg;
+};
+
+struct mutex
+{
+#ifdef _WIN32
+	CRITICAL_SECTION cs;
+#else
+	pthread_mutex_t m;
+#endif
+};
+
+/* Starts fn(arg) on a new thread. t must remain valid until thread_join().
+ * Returns 0 on success. */
+int thread_start(struct thread *t, void (*fn)(void *arg), void *arg);
+
+/* Waits for a thread started by thread_start() to return. */
+void thread_join(struct thread *t);
+
+/* Returns the number of online processors, at least 1. */
+unsigned int thread_cpu_count(void);
+
+int mutex_init(struct mutex *m);
+void mutex_free(struct mutex *m);
+void mutex_lock(struct mutex *m);
+void mutex_unlock(struct mutex *m);
@@ -0,0 +1,55 @@
+#pragma once
+
+/* Records spans of work on each thread and writes them in the Chrome trace
+ * event format, which chrome://tracing and Perfetto can display. Each thread
+ * appends to its own buffer, so recording takes no locks. */
+
+#include <stddef.h>
+
+struct trace_event
+{
+	const char *name;
+	/* Input file the span belongs to, or NULL. Must outlive the trace. */
+	const char *file;
+	/* Nanoseconds since trace_init(). */
+	unsigned long long start;
+	unsigned long long duration;
+};
+
+struct trace_thread
+{
+	struct trace_event *events;
+	size_t count;
+	size_t capacity;
+	/* Spans lost because memory could not be allocated. */
+	size_t dropped;
+};
+
+struct trace
+{
+	struct trace_thread *threads;
+	unsigned int thread_count;
+	/* Time of trace_init(), from trace_now(). */
+	unsigned long long origin;
+};
+
+/* Prepares a trace of thread_count threads. Returns 0 on success. */
+int trace_init(struct trace *t, unsigned int thread_count);
+
+void trace_free(struct trace *t);
+
+/* Returns a monotonic time in nanoseconds. */
+unsigned long long trace_now(void);
+
+/* Returns the start time of a span on thread tt, or 0 without reading the
+ * clock if tt is NULL. */
+unsigned long long trace_begin(const struct trace_thread *tt);
+
+/* Records a span called name on thread tt, from start until now. tt may be
+ * NULL when tracing is disabled, in which case nothing is recorded. Returns
+ * the end of the span. */
+unsigned long long trace_span(struct trace *t, struct trace_thread *tt,
+		const char *name, const char *file, unsigned long long start);
+
+/* Writes all recorded spans to path. Returns 0 on success. */
+int trace_write(const struct trace *t, const char *path);
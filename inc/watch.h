@@ -0,0 +1,22 @@
+#pragma once
+
+/* Watches a directory for files that are created or rewritten, using inotify
+ * on Linux. Editors often write a file several times when saving it, and
+ * tools may touch many files at once, so changes are reported in bursts: once
+ * no change has arrived for WATCH_QUIET_MS, or WATCH_MAX_DELAY_MS after the
+ * first change of a burst, each changed file is reported once. */
+
+/* Time without changes that ends a burst. */
+#define WATCH_QUIET_MS		10
+
+/* Longest time a change waits to be reported while changes keep arriving. */
+#define WATCH_MAX_DELAY_MS	500
+
+/* Called with the path of each changed file, dir/name. */
+typedef void (*watch_fn)(const char *path, void *arg);
+
+/* Reports changes to files in dir whose name ends with suffix until an error
+ * occurs. If the kernel drops events, every matching file in dir is reported.
+ * Returns -1 if dir could not be watched or the watch failed. */
+int watch_run(const char *dir, const char *suffix, watch_fn changed,
+		void *arg);
@@ -0,0 +1,12 @@
+#pragma once
+
+// Allocation helpers shared by the sources of librfxgen, not part of its API
+// NOTE: Not marked RFXGENAPI, so the shared library keeps them hidden
+
+#include <stddef.h>		// Required for: size_t
+
+#include <rfxgen.h>
+
+void *WaveMalloc(size_t size, const WaveAllocator *allocator);               // Allocate with the callbacks of allocator, or malloc() if NULL
+void *WaveRealloc(void *ptr, size_t size, const WaveAllocator *allocator);   // Reallocate with the callbacks of allocator, or realloc() if NULL
+void WaveFree(void *ptr, const WaveAllocator *allocator);                    // Free with the callbacks of allocator, or free() if NULL
@@ -0,0 +1,194 @@
+#include <stdlib.h>		// Required for: malloc(), free()
+#include <string.h>		// Required for: memcpy()
+
+#include <rfxgen.h>
+
+// Every allocation is prefixed with its size and aligned for any scalar type
+#define ARENA_ALIGN		16
+#define ARENA_HEADER		ARENA_ALIGN
+#define ARENA_MIN_BLOCK		(64*1024)
+
+#define ARENA_ROUND(x)		(((x) + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1))
+
+struct WaveArenaBlock
+{
+	struct WaveArenaBlock *prev;    // Block filled before this one, or NULL
+	size_t capacity;                // Usable bytes following the block header
+	size_t used;                    // Bytes handed out from this block
+	size_t last;                    // Offset of the most recent allocation header
+};
+
+#define ARENA_BLOCK_DATA(b)	((unsigned char *)(b) + ARENA_ROUND(sizeof(struct WaveArenaBlock)))
+
+static struct WaveArenaBlock *NewArenaBlock(WaveArena *arena, size_t capacity)
+{
+	struct WaveArenaBlock *b;
+
+	capacity = ARENA_ROUND(capacity);
+	b = malloc(ARENA_ROUND(sizeof(struct WaveArenaBlock)) + capacity);
+	if(b == NULL)
+		return NULL;
+
+	b->prev = arena->block;
+	b->capacity = capacity;
+	b->used = 0;
+	b->last = 0;
+	arena->block = b;
+	arena->systemAllocCount++;
+
+	return b;
+}
+
+static void FreeArenaBlocks(WaveArena *arena)
+{
+	struct WaveArenaBlock *b = arena->block;
+
+	while(b != NULL)
+	{
+		struct WaveArenaBlock *prev = b->prev;
+		free(b);
+		b = prev;
+	}
+
+	arena->block = NULL;
+}
+
+static void *ArenaMalloc(size_t size, void *userData)
+{
+	WaveArena *arena = userData;
+	struct WaveArenaBlock *b = arena->block;
+	size_t need = ARENA_HEADER + ARENA_ROUND(size);
+	unsigned char *p;
+
+	if(b == NULL || b->capacity - b->used < need)
+	{
+		size_t capacity = need;
+
+		if(b != NULL && capacity < b->capacity*2)
+			capacity = b->capacity*2;
+
+		if(capacity < ARENA_MIN_BLOCK)
+			capacity = ARENA_MIN_BLOCK;
+
+		b = NewArenaBlock(arena, capacity);
+		if(b == NULL)
+			return NULL;
+	}
+
+	p = ARENA_BLOCK_DATA(b) + b->used;
+	memcpy(p, &size, sizeof(size));
+
+	b->last = b->used;
+	b->used += need;
+	arena->used += need;
+	arena->allocCount++;
+
+	if(arena->used > arena->peak)
+		arena->peak = arena->used;
+
+	return p + ARENA_HEADER;
+}
+
+static void *ArenaRealloc(void *ptr, size_t size, void *userData)
+{
+	WaveArena *arena = userData;
+	struct WaveArenaBlock *b = arena->block;
+	unsigned char *hdr;
+	size_t old;
+	void *p;
+
+	if(ptr == NULL)
+		return ArenaMalloc(size, userData);
+
+	hdr = (unsigned char *)ptr - ARENA_HEADER;
+	memcpy(&old, hdr, sizeof(old));
+
+	// The most recent allocation may grow or shrink in place
+	if(hdr == ARENA_BLOCK_DATA(b) + b->last &&
+		b->capacity - b->last >= ARENA_HEADER + ARENA_ROUND(size))
+	{
+		size_t was = b->used;
+
+		b->used = b->last + ARENA_HEADER + ARENA_ROUND(size);
+		arena->used = arena->used - was + b->used;
+		memcpy(hdr, &size, sizeof(size));
+
+		if(arena->used > arena->peak)
+			arena->peak = arena->used;
+
+		return ptr;
+	}
+
+	p = ArenaMalloc(size, userData);
+	if(p != NULL)
+		memcpy(p, ptr, old < size ? old : size);
+
+	return p;
+}
+
+static void ArenaFree(void *ptr, void *userData)
+{
+	WaveArena *arena = userData;
+	struct WaveArenaBlock *b = arena->block;
+
+	// Only the most recent allocation is returned, the rest is released on reset
+	if(ptr != NULL && (unsigned char *)ptr - ARENA_HEADER == ARENA_BLOCK_DATA(b) + b->last)
+	{
+		arena->used -= b->used - b->last;
+		b->used = b->last;
+	}
+}
+
+bool InitWaveArena(WaveArena *arena, size_t capacity)
+{
+	arena->block = NULL;
+	arena->used = 0;
+	arena->peak = 0;
+	arena->allocCount = 0;
+	arena->systemAllocCount = 0;
+
+	if(capacity == 0)
+		return true;
+
+	return NewArenaBlock(arena, capacity) != NULL;
+}
+
+void ResetWaveArena(WaveArena *arena)
+{
+	struct WaveArenaBlock *b = arena->block;
+
+	arena->used = 0;
+
+	if(b == NULL)
+		return;
+
+	// The previous job overflowed into several blocks, so replace them with
+	// a single block large enough for the largest job seen so far.
+	if(b->prev != NULL)
+	{
+		FreeArenaBlocks(arena);
+		NewArenaBlock(arena, arena->peak);
+		return;
+	}
+
+	b->used = 0;
+	b->last = 0;
+}
+
+void FreeWaveArena(WaveArena *arena)
+{
+	FreeArenaBlocks(arena);
+	arena->used = 0;
+}
+
+WaveAllocator GetWaveArenaAllocator(WaveArena *arena)
+{
+	WaveAllocator allocator;
+
+	allocator.userData = arena;
+	allocator.onMalloc = ArenaMalloc;
+	allocator.onRealloc = ArenaRealloc;
+	allocator.onFree = ArenaFree;
+
+	return allocator;
+}
@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <json.h>
+
+/* Nesting limit, keeps malformed input from exhausting the stack. */
+#define JSON_MAX_DEPTH	64
+
+struct parser
+{
+	const char *p;
+	int depth;
+};
+
+static struct json *parse_value(struct parser *ps);
+
+static void skip_space(struct parser *ps)
+{
+	while(*ps->p == ' ' || *ps->p == '\t' || *ps->p == '\n' ||
+		*ps->p == '\r')
+		ps->p++;
+}
+
+static struct json *new_value(enum json_type type)
+{
+	struct json *j = calloc(1, sizeof(*j));
+
+	if(j != NULL)
+		j->type = type;
+
+	return j;
+}
+
+/* Parses a string literal. Escaped code points beyond ASCII are replaced with
+ * '?', which is sufficient for benchmark names and file paths. */
+static char *parse_string(struct parser *ps)
+{
+	const char *start;
+	char *s, *d;
+
+	if(*ps->p != '"')
+		return NULL;
+
+	start = ++ps->p;
+	while(*ps->p != '"')
+	{
+		if(*ps->p == '\0')
+			return NULL;
+
+		if(*ps->p == '\\' && ps->p[1] != '\0')
+			ps->p++;
+
+		ps->p++;
+	}
+
+	s = d = malloc((size_t)(ps->p - start) + 1);
+	if(s == NULL)
+		return NULL;
+
+	for(; start < ps->p; start++)
+	{
+		if(*start != '\\')
+		{
+			*d++ = *start;
+			continue;
+		}
+
+		switch(*++start)
+		{
+		case 'b': *d++ = '\b'; break;
+		case 'f': *d++ = '\f'; break;
+		case 'n': *d++ = '\n'; break;
+		case 'r': *d++ = '\r'; break;
+		case 't': *d++ = '\t'; break;
+		case 'u':
+		{
+			unsigned int cp = 0;
+			int i;
+
+			for(i = 0; i < 4 && start[1] != '\0' && start + 1 < ps->p; i++)
+			{
+				char c = *++start;
+				cp <<= 4;
+
+				if(c >= '0' && c <= '9')
+					cp |= (unsigned int)(c - '0');
+				else if(c >= 'a' && c <= 'f')
+					cp |= (unsigned int)(c - 'a' + 10);
+				else if(c >= 'A' && c <= 'F')
+					cp |= (unsigned int)(c - 'A' + 10);
+			}
+
+			*d++ = cp < 0x80 ? (char)cp : '?';
+			break;
+		}
+		default: *d++ = *start; break;
+		}
+	}
+
+	*d = '\0';
+	ps->p++;
+	return s;
+}
+
+static int parse_members(struct parser *ps, struct json *parent, char close,
+		int keyed)
+{
+	struct json **tail = &parent->child;
+
+	skip_space(ps);
+	if(*ps->p == close)
+	{
+		ps->p++;
+		return 1;
+	}
+
+	for(;;)
+	{
+		char *key = NULL;
+		struct json *v;
+
+		skip_space(ps);
+
+		if(keyed)
+		{
+			key = parse_string(ps);
+			if(key == NULL)
+				return 0;
+
+			skip_space(ps);
+			if(*ps->p != ':')
+			{
+				free(key);
+				return 0;
+			}
+
+			ps->p++;
+		}
+
+		v = parse_value(ps);
+		if(v == NULL)
+		{
+			free(key);
+			return 0;
+		}
+
+		v->key = key;
+		*tail = v;
+		tail = &v->next;
+
+		skip_space(ps);
+		if(*ps->p == ',')
+		{
+			ps->p++;
+			continue;
+		}
+
+		if(*ps->p != close)
+			return 0;
+
+		ps->p++;
+		return 1;
+	}
+}
+
+static struct json *parse_value(struct parser *ps)
+{
+	struct json *j = NULL;
+
+	skip_space(ps);
+
+	switch(*ps->p)
+	{
+	case '{':
+	case '[':
+	{
+		int keyed = *ps->p == '{';
+
+		if(++ps->depth > JSON_MAX_DEPTH)
+			return NULL;
+
+		ps->p++;
+		j = new_value(keyed ? JSON_OBJECT : JSON_ARRAY);
+		if(j == NULL || !parse_members(ps, j, keyed ? '}' : ']', keyed))
+		{
+			json_free(j);
+			return NULL;
+		}
+
+		ps->depth--;
+		break;
+	}
+
+	case '"':
+		j = new_value(JSON_STRING);
+		if(j == NULL || (j->string = parse_string(ps)) == NULL)
+		{
+			json_free(j);
+			return NULL;
+		}
+		break;
+
+	case 't':
+	case 'f':
+	case 'n':
+	{
+		static const char *const words[] = { "true", "false", "null" };
+		int i;
+
+		for(i = 0; i < 3; i++)
+		{
+			size_t len = strlen(words[i]);
+
+			if(strncmp(ps->p, words[i], len) == 0)
+			{
+				ps->p += len;
+				j = new_value(i == 2 ? JSON_NULL : JSON_BOOL);
+				if(j != NULL)
+					j->number = i == 0;
+				break;
+			}
+		}
+		break;
+	}
+
+	default:
+	{
+		char *end;
+		double d = strtod(ps->p, &end);
+
+		if(end == ps->p)
+			return NULL;
+
+		ps->p = end;
+		j = new_value(JSON_NUMBER);
+		if(j != NULL)
+			j->number = d;
+		break;
+	}
+	}
+
+	return j;
+}
+
+struct json *json_parse(const char *text)
+{
+	struct parser ps;
+	struct json *j;
+
+	ps.p = text;
+	ps.depth = 0;
+
+	j = parse_value(&ps);
+	if(j == NULL)
+		return NULL;
+
+	skip_space(&ps);
+	if(*ps.p != '\0')
+	{
+		json_free(j);
+		return NULL;
+	}
+
+	return j;
+}
+
+struct json *json_load(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	struct json *j = NULL;
+	char *text = NULL;
+	long len;
+
+	if(f == NULL)
+		return NULL;
+
+	if(fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) < 0 ||
+		fseek(f, 0, SEEK_SET) != 0)
+		goto out;
+
+	text = malloc((size_t)len + 1);
+	if(text == NULL || fread(text, 1, (size_t)len, f) != (size_t)len)
+		goto out;
+
+	text[len] = '\0';
+	j = json_parse(text);
+
+out:
+	free(text);
+	fclose(f);
+	return j;
+}
+
+void json_free(struct json *j)
+{
+	while(j != NULL)
+	{
+		struct json *next = j->next;
+
+		json_free(j->child);
+		free(j->string);
+		free(j->key);
+		free(j);
+		j = next;
+	}
+}
+
+const struct json *json_get(const struct json *obj, const char *key)
+{
+	const struct json *m;
+
+	if(obj == NULL || obj->type != JSON_OBJECT)
+		return NULL;
+
+	for(m = obj->child; m != NULL; m = m->next)
+	{
+		if(m->key != NULL && strcmp(m->key, key) == 0)
+			return m;
+	}
+
+	return NULL;
+}
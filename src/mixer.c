@@ -0,0 +1,319 @@
+#include <string.h>		// Required for: memset()
+
+#include <rfxgen.h>
+
+#include "alloc.h"
+
+// Samples rendered from a group of voices at a time before mixing them into the output
+#define MIXER_SCRATCH		256
+
+// Keeps the producer and consumer positions of the queue on separate cache lines
+#define MIXER_CACHE_LINE	64
+
+// Atomics for the trigger queue, on unsigned int so that positions wrap around
+#if defined(_MSC_VER) && !defined(__clang__)
+	#include <intrin.h>	// Required for: _InterlockedOr(), _InterlockedExchange(), _InterlockedCompareExchange()
+
+	// NOTE: Interlocked functions are full barriers, stronger than needed but correct on every target
+	#define LoadRelaxed(p)		((unsigned int)_InterlockedOr((volatile long *)(p), 0))
+	#define LoadAcquire(p)		((unsigned int)_InterlockedOr((volatile long *)(p), 0))
+	#define StoreRelease(p, v)	_InterlockedExchange((volatile long *)(p), (long)(v))
+	#define AtomicIncrement(p)	_InterlockedIncrement((volatile long *)(p))
+
+	static bool CompareExchange(unsigned int *p, unsigned int expected, unsigned int desired)
+	{
+		return (unsigned int)_InterlockedCompareExchange((volatile long *)p, (long)desired, (long)expected) == expected;
+	}
+#else
+	#define LoadRelaxed(p)		__atomic_load_n(p, __ATOMIC_RELAXED)
+	#define LoadAcquire(p)		__atomic_load_n(p, __ATOMIC_ACQUIRE)
+	#define StoreRelease(p, v)	__atomic_store_n(p, v, __ATOMIC_RELEASE)
+	#define AtomicIncrement(p)	__atomic_fetch_add(p, 1, __ATOMIC_RELAXED)
+
+	static bool CompareExchange(unsigned int *p, unsigned int expected, unsigned int desired)
+	{
+		return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+	}
+#endif
+
+// Slot of the trigger queue
+// NOTE: The sequence tells whose turn the slot is: it equals the position of the slot
+// while free for a producer, the position plus one once filled for the consumer
+typedef struct WaveTrigger {
+	unsigned int sequence;
+	float volume;
+	WaveParams params;
+} WaveTrigger;
+
+// NOTE: Voice i plays in lane i%WAVE_LANES of group i/WAVE_LANES, so that the voices
+// of a group are rendered side by side in one pass
+typedef struct WaveVoice {
+	float volume;
+	unsigned long long start;       // Number of the trigger that started the voice, to steal the oldest
+	bool active;
+} WaveVoice;
+
+// NOTE: The queue is a bounded multiple producer, single consumer queue in the manner of
+// Dmitry Vyukov's: producers claim a position with a compare and swap and publish the slot
+// through its sequence, so neither side ever waits for the other.
+struct WaveMixer {
+	unsigned int enqueuePos;        // Next position claimed by a producer
+	unsigned int dropCount;         // Triggers refused because the queue was full
+	unsigned char padding[MIXER_CACHE_LINE];
+	unsigned int dequeuePos;        // Next position read by the audio thread
+	unsigned int queueMask;
+	WaveTrigger *queue;
+	WaveVoice *voices;
+	unsigned int voiceCount;
+	WaveLanes **groups;
+	unsigned int groupCount;
+	WaveMixerStats stats;
+	float scratch[WAVE_LANES][MIXER_SCRATCH];
+};
+
+// Returns the voice to start a new wave on: a free one, or else the oldest
+static WaveVoice *ChooseVoice(WaveMixer *mixer)
+{
+	WaveVoice *oldest = &mixer->voices[0];
+
+	for(unsigned int i = 0; i < mixer->voiceCount; i++)
+	{
+		WaveVoice *v = &mixer->voices[i];
+
+		if(!v->active)
+			return v;
+
+		if(v->start < oldest->start)
+			oldest = v;
+	}
+
+	mixer->stats.stealCount++;
+	return oldest;
+}
+
+// Starts waves queued since the last block, at most one per voice so that the time
+// spent on triggers in a block is bounded too; the rest wait for the next block
+static void StartQueuedVoices(WaveMixer *mixer)
+{
+	for(unsigned int n = 0; n < mixer->voiceCount; n++)
+	{
+		unsigned int pos = mixer->dequeuePos;
+		WaveTrigger *t = &mixer->queue[pos & mixer->queueMask];
+		WaveVoice *v;
+		unsigned int i;
+
+		if(LoadAcquire(&t->sequence) != pos + 1)
+			break;
+
+		v = ChooseVoice(mixer);
+		i = (unsigned int)(v - mixer->voices);
+		SetWaveLane(mixer->groups[i/WAVE_LANES], i%WAVE_LANES, &t->params);
+		v->volume = t->volume;
+		v->start = mixer->stats.triggerCount++;
+		v->active = true;
+
+		// Hand the slot back to the producers for the next lap of the queue
+		StoreRelease(&t->sequence, pos + mixer->queueMask + 1);
+		mixer->dequeuePos = pos + 1;
+	}
+}
+
+// Load a mixer of voiceCount voices and a trigger queue of queueCapacity triggers, rounded up
+// to a power of two. Everything the mixer needs is allocated here, so mixing allocates nothing.
+// NOTE: Returns NULL if out of memory or either count is 0
+WaveMixer *LoadWaveMixer(unsigned int voiceCount, unsigned int queueCapacity, const WaveAllocator *allocator)
+{
+	WaveMixer *mixer;
+	unsigned int capacity = 1;
+	unsigned int groupCount;
+
+	if(voiceCount == 0 || queueCapacity == 0 || queueCapacity > 0x40000000)
+		return NULL;
+
+	while(capacity < queueCapacity)
+		capacity <<= 1;
+
+	groupCount = (voiceCount + WAVE_LANES - 1)/WAVE_LANES;
+
+	mixer = WaveMalloc(sizeof(WaveMixer), allocator);
+	if(mixer == NULL)
+		return NULL;
+
+	memset(mixer, 0, sizeof(*mixer));
+	mixer->queue = WaveMalloc(capacity*sizeof(WaveTrigger), allocator);
+	mixer->voices = WaveMalloc(voiceCount*sizeof(WaveVoice), allocator);
+	mixer->groups = WaveMalloc(groupCount*sizeof(WaveLanes *), allocator);
+
+	if(mixer->queue == NULL || mixer->voices == NULL || mixer->groups == NULL)
+	{
+		UnloadWaveMixer(mixer, allocator);
+		return NULL;
+	}
+
+	mixer->queueMask = capacity - 1;
+	for(unsigned int i = 0; i < capacity; i++)
+		mixer->queue[i].sequence = i;
+
+	memset(mixer->voices, 0, voiceCount*sizeof(WaveVoice));
+	mixer->voiceCount = voiceCount;
+
+	for(unsigned int i = 0; i < groupCount; i++)
+	{
+		mixer->groups[i] = LoadWaveLanes(allocator);
+		mixer->groupCount++;
+
+		if(mixer->groups[i] == NULL)
+		{
+			UnloadWaveMixer(mixer, allocator);
+			return NULL;
+		}
+	}
+
+	// Select the render kernel now rather than on the audio thread
+	GetActiveWaveKernel();
+
+	return mixer;
+}
+
+// Queue a wave to start playing at volume in the next block, from any number of threads
+// NOTE: params is copied. Never blocks: returns false if the queue is full.
+bool TriggerWaveVoice(WaveMixer *mixer, const WaveParams *params, float volume)
+{
+	unsigned int pos = LoadRelaxed(&mixer->enqueuePos);
+	WaveTrigger *t;
+
+	for(;;)
+	{
+		unsigned int sequence;
+
+		t = &mixer->queue[pos & mixer->queueMask];
+		sequence = LoadAcquire(&t->sequence);
+
+		if(sequence == pos)
+		{
+			if(CompareExchange(&mixer->enqueuePos, pos, pos + 1))
+				break;
+		}
+		else if((int)(sequence - pos) < 0)
+		{
+			// The slot still holds a trigger from the previous lap
+			AtomicIncrement(&mixer->dropCount);
+			return false;
+		}
+
+		pos = LoadRelaxed(&mixer->enqueuePos);
+	}
+
+	t->params = *params;
+	t->volume = volume;
+	StoreRelease(&t->sequence, pos + 1);
+
+	return true;
+}
+
+// Returns the mask of the lanes of group g whose voices are playing
+static unsigned int GetActiveLanes(const WaveMixer *mixer, unsigned int g)
+{
+	unsigned int mask = 0;
+
+	for(unsigned int l = 0; l < WAVE_LANES; l++)
+	{
+		unsigned int i = g*WAVE_LANES + l;
+
+		if(i < mixer->voiceCount && mixer->voices[i].active)
+			mask |= 1u << l;
+	}
+
+	return mask;
+}
+
+// Mix count samples of every playing voice into buffer, starting queued waves first
+// NOTE: Only call from one thread at a time, normally the audio callback. Allocates nothing,
+// takes no locks and renders at most voiceCount voices, so its time per sample is bounded.
+// The output is the sum of the voices scaled by their volumes, it is not clamped.
+void MixWaveBlock(WaveMixer *mixer, float *buffer, unsigned int count)
+{
+	float *scratch[WAVE_LANES];
+	unsigned int active = 0;
+
+	StartQueuedVoices(mixer);
+	memset(buffer, 0, count*sizeof(float));
+
+	for(unsigned int l = 0; l < WAVE_LANES; l++)
+		scratch[l] = mixer->scratch[l];
+
+	// Groups without a playing voice are skipped, the others render all their lanes at once
+	for(unsigned int g = 0; g < mixer->groupCount; g++)
+	{
+		unsigned int playing = GetActiveLanes(mixer, g);
+		unsigned int done = 0;
+
+		while(playing != 0 && done < count)
+		{
+			unsigned int n = (count - done < MIXER_SCRATCH) ? count - done : MIXER_SCRATCH;
+			unsigned int rendered[WAVE_LANES];
+
+			RenderWaveLanes(mixer->groups[g], scratch, n, rendered);
+
+			for(unsigned int l = 0; l < WAVE_LANES; l++)
+			{
+				WaveVoice *v = &mixer->voices[g*WAVE_LANES + l];
+
+				if(!(playing & (1u << l)))
+					continue;
+
+				for(unsigned int j = 0; j < rendered[l]; j++)
+					buffer[done + j] += mixer->scratch[l][j]*v->volume;
+
+				if(rendered[l] < n)
+				{
+					v->active = false;
+					playing &= ~(1u << l);
+				}
+			}
+
+			done += n;
+		}
+
+		for(unsigned int l = 0; l < WAVE_LANES; l++)
+		{
+			if(playing & (1u << l))
+				active++;
+		}
+	}
+
+	mixer->stats.blockCount++;
+	mixer->stats.sampleCount += count;
+	mixer->stats.activeVoices = active;
+
+	if(active > mixer->stats.peakVoices)
+		mixer->stats.peakVoices = active;
+}
+
+void GetWaveMixerStats(const WaveMixer *mixer, WaveMixerStats *stats)
+{
+	*stats = mixer->stats;
+	stats->dropCount = LoadRelaxed((unsigned int *)&mixer->dropCount);
+}
+
+// Unload mixer loaded by LoadWaveMixer()
+// NOTE: No thread may trigger or mix with it any more
+void UnloadWaveMixer(WaveMixer *mixer, const WaveAllocator *allocator)
+{
+	if(mixer == NULL)
+		return;
+
+	if(mixer->groups != NULL)
+	{
+		for(unsigned int i = 0; i < mixer->groupCount; i++)
+		{
+			if(mixer->groups[i] != NULL)
+				UnloadWaveLanes(mixer->groups[i], allocator);
+		}
+	}
+
+	WaveFree(mixer->groups, allocator);
+	WaveFree(mixer->voices, allocator);
+	WaveFree(mixer->queue, allocator);
+	WaveFree(mixer, allocator);
+}
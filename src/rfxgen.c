@@ -77,68 +77,271 @@
 *
 **********************************************************************************************/
 
-#include <math.h>		// Required for: sinf(), pow()
+#include <math.h>		// Required for: sinf(), pow(), sqrt(), lrintf(), floorf(), ceilf()
 #include <stdbool.h>
+#include <stdint.h>		// Required for: uint32_t
 #include <stdio.h>		// Required for: FILE, fopen(), fread(), fwrite(), ftell(), fseek() fclose()
-#include <stdlib.h>		// Required for: calloc(), free()
-#include <string.h>		// Required for: strcmp()
+#include <stdlib.h>		// Required for: malloc(), realloc(), free(), qsort()
+#include <string.h>		// Required for: strncmp(), memcpy()
 
+#define DR_WAV_IMPLEMENTATION
+#include <dr_wav.h>		// Required for: drwav_init_memory_write(), drwav_init_write(), drwav_write_pcm_frames_le()
 #include <rfxgen.h>
 
+#include "alloc.h"
+
+// Filter and phaser state decays toward zero during long, quiet tails, where
+// subnormal arithmetic is 10-100x slower on most CPUs. Flush subnormals to zero
+// in hardware for the duration of a render where the CPU allows it, otherwise
+// flush the recurrence state in software once per sample.
+// NOTE: Define RFXGEN_NO_FLUSH_DENORMALS to disable both (used for benchmarking)
+#if !defined(RFXGEN_NO_FLUSH_DENORMALS)
+    #if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+        #include <xmmintrin.h>     // Required for: _mm_getcsr(), _mm_setcsr()
+        #define FLUSH_DENORMALS_MXCSR
+    #elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+        #define FLUSH_DENORMALS_FPCR
+    #else
+        #define FLUSH_DENORMALS_SOFTWARE
+    #endif
+#endif
+
+// Stage timing and event counting for GenerateWaveEx(), compiled out unless
+// RFXGEN_PROFILE is defined. Stages are timed with the CPU timestamp counter
+// where one can be read without a system call, otherwise only events are counted.
+#if defined(RFXGEN_PROFILE)
+    #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        #include <intrin.h>         // Required for: __rdtsc()
+        #define ReadCycleCounter() ((uint64_t)__rdtsc())
+    #elif (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+        #include <x86intrin.h>      // Required for: __rdtsc()
+        #define ReadCycleCounter() ((uint64_t)__rdtsc())
+    #elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+        #define ReadCycleCounter() ReadVirtualCounter()
+    #else
+        #define ReadCycleCounter() ((uint64_t)0)
+    #endif
+
+    #define PROFILE_START()         profileTime = ReadCycleCounter()
+    #define PROFILE_STAGE(stage)    do { uint64_t now = ReadCycleCounter(); state->profile.ticks[stage] += now - profileTime; profileTime = now; } while (0)
+    #define PROFILE_COUNT(event)    state->profile.event++
+#else
+    #define PROFILE_START()
+    #define PROFILE_STAGE(stage)
+    #define PROFILE_COUNT(event)
+#endif
+
+// Conversion kernels are compiled for several x86 instruction sets and selected at runtime,
+// which needs the target attribute and CPU detection of GCC or Clang
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #include <immintrin.h>          // Required for: SSE, AVX2 and AVX-512 intrinsics
+    #define WAVE_KERNELS_X86
+
+    #define STORE_SSE(p, v)         _mm_storeu_si128((__m128i *)(p), v)
+    #define STORE_AVX(p, v)         _mm256_storeu_si256((__m256i *)(p), v)
+    #define STORE_AVX512(p, v)      _mm512_storeu_si512((void *)(p), v)
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define WAVE_INLINE static inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+    #define WAVE_INLINE static __forceinline
+#else
+    #define WAVE_INLINE static inline
+#endif
+
+// The active kernel is selected lazily by whichever thread renders first, so it is read and
+// published atomically: threads racing to select it pick the same one, and a kernel chosen
+// with SetWaveKernel() is never replaced by a lazy selection
+#if defined(__GNUC__) || defined(__clang__)
+    #define LoadKernelPointer(p)                __atomic_load_n(p, __ATOMIC_ACQUIRE)
+    #define StoreKernelPointer(p, v)            __atomic_store_n(p, v, __ATOMIC_RELEASE)
+    #define InitKernelPointer(p, v)             do { const WaveKernel *expected = NULL; __atomic_compare_exchange_n(p, &expected, v, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE); } while (0)
+#elif defined(_MSC_VER)
+    #include <intrin.h>             // Required for: _InterlockedCompareExchangePointer(), _InterlockedExchangePointer()
+    #define LoadKernelPointer(p)                ((const WaveKernel *)_InterlockedCompareExchangePointer((void *volatile *)(p), NULL, NULL))
+    #define StoreKernelPointer(p, v)            _InterlockedExchangePointer((void *volatile *)(p), (void *)(v))
+    #define InitKernelPointer(p, v)             _InterlockedCompareExchangePointer((void *volatile *)(p), (void *)(v), NULL)
+#else
+    #define LoadKernelPointer(p)                (*(p))
+    #define StoreKernelPointer(p, v)            (*(p) = (v))
+    #define InitKernelPointer(p, v)             do { if (*(p) == NULL) *(p) = (v); } while (0)
+#endif
+
 #define PI 3.14159265358979323846
 
-//----------------------------------------------------------------------------------
-// Types and Structures Definition
-//----------------------------------------------------------------------------------
-// Wave parameters type (96 bytes)
-struct WaveParams
-{
-    // Random seed used to generate the wave
-    int randSeed;
-
-    // Wave type (square, sawtooth, sine, noise)
-    int waveTypeValue;
-
-    // Wave envelope parameters
-    float attackTimeValue;
-    float sustainTimeValue;
-    float sustainPunchValue;
-    float decayTimeValue;
-
-    // Frequency parameters
-    float startFrequencyValue;
-    float minFrequencyValue;
-    float slideValue;
-    float deltaSlideValue;
-    float vibratoDepthValue;
-    float vibratoSpeedValue;
-    //float vibratoPhaseDelayValue;
-
-    // Tone change parameters
-    float changeAmountValue;
-    float changeSpeedValue;
-
-    // Square wave parameters
-    float squareDutyValue;
-    float dutySweepValue;
-
-    // Repeat parameters
-    float repeatSpeedValue;
-
-    // Phaser parameters
-    float phaserOffsetValue;
-    float phaserSweepValue;
-
-    // Filter parameters
-    float lpfCutoffValue;
-    float lpfCutoffSweepValue;
-    float lpfResonanceValue;
-    float hpfCutoffValue;
-    float hpfCutoffSweepValue;
-};
+#define EXPORT_BLOCK        4096    // Samples converted at a time when exporting WAV data
+
+// Allocate memory with the given callbacks, or malloc() if there are none
+void *WaveMalloc(size_t size, const WaveAllocator *allocator)
+{
+	if (allocator == NULL)
+		return malloc(size);
+
+	return allocator->onMalloc(size, allocator->userData);
+}
+
+void *WaveRealloc(void *ptr, size_t size, const WaveAllocator *allocator)
+{
+	if (allocator == NULL)
+		return realloc(ptr, size);
+
+	return allocator->onRealloc(ptr, size, allocator->userData);
+}
+
+void WaveFree(void *ptr, const WaveAllocator *allocator)
+{
+	if (allocator == NULL)
+		free(ptr);
+	else
+		allocator->onFree(ptr, allocator->userData);
+}
+
+// Enable flush-to-zero and denormals-are-zero, returns the previous FPU state
+static unsigned long BeginFlushDenormals(void)
+{
+#if defined(FLUSH_DENORMALS_MXCSR)
+	unsigned long csr = _mm_getcsr();
+	_mm_setcsr(csr | 0x8040);   // FTZ (bit 15) and DAZ (bit 6)
+	return csr;
+#elif defined(FLUSH_DENORMALS_FPCR)
+	unsigned long fpcr;
+	__asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+	__asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr | (1UL << 24)));   // FZ (bit 24)
+	return fpcr;
+#else
+	return 0;
+#endif
+}
+
+// Restore the FPU state returned by BeginFlushDenormals()
+static void EndFlushDenormals(unsigned long state)
+{
+#if defined(FLUSH_DENORMALS_MXCSR)
+	_mm_setcsr((unsigned int)state);
+#elif defined(FLUSH_DENORMALS_FPCR)
+	__asm__ __volatile__("msr fpcr, %0" : : "r"(state));
+#else
+	(void)state;
+#endif
+}
+
+#if defined(RFXGEN_PROFILE) && defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+// Read the generic timer, which counts at a fixed frequency rather than CPU cycles
+static uint64_t ReadVirtualCounter(void)
+{
+	uint64_t count;
+	__asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(count));
+	return count;
+}
+#endif
+
+// FNV-1a over the little-endian bytes of each 32 bit float sample
+#define WAVE_CHECKSUM_INIT      0xcbf29ce484222325ULL
+#define WAVE_CHECKSUM_PRIME     0x100000001b3ULL
+
+static unsigned long long UpdateWaveChecksum(unsigned long long checksum, float sample)
+{
+	uint32_t bits;
+	unsigned int i;
+
+	memcpy(&bits, &sample, sizeof(bits));
+
+	for (i = 0; i < 4; i++)
+	{
+		checksum ^= (bits >> (i*8)) & 0xFF;
+		checksum *= WAVE_CHECKSUM_PRIME;
+	}
+
+	return checksum;
+}
+
+// Build the coarser levels of an overview from its finest level of binCount bins
+static void BuildWaveOverview(WaveOverview *overview, unsigned int sampleCount, unsigned int binCount)
+{
+	unsigned int level = 0;
+	unsigned int offset = 0;
+
+	overview->sampleCount = sampleCount;
+	overview->binCount[0] = binCount;
+	overview->levelOffset[0] = 0;
+
+	while ((overview->binCount[level] > 1) && (level + 1 < WAVE_OVERVIEW_MAX_LEVELS))
+	{
+		unsigned int prev = overview->levelOffset[level];
+		unsigned int count = (overview->binCount[level] + 1)/2;
+		unsigned int i;
+
+		offset += overview->binCount[level];
+		level++;
+		overview->binCount[level] = count;
+		overview->levelOffset[level] = offset;
+
+		for (i = 0; i < count; i++)
+		{
+			const float *a = overview->bins[prev + i*2];
+			const float *b = (i*2 + 1 < overview->binCount[level - 1]) ? overview->bins[prev + i*2 + 1] : a;
+
+			overview->bins[offset + i][0] = (a[0] < b[0]) ? a[0] : b[0];
+			overview->bins[offset + i][1] = (a[1] > b[1]) ? a[1] : b[1];
+		}
+	}
+
+	overview->levelCount = (binCount > 0) ? level + 1 : 0;
+}
+
+// Random number generator state, one per generated wave so that generation is reentrant
+// NOTE: Reproduces glibc rand() after srand(seed) (additive feedback, x[n] = x[n-3] + x[n-31]),
+// so waves sound the same as when they were generated with the C library generator on Linux
+typedef struct WaveRandom
+{
+	int32_t state[31];
+	int front;
+	int rear;
+} WaveRandom;
+
+// Returns a random value between 0 and 2147483647
+static int GetWaveRandom(WaveRandom *rng)
+{
+	uint32_t value = (uint32_t)rng->state[rng->front] + (uint32_t)rng->state[rng->rear];
+
+	rng->state[rng->front] = (int32_t)value;
+	rng->front = (rng->front + 1)%31;
+	rng->rear = (rng->rear + 1)%31;
+
+	return (int)(value >> 1);
+}
+
+// Seeds the generator the same way as glibc srand(), a seed of 0 is treated as 1
+static void SeedWaveRandom(WaveRandom *rng, unsigned int seed)
+{
+	int i;
+
+	if (seed == 0) seed = 1;
+
+	rng->state[0] = (int32_t)seed;
+
+	for (i = 1; i < 31; i++)
+	{
+		// 16807*state[i - 1] % 2147483647 without overflowing 32 bits (Schrage's method)
+		long word = rng->state[i - 1];
+		long hi = word/127773;
+		long lo = word%127773;
+
+		word = 16807*lo - 2836*hi;
+		if (word < 0) word += 2147483647;
+
+		rng->state[i] = (int32_t)word;
+	}
+
+	rng->front = 3;
+	rng->rear = 0;
+
+	for (i = 0; i < 310; i++) GetWaveRandom(rng);
+}
 
 // Returns a random value between min and max (both included)
-static int GetRandomValue(int min, int max)
+static int GetRandomValue(WaveRandom *rng, int min, int max)
 {
 	if (min > max)
 	{
@@ -147,54 +350,98 @@ static int GetRandomValue(int min, int max)
 		min = tmp;
 	}
 
-	return (rand()%(abs(max - min) + 1) + min);
+	return (GetWaveRandom(rng)%(abs(max - min) + 1) + min);
 }
 
-// Generates new wave from wave parameters
-// NOTE: By default wave is generated as 44100Hz, 32bit float, mono
-Wave GenerateWave(WaveParams *params)
-{
-    // NOTE: GetRandomValue() is provided by raylib and seed is initialized at InitWindow()
-    #define GetRandomFloat(range) ((float)GetRandomValue(0, 10000)/10000.0f*range)
-
-    if (params->randSeed != 0) srand(params->randSeed);   // Initialize seed if required
+// Values a wave restarts from when it repeats, derived from its parameters by InitWaveState()
+// NOTE: The other values reset on a repeat never change while generating
+typedef struct WaveRestart {
+    double fperiod;
+    double fslide;
+    int period;
+    float squareDuty;
+    int arpeggioLimit;
+} WaveRestart;
+
+// Generator state of a wave, carried from one block of samples to the next
+typedef struct WaveState {
+    WaveParams *params;             // Parameters being rendered
+    WaveRandom rng;                 // Random number generator seeded from the parameters
 
     // Configuration parameters for generation
     // NOTE: Those parameters are calculated from selected values
-    int phase = 0;
-    double fperiod = 0.0;
-    double fmaxperiod = 0.0;
-    double fslide = 0.0;
-    double fdslide = 0.0;
-    int period = 0;
-    float squareDuty = 0.0f;
-    float squareSlide = 0.0f;
-    int envelopeStage = 0;
-    int envelopeTime = 0;
-    int envelopeLength[3] = { 0 };
-    float envelopeVolume = 0.0f;
-    float fphase = 0.0f;
-    float fdphase = 0.0f;
-    int iphase = 0;
-    float phaserBuffer[1024] = { 0.0f };
-    int ipp = 0;
-    float noiseBuffer[32] = { 0.0f };       // Required for noise wave, depends on random seed!
-    float fltp = 0.0f;
-    float fltdp = 0.0f;
-    float fltw = 0.0f;
-    float fltwd = 0.0f;
-    float fltdmp = 0.0f;
-    float fltphp = 0.0f;
-    float flthp = 0.0f;
-    float flthpd = 0.0f;
-    float vibratoPhase = 0.0f;
-    float vibratoSpeed = 0.0f;
-    float vibratoAmplitude = 0.0f;
-    int repeatTime = 0;
-    int repeatLimit = 0;
-    int arpeggioTime = 0;
-    int arpeggioLimit = 0;
-    double arpeggioModulation = 0.0;
+    int phase;
+    double fperiod;
+    double fmaxperiod;
+    double fslide;
+    double fdslide;
+    int period;
+    float squareDuty;
+    float squareSlide;
+    int envelopeStage;
+    int envelopeTime;
+    int envelopeLength[3];
+    float envelopeVolume;
+    float fphase;
+    float fdphase;
+    int iphase;
+    float phaserBuffer[1024];
+    int ipp;
+    float noiseBuffer[32];          // Required for noise wave, depends on random seed!
+    float fltp;
+    float fltdp;
+    float fltw;
+    float fltwd;
+    float fltdmp;
+    float fltphp;
+    float flthp;
+    float flthpd;
+    float vibratoPhase;
+    float vibratoSpeed;
+    float vibratoAmplitude;
+    int repeatTime;
+    int repeatLimit;
+    int arpeggioTime;
+    int arpeggioLimit;
+    double arpeggioModulation;
+    WaveRestart restart;
+    bool lpfEnabled;
+    bool stopsAtMinFrequency;       // The wave ends once it slides down to the minimum frequency
+    bool generatingSample;          // Cleared once the envelope or the minimum frequency ends the wave
+    int sampleCount;                // Samples generated so far
+
+    // Output statistics, accumulated as samples are generated
+    float peak;
+    unsigned int clipCount;
+    double sum;
+    double sumSquares;
+    unsigned long long checksum;
+
+    // Overview being filled, or NULL, and its current bin
+    WaveOverview *overview;
+    float binMin;
+    float binMax;
+    int binFill;
+    int binIndex;
+
+    WaveProfile profile;            // Only recorded when built with RFXGEN_PROFILE
+} WaveState;
+
+// Returns a sample of noise between -1 and 1, with the resolution of rFXGen's GetRandomFloat()
+// NOTE: A seed of 0 gives the sequence of an unseeded C library generator
+WAVE_INLINE float GetNoiseSample(WaveRandom *rng)
+{
+    return (float)GetRandomValue(rng, 0, 10000)/10000.0f*2.0f - 1.0f;
+}
+
+// Initialise generator state from wave parameters
+// NOTE: Parameters are adjusted to avoid generation issues, overview may be NULL
+static void InitWaveState(WaveState *state, WaveParams *params, WaveOverview *overview)
+{
+    memset(state, 0, sizeof(*state));
+
+    state->params = params;
+    SeedWaveRandom(&state->rng, (unsigned int)params->randSeed);
 
     // HACK: Security check to avoid crash (why?)
     if (params->minFrequencyValue > params->startFrequencyValue) params->minFrequencyValue = params->startFrequencyValue;
@@ -202,66 +449,133 @@ Wave GenerateWave(WaveParams *params)
 
     // Reset sample parameters
     //----------------------------------------------------------------------------------------
-    fperiod = 100.0/(params->startFrequencyValue*params->startFrequencyValue + 0.001);
-    period = (int)fperiod;
-    fmaxperiod = 100.0/(params->minFrequencyValue*params->minFrequencyValue + 0.001);
-    fslide = 1.0 - pow((double)params->slideValue, 3.0)*0.01;
-    fdslide = -pow((double)params->deltaSlideValue, 3.0)*0.000001;
-    squareDuty = 0.5f - params->squareDutyValue*0.5f;
-    squareSlide = -params->dutySweepValue*0.00005f;
+    state->fperiod = 100.0/(params->startFrequencyValue*params->startFrequencyValue + 0.001);
+    state->period = (int)state->fperiod;
+    state->fmaxperiod = 100.0/(params->minFrequencyValue*params->minFrequencyValue + 0.001);
+    state->fslide = 1.0 - pow((double)params->slideValue, 3.0)*0.01;
+    state->fdslide = -pow((double)params->deltaSlideValue, 3.0)*0.000001;
+    state->squareDuty = 0.5f - params->squareDutyValue*0.5f;
+    state->squareSlide = -params->dutySweepValue*0.00005f;
 
-    if (params->changeAmountValue >= 0.0f) arpeggioModulation = 1.0 - pow((double)params->changeAmountValue, 2.0)*0.9;
-    else arpeggioModulation = 1.0 + pow((double)params->changeAmountValue, 2.0)*10.0;
+    if (params->changeAmountValue >= 0.0f) state->arpeggioModulation = 1.0 - pow((double)params->changeAmountValue, 2.0)*0.9;
+    else state->arpeggioModulation = 1.0 + pow((double)params->changeAmountValue, 2.0)*10.0;
 
-    arpeggioLimit = (int)(pow(1.0f - params->changeSpeedValue, 2.0f)*20000 + 32);
+    state->arpeggioLimit = (int)(pow(1.0f - params->changeSpeedValue, 2.0f)*20000 + 32);
 
-    if (params->changeSpeedValue == 1.0f) arpeggioLimit = 0;     // WATCH OUT: float comparison
+    if (params->changeSpeedValue == 1.0f) state->arpeggioLimit = 0;     // WATCH OUT: float comparison
+
+    state->restart.fperiod = state->fperiod;
+    state->restart.fslide = state->fslide;
+    state->restart.period = state->period;
+    state->restart.squareDuty = state->squareDuty;
+    state->restart.arpeggioLimit = state->arpeggioLimit;
 
     // Reset filter parameters
-    fltw = pow(params->lpfCutoffValue, 3.0f)*0.1f;
-    fltwd = 1.0f + params->lpfCutoffSweepValue*0.0001f;
-    fltdmp = 5.0f/(1.0f + pow(params->lpfResonanceValue, 2.0f)*20.0f)*(0.01f + fltw);
-    if (fltdmp > 0.8f) fltdmp = 0.8f;
-    flthp = pow(params->hpfCutoffValue, 2.0f)*0.1f;
-    flthpd = 1.0 + params->hpfCutoffSweepValue*0.0003f;
+    state->fltw = pow(params->lpfCutoffValue, 3.0f)*0.1f;
+    state->fltwd = 1.0f + params->lpfCutoffSweepValue*0.0001f;
+    state->fltdmp = 5.0f/(1.0f + pow(params->lpfResonanceValue, 2.0f)*20.0f)*(0.01f + state->fltw);
+    if (state->fltdmp > 0.8f) state->fltdmp = 0.8f;
+    state->flthp = pow(params->hpfCutoffValue, 2.0f)*0.1f;
+    state->flthpd = 1.0 + params->hpfCutoffSweepValue*0.0003f;
+    state->lpfEnabled = (params->lpfCutoffValue != 1.0f);     // WATCH OUT!
 
     // Reset vibrato
-    vibratoSpeed = pow(params->vibratoSpeedValue, 2.0f)*0.01f;
-    vibratoAmplitude = params->vibratoDepthValue*0.5f;
+    state->vibratoSpeed = pow(params->vibratoSpeedValue, 2.0f)*0.01f;
+    state->vibratoAmplitude = params->vibratoDepthValue*0.5f;
 
     // Reset envelope
-    envelopeLength[0] = (int)(params->attackTimeValue*params->attackTimeValue*100000.0f);
-    envelopeLength[1] = (int)(params->sustainTimeValue*params->sustainTimeValue*100000.0f);
-    envelopeLength[2] = (int)(params->decayTimeValue*params->decayTimeValue*100000.0f);
+    state->envelopeLength[0] = (int)(params->attackTimeValue*params->attackTimeValue*100000.0f);
+    state->envelopeLength[1] = (int)(params->sustainTimeValue*params->sustainTimeValue*100000.0f);
+    state->envelopeLength[2] = (int)(params->decayTimeValue*params->decayTimeValue*100000.0f);
 
-    fphase = pow(params->phaserOffsetValue, 2.0f)*1020.0f;
-    if (params->phaserOffsetValue < 0.0f) fphase = -fphase;
+    state->fphase = pow(params->phaserOffsetValue, 2.0f)*1020.0f;
+    if (params->phaserOffsetValue < 0.0f) state->fphase = -state->fphase;
 
-    fdphase = pow(params->phaserSweepValue, 2.0f)*1.0f;
-    if (params->phaserSweepValue < 0.0f) fdphase = -fdphase;
+    state->fdphase = pow(params->phaserSweepValue, 2.0f)*1.0f;
+    if (params->phaserSweepValue < 0.0f) state->fdphase = -state->fdphase;
 
-    iphase = abs((int)fphase);
+    state->iphase = abs((int)state->fphase);
 
-    for (int i = 0; i < 32; i++) noiseBuffer[i] = GetRandomFloat(2.0f) - 1.0f;      // WATCH OUT: GetRandomFloat()
+    for (int i = 0; i < 32; i++) state->noiseBuffer[i] = GetNoiseSample(&state->rng);
 
-    repeatLimit = (int)(pow(1.0f - params->repeatSpeedValue, 2.0f)*20000 + 32);
+    state->repeatLimit = (int)(pow(1.0f - params->repeatSpeedValue, 2.0f)*20000 + 32);
 
-    if (params->repeatSpeedValue == 0.0f) repeatLimit = 0;
+    if (params->repeatSpeedValue == 0.0f) state->repeatLimit = 0;
     //----------------------------------------------------------------------------------------
 
-    // NOTE: We reserve enough space for up to 10 seconds of wave audio at given sample rate
-    // By default we use float size samples, they are converted to desired sample size at the end
-    float *buffer = calloc(MAX_WAVE_LENGTH_SECONDS*WAVE_SAMPLE_RATE, sizeof(float));
-    bool generatingSample = true;
-    int sampleCount = 0;
+    state->stopsAtMinFrequency = (params->minFrequencyValue > 0.0f);
+    state->generatingSample = true;
+    state->checksum = WAVE_CHECKSUM_INIT;
+    state->overview = overview;
+    state->binMin = 1.0f;
+    state->binMax = -1.0f;
+}
 
-    for (int i = 0; i < MAX_WAVE_LENGTH_SECONDS*WAVE_SAMPLE_RATE; i++)
+// Generate up to count samples into buffer, returns the number generated
+// NOTE: Returns less than count once the wave has ended. Inlined into a kernel
+// for every instruction set, see WAVE_KERNELS_X86.
+WAVE_INLINE int RenderWaveBlockKernel(WaveState *state, float *buffer, int count)
+{
+    // The state is kept in locals while generating so that it can live in registers
+    WaveParams *params = state->params;
+    int phase = state->phase;
+    double fperiod = state->fperiod;
+    const double fmaxperiod = state->fmaxperiod;
+    double fslide = state->fslide;
+    const double fdslide = state->fdslide;
+    int period = state->period;
+    float squareDuty = state->squareDuty;
+    const float squareSlide = state->squareSlide;
+    int envelopeStage = state->envelopeStage;
+    int envelopeTime = state->envelopeTime;
+    float envelopeVolume = state->envelopeVolume;
+    float fphase = state->fphase;
+    const float fdphase = state->fdphase;
+    int iphase = state->iphase;
+    int ipp = state->ipp;
+    float fltp = state->fltp;
+    float fltdp = state->fltdp;
+    float fltw = state->fltw;
+    const float fltwd = state->fltwd;
+    const float fltdmp = state->fltdmp;
+    float fltphp = state->fltphp;
+    float flthp = state->flthp;
+    const float flthpd = state->flthpd;
+    float vibratoPhase = state->vibratoPhase;
+    const float vibratoSpeed = state->vibratoSpeed;
+    const float vibratoAmplitude = state->vibratoAmplitude;
+    int repeatTime = state->repeatTime;
+    int repeatLimit = state->repeatLimit;
+    int arpeggioTime = state->arpeggioTime;
+    int arpeggioLimit = state->arpeggioLimit;
+    const double arpeggioModulation = state->arpeggioModulation;
+    const WaveRestart *restart = &state->restart;
+    const bool lpfEnabled = state->lpfEnabled;
+    const bool stopsAtMinFrequency = state->stopsAtMinFrequency;
+    bool generatingSample = state->generatingSample;
+    float peak = state->peak;
+    unsigned int clipCount = state->clipCount;
+    double sum = state->sum;
+    double sumSquares = state->sumSquares;
+    unsigned long long checksum = state->checksum;
+    float binMin = state->binMin;
+    float binMax = state->binMax;
+    int binFill = state->binFill;
+    int binIndex = state->binIndex;
+    const int *envelopeLength = state->envelopeLength;
+    float *phaserBuffer = state->phaserBuffer;
+    float *noiseBuffer = state->noiseBuffer;
+    WaveOverview *overview = state->overview;
+#if defined(RFXGEN_PROFILE)
+    uint64_t profileTime = 0;
+#endif
+    int i;
+
+    PROFILE_START();
+
+    for (i = 0; i < count; i++)
     {
-        if (!generatingSample)
-        {
-            sampleCount = i;
-            break;
-        }
+        if (!generatingSample) break;
 
         // Generate sample using selected parameters
         //------------------------------------------------------------------------------------
@@ -271,22 +585,14 @@ Wave GenerateWave(WaveParams *params)
         {
             // Reset sample parameters (only some of them)
             repeatTime = 0;
+            PROFILE_COUNT(repeatResets);
 
-            fperiod = 100.0/(params->startFrequencyValue*params->startFrequencyValue + 0.001);
-            period = (int)fperiod;
-            fmaxperiod = 100.0/(params->minFrequencyValue*params->minFrequencyValue + 0.001);
-            fslide = 1.0 - pow((double)params->slideValue, 3.0)*0.01;
-            fdslide = -pow((double)params->deltaSlideValue, 3.0)*0.000001;
-            squareDuty = 0.5f - params->squareDutyValue*0.5f;
-            squareSlide = -params->dutySweepValue*0.00005f;
-
-            if (params->changeAmountValue >= 0.0f) arpeggioModulation = 1.0 - pow((double)params->changeAmountValue, 2.0)*0.9;
-            else arpeggioModulation = 1.0 + pow((double)params->changeAmountValue, 2.0)*10.0;
-
+            fperiod = restart->fperiod;
+            period = restart->period;
+            fslide = restart->fslide;
+            squareDuty = restart->squareDuty;
             arpeggioTime = 0;
-            arpeggioLimit = (int)(pow(1.0f - params->changeSpeedValue, 2.0f)*20000 + 32);
-
-            if (params->changeSpeedValue == 1.0f) arpeggioLimit = 0;     // WATCH OUT: float comparison
+            arpeggioLimit = restart->arpeggioLimit;
         }
 
         // Frequency envelopes/arpeggios
@@ -296,6 +602,7 @@ Wave GenerateWave(WaveParams *params)
         {
             arpeggioLimit = 0;
             fperiod *= arpeggioModulation;
+            PROFILE_COUNT(arpeggioFires);
         }
 
         fslide += fdslide;
@@ -304,8 +611,9 @@ Wave GenerateWave(WaveParams *params)
         if (fperiod > fmaxperiod)
         {
             fperiod = fmaxperiod;
+            PROFILE_COUNT(clampHits);
 
-            if (params->minFrequencyValue > 0.0f) generatingSample = false;
+            if (stopsAtMinFrequency) generatingSample = false;
         }
 
         float rfperiod = fperiod;
@@ -318,12 +626,12 @@ Wave GenerateWave(WaveParams *params)
 
         period = (int)rfperiod;
 
-        if (period < 8) period=8;
+        if (period < 8) { period=8; PROFILE_COUNT(clampHits); }
 
         squareDuty += squareSlide;
 
-        if (squareDuty < 0.0f) squareDuty = 0.0f;
-        if (squareDuty > 0.5f) squareDuty = 0.5f;
+        if (squareDuty < 0.0f) { squareDuty = 0.0f; PROFILE_COUNT(clampHits); }
+        if (squareDuty > 0.5f) { squareDuty = 0.5f; PROFILE_COUNT(clampHits); }
 
         // Volume envelope
         envelopeTime++;
@@ -336,28 +644,34 @@ Wave GenerateWave(WaveParams *params)
             if (envelopeStage == 3) generatingSample = false;
         }
 
-        if (envelopeStage == 0) envelopeVolume = (float)envelopeTime/envelopeLength[0];
-        if (envelopeStage == 1) envelopeVolume = 1.0f + pow(1.0f - (float)envelopeTime/envelopeLength[1], 1.0f)*2.0f*params->sustainPunchValue;
-        if (envelopeStage == 2) envelopeVolume = 1.0f - (float)envelopeTime/envelopeLength[2];
+        // A stage shorter than one sample lasts a single sample at its start volume, rather than 0/0
+        float envelopePosition = (envelopeStage < 3 && envelopeLength[envelopeStage] > 0) ? (float)envelopeTime/envelopeLength[envelopeStage] : 0.0f;
+
+        if (envelopeStage == 0) envelopeVolume = envelopePosition;
+        if (envelopeStage == 1) envelopeVolume = 1.0f + pow(1.0f - envelopePosition, 1.0f)*2.0f*params->sustainPunchValue;
+        if (envelopeStage == 2) envelopeVolume = 1.0f - envelopePosition;
 
         // Phaser step
         fphase += fdphase;
         iphase = abs((int)fphase);
 
-        if (iphase > 1023) iphase = 1023;
+        if (iphase > 1023) { iphase = 1023; PROFILE_COUNT(clampHits); }
 
         if (flthpd != 0.0f)     // WATCH OUT!
         {
             flthp *= flthpd;
-            if (flthp < 0.00001f) flthp = 0.00001f;
-            if (flthp > 0.1f) flthp = 0.1f;
+            if (flthp < 0.00001f) { flthp = 0.00001f; PROFILE_COUNT(clampHits); }
+            if (flthp > 0.1f) { flthp = 0.1f; PROFILE_COUNT(clampHits); }
         }
 
-        float ssample = 0.0f;
+        PROFILE_STAGE(WAVE_STAGE_PARAMS);
 
         #define MAX_SUPERSAMPLING   8
 
-        // Supersampling x8
+        // Supersampling x8, each stage runs over all supersamples before the next one
+        float supersample[MAX_SUPERSAMPLING];
+
+        // Base waveform
         for (int si = 0; si < MAX_SUPERSAMPLING; si++)
         {
             float sample = 0.0f;
@@ -367,14 +681,15 @@ Wave GenerateWave(WaveParams *params)
             {
                 //phase = 0;
                 phase %= period;
+                PROFILE_COUNT(periodWraps);
 
                 if (params->waveTypeValue == 3)
                 {
-                    for (int i = 0;i < 32; i++) noiseBuffer[i] = GetRandomFloat(2.0f) - 1.0f;   // WATCH OUT: GetRandomFloat()
+                    for (int i = 0;i < 32; i++) noiseBuffer[i] = GetNoiseSample(&state->rng);
+                    PROFILE_COUNT(noiseRefills);
                 }
             }
 
-            // base waveform
             float fp = (float)phase/period;
 
             switch (params->waveTypeValue)
@@ -391,21 +706,28 @@ Wave GenerateWave(WaveParams *params)
                 default: break;
             }
 
+            supersample[si] = sample;
+        }
+
+        PROFILE_STAGE(WAVE_STAGE_OSCILLATOR);
+
+        for (int si = 0; si < MAX_SUPERSAMPLING; si++)
+        {
             // LP filter
             float pp = fltp;
             fltw *= fltwd;
 
-            if (fltw < 0.0f) fltw = 0.0f;
-            if (fltw > 0.1f) fltw = 0.1f;
+            if (fltw < 0.0f) { fltw = 0.0f; PROFILE_COUNT(clampHits); }
+            if (fltw > 0.1f) { fltw = 0.1f; PROFILE_COUNT(clampHits); }
 
-            if (params->lpfCutoffValue != 1.0f)  // WATCH OUT!
+            if (lpfEnabled)
             {
-                fltdp += (sample-fltp)*fltw;
+                fltdp += (supersample[si]-fltp)*fltw;
                 fltdp -= fltdp*fltdmp;
             }
             else
             {
-                fltp = sample;
+                fltp = supersample[si];
                 fltdp = 0.0f;
             }
 
@@ -414,89 +736,2195 @@ Wave GenerateWave(WaveParams *params)
             // HP filter
             fltphp += fltp - pp;
             fltphp -= fltphp*flthp;
-            sample = fltphp;
+            supersample[si] = fltphp;
+        }
 
-            // Phaser
-            phaserBuffer[ipp & 1023] = sample;
-            sample += phaserBuffer[(ipp - iphase + 1024) & 1023];
-            ipp = (ipp + 1) & 1023;
+        PROFILE_STAGE(WAVE_STAGE_FILTER);
 
-            // Final accumulation and envelope application
-            ssample += sample*envelopeVolume;
+        // Phaser
+        for (int si = 0; si < MAX_SUPERSAMPLING; si++)
+        {
+            phaserBuffer[ipp & 1023] = supersample[si];
+            supersample[si] += phaserBuffer[(ipp - iphase + 1024) & 1023];
+            ipp = (ipp + 1) & 1023;
         }
 
+        PROFILE_STAGE(WAVE_STAGE_PHASER);
+
+        // Final accumulation and envelope application
+        float ssample = 0.0f;
+
+        for (int si = 0; si < MAX_SUPERSAMPLING; si++) ssample += supersample[si]*envelopeVolume;
+
         #define SAMPLE_SCALE_COEFICIENT 0.2f    // NOTE: Used to scale sample value to [-1..1]
 
         ssample = (ssample/MAX_SUPERSAMPLING)*SAMPLE_SCALE_COEFICIENT;
+
+        PROFILE_STAGE(WAVE_STAGE_SUPERSAMPLE);
         //------------------------------------------------------------------------------------
 
+#if defined(FLUSH_DENORMALS_SOFTWARE)
+        // Values this small are inaudible and only remain above zero through slow subnormal arithmetic
+        #define DENORMAL_THRESHOLD 1e-20f
+
+        if (fabsf(fltp) < DENORMAL_THRESHOLD) fltp = 0.0f;
+        if (fabsf(fltdp) < DENORMAL_THRESHOLD) fltdp = 0.0f;
+        if (fabsf(fltphp) < DENORMAL_THRESHOLD) fltphp = 0.0f;
+#endif
+
         // Accumulate samples in the buffer
-        if (ssample > 1.0f) ssample = 1.0f;
-        if (ssample < -1.0f) ssample = -1.0f;
+        if (ssample > 1.0f) { ssample = 1.0f; clipCount++; PROFILE_COUNT(clampHits); }
+        if (ssample < -1.0f) { ssample = -1.0f; clipCount++; PROFILE_COUNT(clampHits); }
 
         buffer[i] = ssample;
+
+        // Accumulate output statistics
+        if (fabsf(ssample) > peak) peak = fabsf(ssample);
+        sum += ssample;
+        sumSquares += (double)ssample*ssample;
+        checksum = UpdateWaveChecksum(checksum, ssample);
+
+        if (overview != NULL)
+        {
+            if (ssample < binMin) binMin = ssample;
+            if (ssample > binMax) binMax = ssample;
+
+            if (++binFill == WAVE_OVERVIEW_BIN_SIZE)
+            {
+                overview->bins[binIndex][0] = binMin;
+                overview->bins[binIndex][1] = binMax;
+                binIndex++;
+                binFill = 0;
+                binMin = 1.0f;
+                binMax = -1.0f;
+            }
+        }
+
+        PROFILE_STAGE(WAVE_STAGE_OUTPUT);
     }
 
-    Wave genWave;
-    genWave.sampleCount = sampleCount;
-    genWave.sampleRate = WAVE_SAMPLE_RATE; // By default 44100 Hz
-    genWave.sampleSize = 32;               // By default 32 bit float samples
-    genWave.channels = 1;                  // By default 1 channel (mono)
+    state->phase = phase;
+    state->fperiod = fperiod;
+    state->fslide = fslide;
+    state->period = period;
+    state->squareDuty = squareDuty;
+    state->envelopeStage = envelopeStage;
+    state->envelopeTime = envelopeTime;
+    state->envelopeVolume = envelopeVolume;
+    state->fphase = fphase;
+    state->iphase = iphase;
+    state->ipp = ipp;
+    state->fltp = fltp;
+    state->fltdp = fltdp;
+    state->fltw = fltw;
+    state->fltphp = fltphp;
+    state->flthp = flthp;
+    state->vibratoPhase = vibratoPhase;
+    state->repeatTime = repeatTime;
+    state->repeatLimit = repeatLimit;
+    state->arpeggioTime = arpeggioTime;
+    state->arpeggioLimit = arpeggioLimit;
+    state->generatingSample = generatingSample;
+    state->peak = peak;
+    state->clipCount = clipCount;
+    state->sum = sum;
+    state->sumSquares = sumSquares;
+    state->checksum = checksum;
+    state->binMin = binMin;
+    state->binMax = binMax;
+    state->binFill = binFill;
+    state->binIndex = binIndex;
+    state->sampleCount += i;
+
+    return i;
+}
 
-    genWave.data = calloc(genWave.sampleCount*genWave.channels, genWave.sampleSize/8);
-    memcpy(genWave.data, buffer, genWave.sampleCount*genWave.channels*genWave.sampleSize/8);
+// Convert samples to integers, with gain applied and clamped to [-1..1] before scaling
+// NOTE: Rounds to nearest even like lrintf() in the default rounding mode, and maps NaN
+// to -1 like the max(x, -1) of the vector kernels, where lrintf(NaN) would be unspecified
+WAVE_INLINE void QuantizeSamplesKernel(int32_t *dst, const float *src, unsigned int count, float gain, float scale)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float x = src[i]*gain;
 
-    free(buffer);
+		if (!(x >= -1.0f)) x = -1.0f;
+		else if (x > 1.0f) x = 1.0f;
 
-    return genWave;
+		dst[i] = (int32_t)lrintf(x*scale);
+	}
 }
 
-// Load .rfx (rFXGen) sound parameters file
-WaveParams *LoadWaveParams(const char *fileName)
+static int RenderWaveBlockGeneric(WaveState *state, float *buffer, int count)
 {
-    WaveParams *params = malloc(sizeof(WaveParams));
-	FILE *rfxFile;
-	char signature[4];
-	unsigned short version, length;
+	return RenderWaveBlockKernel(state, buffer, count);
+}
 
-	if(params == NULL)
-		goto out;
+static void QuantizeSamplesGeneric(int32_t *dst, const float *src, unsigned int count, float gain, float scale)
+{
+	QuantizeSamplesKernel(dst, src, count, gain, scale);
+}
 
-	rfxFile = fopen(fileName, "rb");
-	if (rfxFile == NULL)
-		goto out;
+// Lane generators render WAVE_LANES independent waves side by side, one per SIMD lane. Each
+// step of the generator is a recurrence over the samples of a wave, but the same step of
+// different waves is independent, so the state of the waves is laid out as one array per
+// field and every step runs on all lanes at once. Lanes differ in wave type, length and
+// enabled features, so steps are computed for every lane and merged with lane masks, and
+// rare events (period wraps, envelope stages, repeats) are handled lane by lane. The
+// operations are those of RenderWaveBlockKernel() in the same order and precision, so every
+// lane is bit for bit identical to rendering its wave alone.
+// NOTE: Needs the vector extensions of GCC or Clang, other compilers render lanes one by one
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__has_builtin)
+    #if __has_builtin(__builtin_convertvector) && __has_builtin(__builtin_shufflevector) && (WAVE_LANES == 8)
+        #define WAVE_LANES_VECTOR
+    #endif
+#endif
+
+#if defined(WAVE_LANES_VECTOR)
+typedef float LaneFloat __attribute__((vector_size(WAVE_LANES*sizeof(float))));
+typedef int32_t LaneInt __attribute__((vector_size(WAVE_LANES*sizeof(int32_t))));
+typedef double LaneDouble __attribute__((vector_size(WAVE_LANES*sizeof(double))));
+typedef int64_t LaneLong __attribute__((vector_size(WAVE_LANES*sizeof(int64_t))));
+
+// Every lane set to x, and lanes of a or b by a mask of -1 (a) or 0 (b) in each lane
+#define LANE_SPLAT(type, x)             ((type){ 0 } + (x))
+#define LANE_SELECT(type, mask, a, b)   ((type)(((mask) & (LaneInt)(a)) | (~(mask) & (LaneInt)(b))))
+#define LANE_SELECT_WIDE(type, mask, a, b) ((type)(((mask) & (LaneLong)(a)) | (~(mask) & (LaneLong)(b))))
+#define LANE_WIDEN(mask)                __builtin_convertvector(mask, LaneLong)
+
+// Lane mask of a comparison. GCC compares vectors wider than the registers of the target an
+// element at a time, so kernels with narrower registers compare each half of the lanes instead
+// NOTE: Needs the registerSize of the kernel in scope, a constant once the kernel is inlined
+typedef int32_t LaneHalfInt __attribute__((vector_size(WAVE_LANES/2*sizeof(int32_t))));
+typedef int64_t LaneHalfLong __attribute__((vector_size(WAVE_LANES/2*sizeof(int64_t))));
+
+#define LANE_LOW(v)                     __builtin_shufflevector(v, v, 0, 1, 2, 3)
+#define LANE_HIGH(v)                    __builtin_shufflevector(v, v, 4, 5, 6, 7)
+#define LANE_JOIN(low, high)            __builtin_shufflevector(low, high, 0, 1, 2, 3, 4, 5, 6, 7)
+#define LANE_COMPARE(a, op, b)          ((registerSize < (int)sizeof(LaneFloat)) ? \
+    (LaneInt)LANE_JOIN((LaneHalfInt)(LANE_LOW(a) op LANE_LOW(b)), (LaneHalfInt)(LANE_HIGH(a) op LANE_HIGH(b))) : \
+    (LaneInt)((a) op (b)))
+#define LANE_COMPARE_WIDE(a, op, b)     ((registerSize < (int)sizeof(LaneDouble)) ? \
+    (LaneLong)LANE_JOIN((LaneHalfLong)(LANE_LOW(a) op LANE_LOW(b)), (LaneHalfLong)(LANE_HIGH(a) op LANE_HIGH(b))) : \
+    (LaneLong)((a) op (b)))
+
+// State of the waves of a lane generator, one element per lane in every array
+// NOTE: Vectors are only used as locals, the state is copied in and out with memcpy() as
+// allocators only guarantee the alignment of scalars
+struct WaveLanes {
+    WaveRandom rng[WAVE_LANES];
+    WaveRestart restart[WAVE_LANES];    // Values each wave restarts from, as derived by InitWaveState()
+
+    double fperiod[WAVE_LANES];
+    double fmaxperiod[WAVE_LANES];
+    double fslide[WAVE_LANES];
+    double fdslide[WAVE_LANES];
+    double arpeggioModulation[WAVE_LANES];
+    double sum[WAVE_LANES];
+    double sumSquares[WAVE_LANES];
+    uint64_t checksum[WAVE_LANES];
+
+    int32_t phase[WAVE_LANES];
+    int32_t period[WAVE_LANES];
+    int32_t envelopeStage[WAVE_LANES];
+    int32_t envelopeTime[WAVE_LANES];
+    int32_t stageLength[WAVE_LANES];    // Length of the current envelope stage, 0 once ended
+    int32_t iphase[WAVE_LANES];
+    int32_t repeatTime[WAVE_LANES];
+    int32_t repeatLimit[WAVE_LANES];
+    int32_t arpeggioTime[WAVE_LANES];
+    int32_t arpeggioLimit[WAVE_LANES];
+    int32_t generating[WAVE_LANES];     // -1 while the wave plays, 0 once it ended or if empty
+    int32_t sampleCount[WAVE_LANES];
+    int32_t clipCount[WAVE_LANES];
+
+    // Fixed when a wave starts: the wave type, then masks of -1 or 0
+    int32_t waveType[WAVE_LANES];
+    int32_t lpfEnabled[WAVE_LANES];
+    int32_t stopsAtMinFrequency[WAVE_LANES];
+    int32_t hasVibrato[WAVE_LANES];
+
+    float squareDuty[WAVE_LANES];
+    float squareSlide[WAVE_LANES];
+    float envelopeVolume[WAVE_LANES];
+    float sustainPunch[WAVE_LANES];
+    float fphase[WAVE_LANES];
+    float fdphase[WAVE_LANES];
+    float fltp[WAVE_LANES];
+    float fltdp[WAVE_LANES];
+    float fltw[WAVE_LANES];
+    float fltwd[WAVE_LANES];
+    float fltdmp[WAVE_LANES];
+    float fltphp[WAVE_LANES];
+    float flthp[WAVE_LANES];
+    float flthpd[WAVE_LANES];
+    float vibratoPhase[WAVE_LANES];
+    float vibratoSpeed[WAVE_LANES];
+    float vibratoAmplitude[WAVE_LANES];
+    float peak[WAVE_LANES];
+
+    // Lanes of sine and noise waves and vibrato, which need calls or lookups per lane
+    unsigned int sineLanes;
+    unsigned int noiseLanes;
+    unsigned int vibratoLanes;
+
+    int32_t envelopeLength[3][WAVE_LANES];
+    float noiseBuffer[32][WAVE_LANES];
+    // NOTE: All lanes share the write position. Only the distance between writes and reads of
+    // a wave matters, so a wave starting in a lane clears its column instead of resetting ipp.
+    float phaserBuffer[1024][WAVE_LANES];
+    int ipp;
+};
 
-	// Fx Sound File Structure (.rfx)
-	// ------------------------------------------------------
-	// Offset | Size  | Type       | Description
-	// ------------------------------------------------------
-	// 0      | 4     | char       | Signature: "rFX "
-	// 4      | 2     | short      | Version: 200
-	// 6      | 2     | short      | Data length: 96 bytes
-	// 8      | 96    | WaveParams | Wave parameters
-	// ------------------------------------------------------
+// Returns a bit for every lane whose mask is set
+WAVE_INLINE unsigned int GetLaneBits(const LaneInt *mask)
+{
+    unsigned int bits = 0;
 
-	// Read .rfx file header
-	fread(signature, 4, sizeof(char), rfxFile);
-	if(strncmp(signature, "rFX ", 4) != 0)
-	{
-		printf("[%s] rFX file does not seem to be valid\n", fileName);
-		fclose(rfxFile);
-		goto out;
-	}
+    for (int l = 0; l < WAVE_LANES; l++) bits |= (unsigned int)((*mask)[l] & 1) << l;
 
-	fread(&version, 1, sizeof(unsigned short), rfxFile);
-	fread(&length, 1, sizeof(unsigned short), rfxFile);
+    return bits;
+}
 
-	if (version != 200)
-		printf("[%s] rFX file version not supported (%i)\n", fileName, version);
-	else if (length != sizeof(WaveParams))
-		printf("[%s] Wrong rFX wave parameters size\n", fileName);
-	else
-		fread(params, 1, sizeof(WaveParams), rfxFile);   // Load wave generation parameters
+// Check if any lane or every lane of a mask is set, without a branch per lane
+WAVE_INLINE bool IsAnyLaneSet(const LaneInt *mask)
+{
+    uint64_t words[WAVE_LANES/2];
+    uint64_t any = 0;
 
-	fclose(rfxFile);
+    memcpy(words, mask, sizeof(words));
 
-out:
-	return params;
+    for (int w = 0; w < WAVE_LANES/2; w++) any |= words[w];
+
+    return (any != 0);
+}
+
+WAVE_INLINE bool AreAllLanesSet(const LaneInt *mask)
+{
+    uint64_t words[WAVE_LANES/2];
+    uint64_t all = ~0ULL;
+
+    memcpy(words, mask, sizeof(words));
+
+    for (int w = 0; w < WAVE_LANES/2; w++) all &= words[w];
+
+    return (all == ~0ULL);
+}
+
+// Generate up to count samples of every lane into buffers, stores the number generated in rendered
+// NOTE: Inlined into a kernel for every instruction set, as RenderWaveBlockKernel()
+WAVE_INLINE void RenderWaveLanesKernel(WaveLanes *lanes, float *const *buffers, int count, unsigned int *rendered, int registerSize)
+{
+    #define LANE_LOAD(type, field)  type field; memcpy(&field, lanes->field, sizeof(field))
+    #define LANE_STORE(field)       memcpy(lanes->field, &field, sizeof(field))
+
+    LANE_LOAD(LaneDouble, fperiod);
+    LANE_LOAD(LaneDouble, fmaxperiod);
+    LANE_LOAD(LaneDouble, fslide);
+    LANE_LOAD(LaneDouble, fdslide);
+    LANE_LOAD(LaneDouble, arpeggioModulation);
+    LANE_LOAD(LaneDouble, sum);
+    LANE_LOAD(LaneDouble, sumSquares);
+    LANE_LOAD(LaneInt, phase);
+    LANE_LOAD(LaneInt, period);
+    LANE_LOAD(LaneInt, envelopeStage);
+    LANE_LOAD(LaneInt, envelopeTime);
+    LANE_LOAD(LaneInt, stageLength);
+    LANE_LOAD(LaneInt, iphase);
+    LANE_LOAD(LaneInt, repeatTime);
+    LANE_LOAD(LaneInt, repeatLimit);
+    LANE_LOAD(LaneInt, arpeggioTime);
+    LANE_LOAD(LaneInt, arpeggioLimit);
+    LANE_LOAD(LaneInt, generating);
+    LANE_LOAD(LaneInt, sampleCount);
+    LANE_LOAD(LaneInt, clipCount);
+    LANE_LOAD(LaneInt, waveType);
+    LANE_LOAD(LaneInt, lpfEnabled);
+    LANE_LOAD(LaneInt, stopsAtMinFrequency);
+    LANE_LOAD(LaneInt, hasVibrato);
+    LANE_LOAD(LaneFloat, squareDuty);
+    LANE_LOAD(LaneFloat, squareSlide);
+    LANE_LOAD(LaneFloat, envelopeVolume);
+    LANE_LOAD(LaneFloat, sustainPunch);
+    LANE_LOAD(LaneFloat, fphase);
+    LANE_LOAD(LaneFloat, fdphase);
+    LANE_LOAD(LaneFloat, fltp);
+    LANE_LOAD(LaneFloat, fltdp);
+    LANE_LOAD(LaneFloat, fltw);
+    LANE_LOAD(LaneFloat, fltwd);
+    LANE_LOAD(LaneFloat, fltdmp);
+    LANE_LOAD(LaneFloat, fltphp);
+    LANE_LOAD(LaneFloat, flthp);
+    LANE_LOAD(LaneFloat, flthpd);
+    LANE_LOAD(LaneFloat, vibratoPhase);
+    LANE_LOAD(LaneFloat, vibratoSpeed);
+    LANE_LOAD(LaneFloat, vibratoAmplitude);
+    LANE_LOAD(LaneFloat, peak);
+
+    const LaneInt startCount = sampleCount;
+    const LaneInt maxCount = LANE_SPLAT(LaneInt, MAX_WAVE_LENGTH_SECONDS*WAVE_SAMPLE_RATE);
+    const LaneInt isSquare = LANE_COMPARE(waveType, ==, LANE_SPLAT(LaneInt, 0));
+    const LaneInt isSawtooth = LANE_COMPARE(waveType, ==, LANE_SPLAT(LaneInt, 1));
+    const LaneInt hasHpfSweep = LANE_COMPARE(flthpd, !=, LANE_SPLAT(LaneFloat, 0.0f));
+    int ipp = lanes->ipp;
+
+    for (int i = 0; i < count; i++)
+    {
+        // Lanes generating this sample, a lane that stops never generates again
+        LaneInt active = generating & LANE_COMPARE(sampleCount, <, maxCount);
+        unsigned int activeBits = GetLaneBits(&active);
+
+        if (activeBits == 0) break;
+
+        // Counters only advance in active lanes, subtracting the mask of -1
+        repeatTime -= active;
+
+        LaneInt repeat = active & LANE_COMPARE(repeatLimit, !=, LANE_SPLAT(LaneInt, 0)) & LANE_COMPARE(repeatTime, >=, repeatLimit);
+
+        if (IsAnyLaneSet(&repeat))
+        {
+            for (int l = 0; l < WAVE_LANES; l++)
+            {
+                const WaveRestart *restart = &lanes->restart[l];
+
+                if (!repeat[l]) continue;
+
+                // Reset sample parameters (only some of them)
+                repeatTime[l] = 0;
+
+                fperiod[l] = restart->fperiod;
+                period[l] = restart->period;
+                fslide[l] = restart->fslide;
+                squareDuty[l] = restart->squareDuty;
+                arpeggioTime[l] = 0;
+                arpeggioLimit[l] = restart->arpeggioLimit;
+            }
+        }
+
+        // Frequency envelopes/arpeggios
+        arpeggioTime -= active;
+
+        LaneInt arpeggio = LANE_COMPARE(arpeggioLimit, !=, LANE_SPLAT(LaneInt, 0)) & LANE_COMPARE(arpeggioTime, >=, arpeggioLimit);
+
+        arpeggioLimit &= ~arpeggio;
+        fperiod = LANE_SELECT_WIDE(LaneDouble, LANE_WIDEN(arpeggio), fperiod*arpeggioModulation, fperiod);
+
+        fslide += fdslide;
+        fperiod *= fslide;
+
+        LaneLong overMax = LANE_COMPARE_WIDE(fperiod, >, fmaxperiod);
+
+        fperiod = LANE_SELECT_WIDE(LaneDouble, overMax, fmaxperiod, fperiod);
+        generating &= ~(__builtin_convertvector(overMax, LaneInt) & stopsAtMinFrequency);
+
+        LaneFloat rfperiod = __builtin_convertvector(fperiod, LaneFloat);
+
+        if ((lanes->vibratoLanes & activeBits) != 0)
+        {
+            LaneFloat vibrato = LANE_SPLAT(LaneFloat, 0.0f);
+
+            vibratoPhase += vibratoSpeed;
+
+            for (int l = 0; l < WAVE_LANES; l++)
+            {
+                if (lanes->vibratoLanes & activeBits & (1u << l)) vibrato[l] = sinf(vibratoPhase[l]);
+            }
+
+            LaneDouble scale = LANE_SPLAT(LaneDouble, 1.0) + __builtin_convertvector(vibrato*vibratoAmplitude, LaneDouble);
+
+            rfperiod = LANE_SELECT(LaneFloat, hasVibrato, __builtin_convertvector(fperiod*scale, LaneFloat), rfperiod);
+        }
+
+        period = __builtin_convertvector(rfperiod, LaneInt);
+        period = LANE_SELECT(LaneInt, LANE_COMPARE(period, <, LANE_SPLAT(LaneInt, 8)), LANE_SPLAT(LaneInt, 8), period);
+
+        squareDuty += squareSlide;
+        squareDuty = LANE_SELECT(LaneFloat, LANE_COMPARE(squareDuty, <, LANE_SPLAT(LaneFloat, 0.0f)), LANE_SPLAT(LaneFloat, 0.0f), squareDuty);
+        squareDuty = LANE_SELECT(LaneFloat, LANE_COMPARE(squareDuty, >, LANE_SPLAT(LaneFloat, 0.5f)), LANE_SPLAT(LaneFloat, 0.5f), squareDuty);
+
+        // Volume envelope
+        envelopeTime -= active;
+
+        LaneInt nextStage = active & LANE_COMPARE(envelopeTime, >, stageLength);
+
+        if (IsAnyLaneSet(&nextStage))
+        {
+            for (int l = 0; l < WAVE_LANES; l++)
+            {
+                if (!nextStage[l]) continue;
+
+                envelopeTime[l] = 0;
+                envelopeStage[l]++;
+
+                if (envelopeStage[l] == 3) { stageLength[l] = 0; generating[l] = 0; }
+                else stageLength[l] = lanes->envelopeLength[envelopeStage[l]][l];
+            }
+        }
+
+        // A stage shorter than one sample lasts a single sample at its start volume, rather than 0/0
+        LaneFloat envelopePosition = LANE_SELECT(LaneFloat, LANE_COMPARE(stageLength, >, LANE_SPLAT(LaneInt, 0)),
+            __builtin_convertvector(envelopeTime, LaneFloat)/__builtin_convertvector(stageLength, LaneFloat), LANE_SPLAT(LaneFloat, 0.0f));
+        LaneDouble punch = LANE_SPLAT(LaneDouble, 1.0) + __builtin_convertvector(LANE_SPLAT(LaneFloat, 1.0f) - envelopePosition, LaneDouble)*2.0*
+            __builtin_convertvector(sustainPunch, LaneDouble);
+
+        envelopeVolume = LANE_SELECT(LaneFloat, LANE_COMPARE(envelopeStage, ==, LANE_SPLAT(LaneInt, 0)), envelopePosition, envelopeVolume);
+        envelopeVolume = LANE_SELECT(LaneFloat, LANE_COMPARE(envelopeStage, ==, LANE_SPLAT(LaneInt, 1)), __builtin_convertvector(punch, LaneFloat), envelopeVolume);
+        envelopeVolume = LANE_SELECT(LaneFloat, LANE_COMPARE(envelopeStage, ==, LANE_SPLAT(LaneInt, 2)), LANE_SPLAT(LaneFloat, 1.0f) - envelopePosition, envelopeVolume);
+
+        // Phaser step
+        fphase += fdphase;
+        iphase = __builtin_convertvector(fphase, LaneInt);
+        iphase = LANE_SELECT(LaneInt, LANE_COMPARE(iphase, <, LANE_SPLAT(LaneInt, 0)), -iphase, iphase);
+        iphase = LANE_SELECT(LaneInt, LANE_COMPARE(iphase, >, LANE_SPLAT(LaneInt, 1023)), LANE_SPLAT(LaneInt, 1023), iphase);
+
+        LaneFloat sweptHp = flthp*flthpd;
+
+        sweptHp = LANE_SELECT(LaneFloat, LANE_COMPARE(sweptHp, <, LANE_SPLAT(LaneFloat, 0.00001f)), LANE_SPLAT(LaneFloat, 0.00001f), sweptHp);
+        sweptHp = LANE_SELECT(LaneFloat, LANE_COMPARE(sweptHp, >, LANE_SPLAT(LaneFloat, 0.1f)), LANE_SPLAT(LaneFloat, 0.1f), sweptHp);
+        flthp = LANE_SELECT(LaneFloat, hasHpfSweep, sweptHp, flthp);
+
+        // Supersampling x8, each stage runs over all supersamples before the next one
+        LaneFloat supersample[MAX_SUPERSAMPLING];
+        LaneFloat position[MAX_SUPERSAMPLING];
+
+        // Base waveform
+        for (int si = 0; si < MAX_SUPERSAMPLING; si++)
+        {
+            phase -= active;
+
+            // Phase is below the period before it steps by one, so it usually wraps by a single
+            // period. Only when the period shrank below the phase is the remainder needed.
+            LaneInt wrap = active & LANE_COMPARE(phase, >=, period);
+
+            phase = LANE_SELECT(LaneInt, wrap, phase - period, phase);
+
+            LaneInt wrapAgain = wrap & LANE_COMPARE(phase, >=, period);
+
+            if (IsAnyLaneSet(&wrapAgain))
+            {
+                for (int l = 0; l < WAVE_LANES; l++)
+                {
+                    if (wrapAgain[l]) phase[l] %= period[l];
+                }
+            }
+
+            if (lanes->noiseLanes != 0)
+            {
+                unsigned int refill = GetLaneBits(&wrap) & lanes->noiseLanes;
+
+                for (int l = 0; refill != 0; l++, refill >>= 1)
+                {
+                    if (refill & 1)
+                    {
+                        for (int k = 0; k < 32; k++) lanes->noiseBuffer[k][l] = GetNoiseSample(&lanes->rng[l]);
+                    }
+                }
+            }
+
+            LaneFloat fp = __builtin_convertvector(phase, LaneFloat)/__builtin_convertvector(period, LaneFloat);
+            LaneFloat square = LANE_SELECT(LaneFloat, LANE_COMPARE(fp, <, squareDuty), LANE_SPLAT(LaneFloat, 0.5f), LANE_SPLAT(LaneFloat, -0.5f));
+
+            position[si] = fp;
+            supersample[si] = LANE_SELECT(LaneFloat, isSquare, square,
+                LANE_SELECT(LaneFloat, isSawtooth, LANE_SPLAT(LaneFloat, 1.0f) - fp*2.0f, LANE_SPLAT(LaneFloat, 0.0f)));
+
+            // Noise is read before the next wrap can refill it. The index is below 32, so the
+            // quotient in double precision truncates to the same integer as in int
+            if ((lanes->noiseLanes & activeBits) != 0)
+            {
+                LaneInt index = __builtin_convertvector(__builtin_convertvector(phase*32, LaneDouble)/__builtin_convertvector(period, LaneDouble), LaneInt);
+
+                for (int l = 0; l < WAVE_LANES; l++)
+                {
+                    if (lanes->noiseLanes & activeBits & (1u << l)) supersample[si][l] = lanes->noiseBuffer[index[l]][l];
+                }
+            }
+        }
+
+        if ((lanes->sineLanes & activeBits) != 0)
+        {
+            for (int si = 0; si < MAX_SUPERSAMPLING; si++)
+            {
+                for (int l = 0; l < WAVE_LANES; l++)
+                {
+                    if (lanes->sineLanes & activeBits & (1u << l)) supersample[si][l] = sinf(position[si][l]*2*PI);
+                }
+            }
+        }
+
+        for (int si = 0; si < MAX_SUPERSAMPLING; si++)
+        {
+            // LP filter
+            LaneFloat pp = fltp;
+
+            fltw *= fltwd;
+            fltw = LANE_SELECT(LaneFloat, LANE_COMPARE(fltw, <, LANE_SPLAT(LaneFloat, 0.0f)), LANE_SPLAT(LaneFloat, 0.0f), fltw);
+            fltw = LANE_SELECT(LaneFloat, LANE_COMPARE(fltw, >, LANE_SPLAT(LaneFloat, 0.1f)), LANE_SPLAT(LaneFloat, 0.1f), fltw);
+
+            LaneFloat filtered = fltdp + (supersample[si] - fltp)*fltw;
+
+            filtered -= filtered*fltdmp;
+            fltp = LANE_SELECT(LaneFloat, lpfEnabled, fltp, supersample[si]);
+            fltdp = LANE_SELECT(LaneFloat, lpfEnabled, filtered, LANE_SPLAT(LaneFloat, 0.0f));
+            fltp += fltdp;
+
+            // HP filter
+            fltphp += fltp - pp;
+            fltphp -= fltphp*flthp;
+            supersample[si] = fltphp;
+        }
+
+        // Phaser, lanes at the same offset read a single row
+        LaneInt sameOffset = LANE_COMPARE(iphase, ==, LANE_SPLAT(LaneInt, iphase[0]));
+
+        for (int si = 0; si < MAX_SUPERSAMPLING; si++)
+        {
+            LaneFloat delayed;
+
+            memcpy(lanes->phaserBuffer[ipp & 1023], &supersample[si], sizeof(LaneFloat));
+
+            if (AreAllLanesSet(&sameOffset)) memcpy(&delayed, lanes->phaserBuffer[(ipp - iphase[0] + 1024) & 1023], sizeof(delayed));
+            else
+            {
+                float gathered[WAVE_LANES];
+
+                for (int l = 0; l < WAVE_LANES; l++) gathered[l] = lanes->phaserBuffer[(ipp - iphase[l] + 1024) & 1023][l];
+
+                memcpy(&delayed, gathered, sizeof(delayed));
+            }
+
+            supersample[si] += delayed;
+            ipp = (ipp + 1) & 1023;
+        }
+
+        // Final accumulation and envelope application
+        LaneFloat ssample = LANE_SPLAT(LaneFloat, 0.0f);
+
+        for (int si = 0; si < MAX_SUPERSAMPLING; si++) ssample += supersample[si]*envelopeVolume;
+
+        ssample = (ssample/(float)MAX_SUPERSAMPLING)*SAMPLE_SCALE_COEFICIENT;
+
+#if defined(FLUSH_DENORMALS_SOFTWARE)
+        const LaneInt magnitudeBits = LANE_SPLAT(LaneInt, 0x7FFFFFFF);
+        const LaneFloat threshold = LANE_SPLAT(LaneFloat, DENORMAL_THRESHOLD);
+
+        fltp = LANE_SELECT(LaneFloat, LANE_COMPARE((LaneFloat)((LaneInt)fltp & magnitudeBits), <, threshold), LANE_SPLAT(LaneFloat, 0.0f), fltp);
+        fltdp = LANE_SELECT(LaneFloat, LANE_COMPARE((LaneFloat)((LaneInt)fltdp & magnitudeBits), <, threshold), LANE_SPLAT(LaneFloat, 0.0f), fltdp);
+        fltphp = LANE_SELECT(LaneFloat, LANE_COMPARE((LaneFloat)((LaneInt)fltphp & magnitudeBits), <, threshold), LANE_SPLAT(LaneFloat, 0.0f), fltphp);
+#endif
+
+        LaneInt clipHigh = LANE_COMPARE(ssample, >, LANE_SPLAT(LaneFloat, 1.0f));
+        LaneInt clipLow = LANE_COMPARE(ssample, <, LANE_SPLAT(LaneFloat, -1.0f));
+
+        ssample = LANE_SELECT(LaneFloat, clipHigh, LANE_SPLAT(LaneFloat, 1.0f), ssample);
+        ssample = LANE_SELECT(LaneFloat, clipLow, LANE_SPLAT(LaneFloat, -1.0f), ssample);
+        clipCount -= (clipHigh | clipLow) & active;
+
+        for (int l = 0; l < WAVE_LANES; l++)
+        {
+            if (activeBits & (1u << l)) buffers[l][i] = ssample[l];
+        }
+
+        // Accumulate output statistics of the active lanes
+        LaneLong activeWide = LANE_WIDEN(active);
+        LaneFloat magnitude = (LaneFloat)((LaneInt)ssample & LANE_SPLAT(LaneInt, 0x7FFFFFFF));
+        LaneDouble wide = __builtin_convertvector(ssample, LaneDouble);
+        peak = LANE_SELECT(LaneFloat, active & LANE_COMPARE(magnitude, >, peak), magnitude, peak);
+        sum = LANE_SELECT_WIDE(LaneDouble, activeWide, sum + wide, sum);
+        sumSquares = LANE_SELECT_WIDE(LaneDouble, activeWide, sumSquares + wide*wide, sumSquares);
+        sampleCount -= active;
+    }
+
+    LANE_STORE(fperiod);
+    LANE_STORE(fslide);
+    LANE_STORE(sum);
+    LANE_STORE(sumSquares);
+    LANE_STORE(phase);
+    LANE_STORE(period);
+    LANE_STORE(envelopeStage);
+    LANE_STORE(envelopeTime);
+    LANE_STORE(stageLength);
+    LANE_STORE(iphase);
+    LANE_STORE(repeatTime);
+    LANE_STORE(repeatLimit);
+    LANE_STORE(arpeggioTime);
+    LANE_STORE(arpeggioLimit);
+    LANE_STORE(generating);
+    LANE_STORE(sampleCount);
+    LANE_STORE(clipCount);
+    LANE_STORE(squareDuty);
+    LANE_STORE(envelopeVolume);
+    LANE_STORE(fphase);
+    LANE_STORE(fltp);
+    LANE_STORE(fltdp);
+    LANE_STORE(fltw);
+    LANE_STORE(fltphp);
+    LANE_STORE(flthp);
+    LANE_STORE(vibratoPhase);
+    LANE_STORE(peak);
+    lanes->ipp = ipp;
+
+    int longest = 0;
+
+    for (int l = 0; l < WAVE_LANES; l++)
+    {
+        rendered[l] = (unsigned int)(sampleCount[l] - startCount[l]);
+        if ((int)rendered[l] > longest) longest = (int)rendered[l];
+    }
+
+    // The checksum is a chain of 64 bit multiplies, which the vectors of most targets lack, so
+    // it runs over the output afterwards, with the chains of all lanes interleaved
+    for (int i = 0; i < longest; i++)
+    {
+        for (int l = 0; l < WAVE_LANES; l++)
+        {
+            if (i < (int)rendered[l]) lanes->checksum[l] = UpdateWaveChecksum(lanes->checksum[l], buffers[l][i]);
+        }
+    }
+
+    #undef LANE_LOAD
+    #undef LANE_STORE
+}
+
+static void RenderWaveLanesGeneric(WaveLanes *lanes, float *const *buffers, int count, unsigned int *rendered)
+{
+    RenderWaveLanesKernel(lanes, buffers, count, rendered, 16);
+}
+#else
+// Without vector extensions each lane is a generator state of its own, rendered in turn
+struct WaveLanes {
+    WaveParams params[WAVE_LANES];
+    WaveState state[WAVE_LANES];
+};
+
+static void RenderWaveLanesGeneric(WaveLanes *lanes, float *const *buffers, int count, unsigned int *rendered)
+{
+    for (int l = 0; l < WAVE_LANES; l++)
+    {
+        WaveState *state = &lanes->state[l];
+        int remaining = MAX_WAVE_LENGTH_SECONDS*WAVE_SAMPLE_RATE - state->sampleCount;
+
+        rendered[l] = 0;
+
+        if (state->generatingSample) rendered[l] = (unsigned int)RenderWaveBlockGeneric(state, buffers[l], (count < remaining) ? count : remaining);
+    }
+}
+#endif
+
+#if defined(WAVE_KERNELS_X86)
+// Conversion kernels for newer instruction sets, selected at runtime. Generation of a single
+// wave is a chain of recurrences with calls into libm on every sample, so there is nothing to
+// vectorize and compiling it for AVX2 and AVX-512 measured slower than the baseline build: all
+// kernels share the generic renderer. Lanes are vectorized across waves instead, so wider
+// vectors cover them in fewer instructions.
+#define QUANTIZE_SAMPLES_VECTOR(width, vtype, load, set1, mul, min, max, cvt, store)    \
+	unsigned int i = 0;                                                     \
+	vtype g = set1(gain), s = set1(scale), hi = set1(1.0f), lo = set1(-1.0f);  \
+	for (; i + width <= count; i += width)                                  \
+	{                                                                       \
+		vtype x = min(max(mul(load(src + i), g), lo), hi);              \
+		store(dst + i, cvt(mul(x, s)));                                 \
+	}                                                                       \
+	QuantizeSamplesKernel(dst + i, src + i, count - i, gain, scale)
+
+__attribute__((target("sse4.2")))
+static void QuantizeSamplesSse42(int32_t *dst, const float *src, unsigned int count, float gain, float scale)
+{
+	QUANTIZE_SAMPLES_VECTOR(4, __m128, _mm_loadu_ps, _mm_set1_ps, _mm_mul_ps, _mm_min_ps, _mm_max_ps,
+		_mm_cvtps_epi32, STORE_SSE);
+}
+
+__attribute__((target("avx2")))
+static void QuantizeSamplesAvx2(int32_t *dst, const float *src, unsigned int count, float gain, float scale)
+{
+	QUANTIZE_SAMPLES_VECTOR(8, __m256, _mm256_loadu_ps, _mm256_set1_ps, _mm256_mul_ps, _mm256_min_ps, _mm256_max_ps,
+		_mm256_cvtps_epi32, STORE_AVX);
+}
+
+__attribute__((target("avx512f")))
+static void QuantizeSamplesAvx512(int32_t *dst, const float *src, unsigned int count, float gain, float scale)
+{
+	QUANTIZE_SAMPLES_VECTOR(16, __m512, _mm512_loadu_ps, _mm512_set1_ps, _mm512_mul_ps, _mm512_min_ps, _mm512_max_ps,
+		_mm512_cvtps_epi32, STORE_AVX512);
+}
+
+#if defined(WAVE_LANES_VECTOR)
+__attribute__((target("sse4.2")))
+static void RenderWaveLanesSse42(WaveLanes *lanes, float *const *buffers, int count, unsigned int *rendered)
+{
+	RenderWaveLanesKernel(lanes, buffers, count, rendered, 16);
+}
+
+__attribute__((target("avx2")))
+static void RenderWaveLanesAvx2(WaveLanes *lanes, float *const *buffers, int count, unsigned int *rendered)
+{
+	RenderWaveLanesKernel(lanes, buffers, count, rendered, 32);
+}
+
+__attribute__((target("avx512f")))
+static void RenderWaveLanesAvx512(WaveLanes *lanes, float *const *buffers, int count, unsigned int *rendered)
+{
+	RenderWaveLanesKernel(lanes, buffers, count, rendered, 64);
+}
+#else
+#define RenderWaveLanesSse42    RenderWaveLanesGeneric
+#define RenderWaveLanesAvx2     RenderWaveLanesGeneric
+#define RenderWaveLanesAvx512   RenderWaveLanesGeneric
+#endif
+
+static bool IsSse42Supported(void) { return __builtin_cpu_supports("sse4.2"); }
+static bool IsAvx2Supported(void) { return __builtin_cpu_supports("avx2"); }
+static bool IsAvx512Supported(void) { return __builtin_cpu_supports("avx512f"); }
+#endif
+
+static bool IsGenericSupported(void) { return true; }
+
+// Render and conversion kernels for an instruction set
+typedef struct WaveKernel {
+	const char *name;
+	int (*renderBlock)(WaveState *state, float *buffer, int count);
+	void (*renderLanes)(WaveLanes *lanes, float *const *buffers, int count, unsigned int *rendered);
+	void (*quantizeSamples)(int32_t *dst, const float *src, unsigned int count, float gain, float scale);
+	bool (*isSupported)(void);
+} WaveKernel;
+
+// Kernels from the most to the least widely supported
+static const WaveKernel waveKernels[] = {
+	{ "generic", RenderWaveBlockGeneric, RenderWaveLanesGeneric, QuantizeSamplesGeneric, IsGenericSupported },
+#if defined(WAVE_KERNELS_X86)
+	{ "sse4.2", RenderWaveBlockGeneric, RenderWaveLanesSse42, QuantizeSamplesSse42, IsSse42Supported },
+	{ "avx2", RenderWaveBlockGeneric, RenderWaveLanesAvx2, QuantizeSamplesAvx2, IsAvx2Supported },
+	{ "avx512", RenderWaveBlockGeneric, RenderWaveLanesAvx512, QuantizeSamplesAvx512, IsAvx512Supported },
+#endif
+};
+
+#define WAVE_KERNEL_COUNT   ((int)(sizeof(waveKernels)/sizeof(waveKernels[0])))
+
+static const WaveKernel *activeKernel = NULL;
+
+static const WaveKernel *FindWaveKernel(const char *name)
+{
+	for (int i = 0; i < WAVE_KERNEL_COUNT; i++)
+	{
+		if (strcmp(waveKernels[i].name, name) == 0) return &waveKernels[i];
+	}
+
+	return NULL;
+}
+
+// Get the best kernel the CPU supports
+static const WaveKernel *FindBestWaveKernel(void)
+{
+	for (int i = WAVE_KERNEL_COUNT - 1; i > 0; i--)
+	{
+		if (waveKernels[i].isSupported()) return &waveKernels[i];
+	}
+
+	return &waveKernels[0];
+}
+
+// Get the kernel in use, selecting one on first use
+// NOTE: The RFXGEN_KERNEL environment variable overrides the choice, if the CPU supports it.
+// Safe to call from several threads at once.
+static const WaveKernel *GetActiveKernel(void)
+{
+	const WaveKernel *kernel = LoadKernelPointer(&activeKernel);
+
+	if (kernel == NULL)
+	{
+		const char *name = getenv("RFXGEN_KERNEL");
+
+		kernel = ((name != NULL) && IsWaveKernelSupported(name)) ? FindWaveKernel(name) : FindBestWaveKernel();
+
+		InitKernelPointer(&activeKernel, kernel);
+		kernel = LoadKernelPointer(&activeKernel);
+	}
+
+	return kernel;
+}
+
+// Get the number of render kernels built in
+int GetWaveKernelCount(void)
+{
+	return WAVE_KERNEL_COUNT;
+}
+
+// Get the name of a built in render kernel, NULL if index is out of range
+const char *GetWaveKernelName(int index)
+{
+	if ((index < 0) || (index >= WAVE_KERNEL_COUNT)) return NULL;
+
+	return waveKernels[index].name;
+}
+
+// Check if a render kernel is built in and supported by the CPU
+bool IsWaveKernelSupported(const char *name)
+{
+	const WaveKernel *kernel = FindWaveKernel(name);
+
+	return (kernel != NULL) && kernel->isSupported();
+}
+
+// Select the render kernel by name, or the best one the CPU supports if name is NULL
+// NOTE: Renders already running on other threads may finish with the previous kernel
+bool SetWaveKernel(const char *name)
+{
+	if (name == NULL)
+	{
+		StoreKernelPointer(&activeKernel, FindBestWaveKernel());
+		return true;
+	}
+
+	if (!IsWaveKernelSupported(name)) return false;
+
+	StoreKernelPointer(&activeKernel, FindWaveKernel(name));
+
+	return true;
+}
+
+// Get the name of the render kernel in use
+const char *GetActiveWaveKernel(void)
+{
+	return GetActiveKernel()->name;
+}
+
+// Generates new wave from wave parameters
+// NOTE: By default wave is generated as 44100Hz, 32bit float, mono
+Wave GenerateWave(WaveParams *params, const WaveAllocator *allocator)
+{
+    return GenerateWaveEx(params, allocator, NULL, NULL, NULL);
+}
+
+// Generates new wave from wave parameters, accumulating statistics and an overview of the output samples
+// NOTE: stats, overview and profile may be NULL if not required
+Wave GenerateWaveEx(WaveParams *params, const WaveAllocator *allocator, WaveStats *stats, WaveOverview *overview, WaveProfile *profile)
+{
+    const WaveKernel *kernel = GetActiveKernel();
+    WaveState state;
+
+    InitWaveState(&state, params, overview);
+
+    // NOTE: We reserve enough space for up to 10 seconds of wave audio at given sample rate
+    // By default we use float size samples, they are converted to desired sample size at the end
+    // The buffer is shrunk to the generated length afterwards, which happens in place
+    // for both the C library and WaveArena, so a wave costs a single allocation.
+    float *buffer = WaveMalloc(MAX_WAVE_LENGTH_SECONDS*WAVE_SAMPLE_RATE*sizeof(float), allocator);
+
+    Wave genWave;
+    genWave.sampleCount = 0;
+    genWave.sampleRate = WAVE_SAMPLE_RATE; // By default 44100 Hz
+    genWave.sampleSize = 32;               // By default 32 bit float samples
+    genWave.channels = 1;                  // By default 1 channel (mono)
+    genWave.data = NULL;
+
+    if (buffer == NULL)
+    {
+        if (stats != NULL) ResetWaveStats(stats);
+        if (overview != NULL) BuildWaveOverview(overview, 0, 0);
+        if (profile != NULL) ResetWaveProfile(profile);
+        return genWave;
+    }
+
+    unsigned long fpuState = BeginFlushDenormals();
+
+    kernel->renderBlock(&state, buffer, MAX_WAVE_LENGTH_SECONDS*WAVE_SAMPLE_RATE);
+
+    EndFlushDenormals(fpuState);
+
+    int sampleCount = state.sampleCount;
+
+    if (overview != NULL)
+    {
+        if (state.binFill > 0)
+        {
+            overview->bins[state.binIndex][0] = state.binMin;
+            overview->bins[state.binIndex][1] = state.binMax;
+            state.binIndex++;
+        }
+
+        BuildWaveOverview(overview, sampleCount, state.binIndex);
+    }
+
+    genWave.sampleCount = sampleCount;
+
+    if (stats != NULL)
+    {
+        stats->sampleCount = sampleCount;
+        stats->peak = state.peak;
+        stats->clipCount = state.clipCount;
+        stats->sum = state.sum;
+        stats->sumSquares = state.sumSquares;
+        stats->checksum = state.checksum;
+    }
+
+    if (profile != NULL)
+    {
+        *profile = state.profile;
+        profile->sampleCount = sampleCount;
+    }
+
+    if (sampleCount == 0)
+    {
+        WaveFree(buffer, allocator);
+        return genWave;
+    }
+
+    genWave.data = WaveRealloc(buffer, genWave.sampleCount*genWave.channels*genWave.sampleSize/8, allocator);
+
+    // Keep the full size buffer if it could not be shrunk
+    if (genWave.data == NULL) genWave.data = buffer;
+
+    return genWave;
+}
+
+// Get the number of samples GenerateWave() will produce for params, without generating them
+// NOTE: Only the frequency slide is simulated, and only when a minimum frequency can end the
+// wave before its envelope does, which costs a small fraction of rendering it
+unsigned int GetWaveSampleCount(const WaveParams *params)
+{
+    WaveParams adjusted = *params;
+    WaveState state;
+
+    InitWaveState(&state, &adjusted, NULL);
+
+    // Each envelope stage lasts one sample more than its length
+    long long length = 0;
+
+    for (int stage = 0; stage < 3; stage++) length += (state.envelopeLength[stage] > 0 ? state.envelopeLength[stage] : 0) + 1;
+
+    if (length > MAX_WAVE_LENGTH_SECONDS*WAVE_SAMPLE_RATE) length = MAX_WAVE_LENGTH_SECONDS*WAVE_SAMPLE_RATE;
+
+    if (adjusted.minFrequencyValue <= 0.0f) return (unsigned int)length;
+
+    // Same steps as RenderWaveBlockKernel(), a repeat restores the initial values
+    double fperiod = state.fperiod;
+    double fslide = state.fslide;
+    int repeatTime = 0;
+    int arpeggioTime = 0;
+    int arpeggioLimit = state.arpeggioLimit;
+    unsigned long fpuState = BeginFlushDenormals();
+    long long i;
+
+    for (i = 0; i < length; i++)
+    {
+        repeatTime++;
+
+        if ((state.repeatLimit != 0) && (repeatTime >= state.repeatLimit))
+        {
+            repeatTime = 0;
+            fperiod = state.restart.fperiod;
+            fslide = state.restart.fslide;
+            arpeggioTime = 0;
+            arpeggioLimit = state.restart.arpeggioLimit;
+        }
+
+        arpeggioTime++;
+
+        if ((arpeggioLimit != 0) && (arpeggioTime >= arpeggioLimit))
+        {
+            arpeggioLimit = 0;
+            fperiod *= state.arpeggioModulation;
+        }
+
+        fslide += state.fdslide;
+        fperiod *= fslide;
+
+        if (fperiod > state.fmaxperiod) break;
+    }
+
+    EndFlushDenormals(fpuState);
+
+    return (unsigned int)(i < length ? i + 1 : length);
+}
+
+// Generator of a wave rendered block by block
+struct WaveGenerator {
+    WaveParams params;              // Copy of the parameters, adjusted by InitWaveState()
+    WaveState state;
+};
+
+// Derive generator state from wave parameters, for rendering with RenderWaveBlock()
+// NOTE: Unlike GenerateWave(), params is not modified. Returns NULL if out of memory
+WaveGenerator *LoadWaveGenerator(const WaveParams *params, const WaveAllocator *allocator)
+{
+    WaveGenerator *generator = WaveMalloc(sizeof(WaveGenerator), allocator);
+
+    if (generator == NULL) return NULL;
+
+    ResetWaveGenerator(generator, params);
+
+    return generator;
+}
+
+// Restart generator from the beginning of a wave with new parameters
+// NOTE: Allocates nothing, so it can be called on a real-time audio thread
+void ResetWaveGenerator(WaveGenerator *generator, const WaveParams *params)
+{
+    generator->params = *params;
+    InitWaveState(&generator->state, &generator->params, NULL);
+}
+
+// Render up to count samples of the wave into buffer, returns the number rendered
+// NOTE: Returns less than count once the wave has ended, and 0 after that. The samples
+// of all blocks together are identical to those of GenerateWave()
+unsigned int RenderWaveBlock(WaveGenerator *generator, float *buffer, unsigned int count)
+{
+    WaveState *state = &generator->state;
+    unsigned int remaining = MAX_WAVE_LENGTH_SECONDS*WAVE_SAMPLE_RATE - state->sampleCount;
+
+    if (count > remaining) count = remaining;
+    if (!state->generatingSample || (count == 0)) return 0;
+
+    unsigned long fpuState = BeginFlushDenormals();
+
+    int rendered = GetActiveKernel()->renderBlock(state, buffer, (int)count);
+
+    EndFlushDenormals(fpuState);
+
+    return (unsigned int)rendered;
+}
+
+// Get statistics of the samples rendered so far
+void GetWaveGeneratorStats(const WaveGenerator *generator, WaveStats *stats)
+{
+    const WaveState *state = &generator->state;
+
+    stats->sampleCount = state->sampleCount;
+    stats->peak = state->peak;
+    stats->clipCount = state->clipCount;
+    stats->sum = state->sum;
+    stats->sumSquares = state->sumSquares;
+    stats->checksum = state->checksum;
+}
+
+// Unload generator loaded by LoadWaveGenerator()
+void UnloadWaveGenerator(WaveGenerator *generator, const WaveAllocator *allocator)
+{
+    WaveFree(generator, allocator);
+}
+
+// Load a lane generator with every lane empty, start waves in it with SetWaveLane()
+// NOTE: Returns NULL if out of memory
+WaveLanes *LoadWaveLanes(const WaveAllocator *allocator)
+{
+    WaveLanes *lanes = WaveMalloc(sizeof(WaveLanes), allocator);
+
+    if (lanes == NULL) return NULL;
+
+    memset(lanes, 0, sizeof(*lanes));
+
+    for (int l = 0; l < WAVE_LANES; l++) SetWaveLane(lanes, l, NULL);
+
+    return lanes;
+}
+
+// Start a wave in a lane from the beginning, or empty the lane if params is NULL
+// NOTE: params is copied and not modified. Allocates nothing, so it can be called on a
+// real-time audio thread, and the other lanes carry on where they were
+void SetWaveLane(WaveLanes *lanes, int lane, const WaveParams *params)
+{
+    if ((lane < 0) || (lane >= WAVE_LANES)) return;
+
+#if defined(WAVE_LANES_VECTOR)
+    unsigned int bit = 1u << lane;
+
+    lanes->sineLanes &= ~bit;
+    lanes->noiseLanes &= ~bit;
+    lanes->vibratoLanes &= ~bit;
+    lanes->generating[lane] = 0;
+    lanes->sampleCount[lane] = 0;
+    lanes->clipCount[lane] = 0;
+    lanes->peak[lane] = 0.0f;
+    lanes->sum[lane] = 0.0;
+    lanes->sumSquares[lane] = 0.0;
+    lanes->checksum[lane] = WAVE_CHECKSUM_INIT;
+
+    // An empty lane keeps the rest of its state, which is never used until a wave starts
+    if (params == NULL) return;
+
+    WaveParams copy = *params;
+    WaveState state;
+
+    InitWaveState(&state, &copy, NULL);
+
+    lanes->rng[lane] = state.rng;
+    lanes->restart[lane] = state.restart;
+    lanes->fperiod[lane] = state.fperiod;
+    lanes->fmaxperiod[lane] = state.fmaxperiod;
+    lanes->fslide[lane] = state.fslide;
+    lanes->fdslide[lane] = state.fdslide;
+    lanes->arpeggioModulation[lane] = state.arpeggioModulation;
+    lanes->phase[lane] = state.phase;
+    lanes->period[lane] = state.period;
+    lanes->envelopeStage[lane] = state.envelopeStage;
+    lanes->envelopeTime[lane] = state.envelopeTime;
+    lanes->stageLength[lane] = state.envelopeLength[0];
+    lanes->iphase[lane] = state.iphase;
+    lanes->repeatTime[lane] = state.repeatTime;
+    lanes->repeatLimit[lane] = state.repeatLimit;
+    lanes->arpeggioTime[lane] = state.arpeggioTime;
+    lanes->arpeggioLimit[lane] = state.arpeggioLimit;
+    lanes->waveType[lane] = copy.waveTypeValue;
+    lanes->lpfEnabled[lane] = state.lpfEnabled ? -1 : 0;
+    lanes->stopsAtMinFrequency[lane] = state.stopsAtMinFrequency ? -1 : 0;
+    lanes->hasVibrato[lane] = (state.vibratoAmplitude > 0.0f) ? -1 : 0;
+    lanes->squareDuty[lane] = state.squareDuty;
+    lanes->squareSlide[lane] = state.squareSlide;
+    lanes->envelopeVolume[lane] = state.envelopeVolume;
+    lanes->sustainPunch[lane] = copy.sustainPunchValue;
+    lanes->fphase[lane] = state.fphase;
+    lanes->fdphase[lane] = state.fdphase;
+    lanes->fltp[lane] = state.fltp;
+    lanes->fltdp[lane] = state.fltdp;
+    lanes->fltw[lane] = state.fltw;
+    lanes->fltwd[lane] = state.fltwd;
+    lanes->fltdmp[lane] = state.fltdmp;
+    lanes->fltphp[lane] = state.fltphp;
+    lanes->flthp[lane] = state.flthp;
+    lanes->flthpd[lane] = state.flthpd;
+    lanes->vibratoPhase[lane] = state.vibratoPhase;
+    lanes->vibratoSpeed[lane] = state.vibratoSpeed;
+    lanes->vibratoAmplitude[lane] = state.vibratoAmplitude;
+
+    for (int stage = 0; stage < 3; stage++) lanes->envelopeLength[stage][lane] = state.envelopeLength[stage];
+    for (int i = 0; i < 32; i++) lanes->noiseBuffer[i][lane] = state.noiseBuffer[i];
+    for (int i = 0; i < 1024; i++) lanes->phaserBuffer[i][lane] = 0.0f;
+
+    if (copy.waveTypeValue == 2) lanes->sineLanes |= bit;
+    if (copy.waveTypeValue == 3) lanes->noiseLanes |= bit;
+    if (state.vibratoAmplitude > 0.0f) lanes->vibratoLanes |= bit;
+
+    lanes->generating[lane] = -1;
+#else
+    if (params == NULL)
+    {
+        memset(&lanes->state[lane], 0, sizeof(WaveState));
+        lanes->state[lane].checksum = WAVE_CHECKSUM_INIT;
+        return;
+    }
+
+    lanes->params[lane] = *params;
+    InitWaveState(&lanes->state[lane], &lanes->params[lane], NULL);
+#endif
+}
+
+// Get a bit for every lane whose wave has samples left to render
+static unsigned int GetPlayingWaveLanes(const WaveLanes *lanes)
+{
+    unsigned int playing = 0;
+
+    for (int l = 0; l < WAVE_LANES; l++)
+    {
+#if defined(WAVE_LANES_VECTOR)
+        bool generating = (lanes->generating[l] != 0) && (lanes->sampleCount[l] < MAX_WAVE_LENGTH_SECONDS*WAVE_SAMPLE_RATE);
+#else
+        bool generating = lanes->state[l].generatingSample && (lanes->state[l].sampleCount < MAX_WAVE_LENGTH_SECONDS*WAVE_SAMPLE_RATE);
+#endif
+        if (generating) playing |= 1u << l;
+    }
+
+    return playing;
+}
+
+// Render up to count samples of the wave in every lane into buffers[lane], returns a bit for
+// every lane still playing afterwards
+// NOTE: Stores the number of samples rendered in each lane in rendered, unless it is NULL,
+// fewer than count once its wave has ended. Buffers of empty lanes may be NULL. The samples
+// of each lane are identical to those of RenderWaveBlock() for its wave
+unsigned int RenderWaveLanes(WaveLanes *lanes, float *const *buffers, unsigned int count, unsigned int *rendered)
+{
+    unsigned int counts[WAVE_LANES];
+
+    if (rendered == NULL) rendered = counts;
+    if (count > MAX_WAVE_LENGTH_SECONDS*WAVE_SAMPLE_RATE) count = MAX_WAVE_LENGTH_SECONDS*WAVE_SAMPLE_RATE;
+
+    unsigned long fpuState = BeginFlushDenormals();
+
+    GetActiveKernel()->renderLanes(lanes, buffers, (int)count, rendered);
+
+    EndFlushDenormals(fpuState);
+
+    return GetPlayingWaveLanes(lanes);
+}
+
+// Get statistics of the samples rendered in a lane since its wave started
+void GetWaveLaneStats(const WaveLanes *lanes, int lane, WaveStats *stats)
+{
+    if ((lane < 0) || (lane >= WAVE_LANES))
+    {
+        ResetWaveStats(stats);
+        return;
+    }
+
+#if defined(WAVE_LANES_VECTOR)
+    stats->sampleCount = lanes->sampleCount[lane];
+    stats->peak = lanes->peak[lane];
+    stats->clipCount = lanes->clipCount[lane];
+    stats->sum = lanes->sum[lane];
+    stats->sumSquares = lanes->sumSquares[lane];
+    stats->checksum = lanes->checksum[lane];
+#else
+    const WaveState *state = &lanes->state[lane];
+
+    stats->sampleCount = state->sampleCount;
+    stats->peak = state->peak;
+    stats->clipCount = state->clipCount;
+    stats->sum = state->sum;
+    stats->sumSquares = state->sumSquares;
+    stats->checksum = state->checksum;
+#endif
+}
+
+// Unload lane generator loaded by LoadWaveLanes()
+void UnloadWaveLanes(WaveLanes *lanes, const WaveAllocator *allocator)
+{
+    WaveFree(lanes, allocator);
+}
+
+// Samples rendered in every lane at a time by GenerateWaves(), a lane whose wave ends
+// waits at most this long for the next wave
+#define WAVE_LANES_CHUNK    256
+
+// Wave of a GenerateWaves() batch and its predicted length
+typedef struct WaveOrder {
+    unsigned int length;
+    int index;
+} WaveOrder;
+
+// Sort longer waves first, in batch order if equally long
+static int CompareWaveOrder(const void *a, const void *b)
+{
+    const WaveOrder *x = (const WaveOrder *)a;
+    const WaveOrder *y = (const WaveOrder *)b;
+
+    if (x->length != y->length) return (x->length < y->length) ? 1 : -1;
+
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+// Generate count waves side by side, WAVE_LANES at a time, each identical to GenerateWave()
+// NOTE: A lane starts the next wave as soon as its wave ends, and the longest waves start first
+// so that the lanes run out of waves at about the same time. Unlike GenerateWave(), params is
+// not modified. stats may be NULL. Returns the number of waves generated, fewer than count if
+// memory ran out: waves that could not be allocated are left empty
+int GenerateWaves(const WaveParams *params, int count, Wave *waves, WaveStats *stats, const WaveAllocator *allocator)
+{
+    for (int i = 0; i < count; i++)
+    {
+        waves[i].sampleCount = 0;
+        waves[i].sampleRate = WAVE_SAMPLE_RATE;
+        waves[i].sampleSize = 32;
+        waves[i].channels = 1;
+        waves[i].data = NULL;
+
+        if (stats != NULL) ResetWaveStats(&stats[i]);
+    }
+
+    if (count <= 0) return 0;
+
+    WaveOrder *order = WaveMalloc(count*sizeof(WaveOrder), allocator);
+    WaveLanes *lanes = LoadWaveLanes(allocator);
+
+    if ((order == NULL) || (lanes == NULL))
+    {
+        if (order != NULL) WaveFree(order, allocator);
+        if (lanes != NULL) UnloadWaveLanes(lanes, allocator);
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        order[i].length = GetWaveSampleCount(&params[i]);
+        order[i].index = i;
+    }
+
+    qsort(order, count, sizeof(WaveOrder), CompareWaveOrder);
+
+    const WaveKernel *kernel = GetActiveKernel();
+    int index[WAVE_LANES];              // Wave rendered in each lane, -1 if empty
+    unsigned int capacity[WAVE_LANES];
+    float *data[WAVE_LANES];
+    float *buffers[WAVE_LANES];
+    unsigned int rendered[WAVE_LANES];
+    int next = 0, generated = 0;
+
+    for (int l = 0; l < WAVE_LANES; l++)
+    {
+        index[l] = -1;
+        data[l] = NULL;
+    }
+
+    unsigned long fpuState = BeginFlushDenormals();
+
+    for (;;)
+    {
+        int chunk = WAVE_LANES_CHUNK;
+        bool playing = false;
+
+        for (int l = 0; l < WAVE_LANES; l++)
+        {
+            // The buffer of a wave holds its predicted length, rendering stops at its end so
+            // no lane can write past it
+            while ((index[l] < 0) && (next < count))
+            {
+                const WaveOrder *wave = &order[next++];
+
+                data[l] = (wave->length > 0) ? WaveMalloc(wave->length*sizeof(float), allocator) : NULL;
+
+                if (data[l] != NULL)
+                {
+                    SetWaveLane(lanes, l, &params[wave->index]);
+                    index[l] = wave->index;
+                    capacity[l] = wave->length;
+                }
+                else if (wave->length == 0) generated++;
+            }
+
+            if (index[l] < 0) continue;
+
+            int remaining = (int)(capacity[l] - waves[index[l]].sampleCount);
+
+            if (remaining < chunk) chunk = remaining;
+
+            buffers[l] = data[l] + waves[index[l]].sampleCount;
+            playing = true;
+        }
+
+        if (!playing) break;
+
+        kernel->renderLanes(lanes, buffers, chunk, rendered);
+
+        for (int l = 0; l < WAVE_LANES; l++)
+        {
+            if (index[l] < 0) continue;
+
+            Wave *wave = &waves[index[l]];
+
+            wave->sampleCount += rendered[l];
+
+            if ((rendered[l] == (unsigned int)chunk) && (wave->sampleCount < capacity[l])) continue;
+
+            if ((rendered[l] == (unsigned int)chunk) && (GetPlayingWaveLanes(lanes) & (1u << l)))
+            {
+                // The wave filled its buffer but has not ended, which only a bug of GetWaveSampleCount()
+                // can cause, as make check verifies the prediction. Grow the buffer to the longest
+                // possible wave rather than cut the wave off.
+                float *grown = WaveRealloc(data[l], MAX_WAVE_LENGTH_SECONDS*WAVE_SAMPLE_RATE*sizeof(float), allocator);
+
+                if (grown != NULL)
+                {
+                    data[l] = grown;
+                    capacity[l] = MAX_WAVE_LENGTH_SECONDS*WAVE_SAMPLE_RATE;
+                    continue;
+                }
+
+                // Out of memory: leave the wave empty rather than return it cut off
+                wave->sampleCount = 0;
+            }
+            else generated++;
+
+            // The wave ended
+            if ((stats != NULL) && (wave->sampleCount > 0)) GetWaveLaneStats(lanes, l, &stats[index[l]]);
+
+            if (wave->sampleCount == 0) WaveFree(data[l], allocator);
+            else
+            {
+                wave->data = WaveRealloc(data[l], wave->sampleCount*sizeof(float), allocator);
+
+                // Keep the full size buffer if it could not be shrunk
+                if (wave->data == NULL) wave->data = data[l];
+            }
+
+            SetWaveLane(lanes, l, NULL);
+            index[l] = -1;
+            data[l] = NULL;
+        }
+    }
+
+    EndFlushDenormals(fpuState);
+
+    UnloadWaveLanes(lanes, allocator);
+    WaveFree(order, allocator);
+
+    return generated;
+}
+
+// Generate count random variations of a wave in memory, side by side as GenerateWaves()
+// NOTE: Variation n is params mutated by MutateWaveParams() with seed + n, stored in variations[n]
+// for saving the ones worth keeping. Each variation derives its own state when its lane starts:
+// that takes a few microseconds against milliseconds of rendering, so there is nothing to gain
+// from sharing the state derived from params. stats may be NULL. Returns the number of waves
+// generated, as GenerateWaves()
+int GenerateWaveVariations(const WaveParams *params, float amount, unsigned int seed, int count,
+    WaveParams *variations, Wave *waves, WaveStats *stats, const WaveAllocator *allocator)
+{
+    for (int i = 0; i < count; i++)
+    {
+        variations[i] = *params;
+        MutateWaveParams(&variations[i], amount, seed + (unsigned int)i);
+    }
+
+    return GenerateWaves(variations, count, waves, stats, allocator);
+}
+
+// Reset statistics to those of an empty wave
+void ResetWaveStats(WaveStats *stats)
+{
+	stats->sampleCount = 0;
+	stats->peak = 0.0f;
+	stats->clipCount = 0;
+	stats->sum = 0.0;
+	stats->sumSquares = 0.0;
+	stats->checksum = WAVE_CHECKSUM_INIT;
+}
+
+// Add the statistics of a wave to a running total
+// NOTE: The checksum of the total covers the checksums of each wave, in order
+void MergeWaveStats(WaveStats *total, const WaveStats *stats)
+{
+	unsigned int i;
+
+	total->sampleCount += stats->sampleCount;
+	if (stats->peak > total->peak) total->peak = stats->peak;
+	total->clipCount += stats->clipCount;
+	total->sum += stats->sum;
+	total->sumSquares += stats->sumSquares;
+
+	for (i = 0; i < 8; i++)
+	{
+		total->checksum ^= (stats->checksum >> (i*8)) & 0xFF;
+		total->checksum *= WAVE_CHECKSUM_PRIME;
+	}
+}
+
+// Check if GenerateWaveEx() was built to fill in profiles
+bool IsWaveProfileEnabled(void)
+{
+#if defined(RFXGEN_PROFILE)
+	return true;
+#else
+	return false;
+#endif
+}
+
+// Reset profile to that of an empty wave
+void ResetWaveProfile(WaveProfile *profile)
+{
+	memset(profile, 0, sizeof(*profile));
+}
+
+// Add the profile of a wave to a running total
+void MergeWaveProfile(WaveProfile *total, const WaveProfile *profile)
+{
+	unsigned int i;
+
+	for (i = 0; i < WAVE_STAGE_COUNT; i++) total->ticks[i] += profile->ticks[i];
+
+	total->sampleCount += profile->sampleCount;
+	total->periodWraps += profile->periodWraps;
+	total->noiseRefills += profile->noiseRefills;
+	total->repeatResets += profile->repeatResets;
+	total->arpeggioFires += profile->arpeggioFires;
+	total->clampHits += profile->clampHits;
+}
+
+// Get the name of a generation stage, for reports
+const char *GetWaveStageName(WaveStage stage)
+{
+	static const char *const names[WAVE_STAGE_COUNT] = {
+		"params", "oscillator", "filter", "phaser", "supersample", "output"
+	};
+
+	if ((unsigned int)stage >= WAVE_STAGE_COUNT) return "unknown";
+
+	return names[stage];
+}
+
+// Export overview as a sidecar file, with gain applied to the overview samples
+// NOTE: The file is little-endian and laid out as follows:
+//   Offset | Size         | Description
+//   0      | 4            | Signature: "rFXO"
+//   4      | 2            | Version: 1
+//   6      | 2            | Level count (L)
+//   8      | 4            | Sample count
+//   12     | 4            | Samples per bin at level 0
+//   16     | 4*L          | Bin count of each level
+//   16+4*L | 2 per bin    | Bins of each level, finest first: signed 8 bit min, max (-127..127 is -1..1)
+bool ExportWaveOverview(const WaveOverview *overview, float gain, const char *fileName)
+{
+	unsigned char header[16 + 4*WAVE_OVERVIEW_MAX_LEVELS];
+	unsigned int headerSize = 16 + 4*overview->levelCount;
+	unsigned int totalBins = 0;
+	unsigned int i;
+	bool success;
+	FILE *file;
+
+	#define PUT16(p, v) { (p)[0] = (unsigned char)((v) & 0xFF); (p)[1] = (unsigned char)(((v) >> 8) & 0xFF); }
+	#define PUT32(p, v) { PUT16(p, (v) & 0xFFFF); PUT16((p) + 2, ((v) >> 16) & 0xFFFF); }
+
+	memcpy(header, "rFXO", 4);
+	PUT16(header + 4, 1);
+	PUT16(header + 6, overview->levelCount);
+	PUT32(header + 8, overview->sampleCount);
+	PUT32(header + 12, WAVE_OVERVIEW_BIN_SIZE);
+
+	for (i = 0; i < overview->levelCount; i++)
+	{
+		PUT32(header + 16 + 4*i, overview->binCount[i]);
+		totalBins += overview->binCount[i];
+	}
+
+	file = fopen(fileName, "wb");
+	if (file == NULL) return false;
+
+	success = (fwrite(header, 1, headerSize, file) == headerSize);
+
+	for (i = 0; (i < totalBins) && success; i++)
+	{
+		signed char minMax[2];
+		float lo = overview->bins[i][0]*gain;
+		float hi = overview->bins[i][1]*gain;
+
+		if (lo < -1.0f) lo = -1.0f;
+		if (lo > 1.0f) lo = 1.0f;
+		if (hi < -1.0f) hi = -1.0f;
+		if (hi > 1.0f) hi = 1.0f;
+
+		// Round outwards so the overview always contains the waveform
+		lo = floorf(lo*127.0f);
+		hi = ceilf(hi*127.0f);
+
+		minMax[0] = (signed char)lo;
+		minMax[1] = (signed char)hi;
+
+		success = (fwrite(minMax, 1, 2, file) == 2);
+	}
+
+	if (fclose(file) != 0) success = false;
+
+	return success;
+}
+
+// Get the gain that brings the peak of a wave to targetDb dBFS
+// NOTE: Silent waves get unity gain
+float GetWavePeakGain(const WaveStats *stats, float targetDb)
+{
+	if (stats->peak <= 0.0f) return 1.0f;
+
+	return (float)(pow(10.0, targetDb/20.0)/stats->peak);
+}
+
+// Get the gain that brings the RMS level of a wave to targetDb dBFS, an approximation of loudness
+// NOTE: Gain is limited so that the peak does not exceed 0 dBFS
+float GetWaveRmsGain(const WaveStats *stats, float targetDb)
+{
+	double rms;
+	float gain;
+
+	if (stats->sampleCount == 0 || stats->sumSquares <= 0.0) return 1.0f;
+
+	rms = sqrt(stats->sumSquares/stats->sampleCount);
+	gain = (float)(pow(10.0, targetDb/20.0)/rms);
+
+	if (stats->peak*gain > 1.0f) gain = 1.0f/stats->peak;
+
+	return gain;
+}
+
+// Convert float samples to sampleSize bits per sample (8, 16 and 24 bit integer or 32 bit float),
+// applying gain on the way. Samples are written little-endian, 8 bit samples are unsigned.
+// Returns the number of bytes written to dst
+unsigned int ConvertWaveSamples(void *dst, const float *src, unsigned int count, unsigned int sampleSize, float gain)
+{
+	#define CONVERT_BLOCK 256
+
+	void (*quantizeSamples)(int32_t *, const float *, unsigned int, float, float) = GetActiveKernel()->quantizeSamples;
+	unsigned char *out = dst;
+	int32_t v[CONVERT_BLOCK];
+	unsigned int i, j, n;
+
+	switch (sampleSize)
+	{
+		case 8:
+		{
+			for (i = 0; i < count; i += n)
+			{
+				n = (count - i < CONVERT_BLOCK) ? count - i : CONVERT_BLOCK;
+				quantizeSamples(v, src + i, n, gain, 127.0f);
+				for (j = 0; j < n; j++) out[i + j] = (unsigned char)(v[j] + 128);
+			}
+		} break;
+		case 16:
+		{
+			for (i = 0; i < count; i += n)
+			{
+				n = (count - i < CONVERT_BLOCK) ? count - i : CONVERT_BLOCK;
+				quantizeSamples(v, src + i, n, gain, 32767.0f);
+
+				for (j = 0; j < n; j++)
+				{
+					out[(i + j)*2] = (unsigned char)(v[j] & 0xFF);
+					out[(i + j)*2 + 1] = (unsigned char)((v[j] >> 8) & 0xFF);
+				}
+			}
+		} break;
+		case 24:
+		{
+			for (i = 0; i < count; i += n)
+			{
+				n = (count - i < CONVERT_BLOCK) ? count - i : CONVERT_BLOCK;
+				quantizeSamples(v, src + i, n, gain, 8388607.0f);
+
+				for (j = 0; j < n; j++)
+				{
+					out[(i + j)*3] = (unsigned char)(v[j] & 0xFF);
+					out[(i + j)*3 + 1] = (unsigned char)((v[j] >> 8) & 0xFF);
+					out[(i + j)*3 + 2] = (unsigned char)((v[j] >> 16) & 0xFF);
+				}
+			}
+		} break;
+		case 32:
+		{
+			for (i = 0; i < count; i++)
+			{
+				float x = src[i]*gain;
+				uint32_t bits;
+
+				if (x > 1.0f) x = 1.0f;
+				else if (x < -1.0f) x = -1.0f;
+
+				memcpy(&bits, &x, sizeof(bits));
+				out[i*4] = (unsigned char)(bits & 0xFF);
+				out[i*4 + 1] = (unsigned char)((bits >> 8) & 0xFF);
+				out[i*4 + 2] = (unsigned char)((bits >> 16) & 0xFF);
+				out[i*4 + 3] = (unsigned char)((bits >> 24) & 0xFF);
+			}
+		} break;
+		default: return 0;
+	}
+
+	return count*(sampleSize/8);
+}
+
+// Bounded destination of WAV data written by ExportWaveToBuffer()
+typedef struct WaveBufferWriter {
+	unsigned char *data;
+	size_t capacity;
+	size_t position;                // Offset of the next write
+	size_t size;                    // Size of the data written so far, including what is past capacity
+} WaveBufferWriter;
+
+// Write callback of dr_wav for a WaveBufferWriter, counting but dropping data past the end
+static size_t WriteWaveBuffer(void *userData, const void *data, size_t bytesToWrite)
+{
+	WaveBufferWriter *writer = userData;
+
+	if (writer->position < writer->capacity)
+	{
+		size_t n = writer->capacity - writer->position;
+
+		if (n > bytesToWrite) n = bytesToWrite;
+		memcpy(writer->data + writer->position, data, n);
+	}
+
+	writer->position += bytesToWrite;
+	if (writer->size < writer->position) writer->size = writer->position;
+
+	return bytesToWrite;
+}
+
+// Seek callback of dr_wav for a WaveBufferWriter, used to write the chunk sizes once known
+static drwav_bool32 SeekWaveBuffer(void *userData, int offset, drwav_seek_origin origin)
+{
+	WaveBufferWriter *writer = userData;
+	size_t base = (origin == drwav_seek_origin_current) ? writer->position : 0;
+
+	if ((offset < 0) && ((size_t)-offset > base)) return DRWAV_FALSE;
+	if ((offset > 0) && (base + (size_t)offset > writer->size)) return DRWAV_FALSE;
+
+	writer->position = (offset < 0) ? base - (size_t)-offset : base + (size_t)offset;
+
+	return DRWAV_TRUE;
+}
+
+// Get the gain applied to a wave with the given statistics to normalize it as format requires
+static float GetWaveFormatGain(const WaveFormat *format, const WaveStats *stats)
+{
+	switch (format->normalize)
+	{
+		case WAVE_NORMALIZE_PEAK: return GetWavePeakGain(stats, format->targetDb);
+		case WAVE_NORMALIZE_RMS: return GetWaveRmsGain(stats, format->targetDb);
+		default: return 1.0f;
+	}
+}
+
+// Write the samples of a wave in the sample size of format, converted in blocks on the stack
+static bool WriteWaveFrames(drwav *wav, const Wave *wave, const WaveFormat *format, float gain)
+{
+	unsigned char block[EXPORT_BLOCK*4];
+	const float *src = wave->data;
+
+	for (unsigned int i = 0, n; i < wave->sampleCount; i += n)
+	{
+		n = (wave->sampleCount - i < EXPORT_BLOCK) ? wave->sampleCount - i : EXPORT_BLOCK;
+		ConvertWaveSamples(block, src + i, n, format->sampleSize, gain);
+
+		if (drwav_write_pcm_frames_le(wav, n, block) != n) return false;
+	}
+
+	return true;
+}
+
+// Render wave parameters and write them as WAV data, to memory allocated by dr_wav when
+// writer is NULL, or to the buffer of writer. Returns false on failure
+// NOTE: Written with seekable writers, so that the data is byte for byte what dr_wav writes
+// to a file, sizes of odd-sized chunks included
+static bool ExportWaveData(const WaveParams *params, WaveFormat format, const WaveAllocator *allocator,
+		WaveBufferWriter *writer, void **data, size_t *dataSize)
+{
+	drwav_allocation_callbacks callbacks = { 0 };
+	drwav_data_format wavFormat;
+	WaveParams wp = *params;
+	WaveStats stats;
+	drwav wav;
+	bool success = false;
+
+	if ((format.sampleSize != 8) && (format.sampleSize != 16) && (format.sampleSize != 24) && (format.sampleSize != 32)) return false;
+
+	if (allocator != NULL)
+	{
+		callbacks.pUserData = allocator->userData;
+		callbacks.onMalloc = allocator->onMalloc;
+		callbacks.onRealloc = allocator->onRealloc;
+		callbacks.onFree = allocator->onFree;
+	}
+
+	Wave wave = GenerateWaveEx(&wp, allocator, &stats, NULL, NULL);
+
+	if ((wave.data == NULL) && (wave.sampleCount > 0)) return false;
+
+	wavFormat.container = drwav_container_riff;
+	wavFormat.format = (format.sampleSize == 32) ? DR_WAVE_FORMAT_IEEE_FLOAT : DR_WAVE_FORMAT_PCM;
+	wavFormat.channels = wave.channels;
+	wavFormat.sampleRate = wave.sampleRate;
+	wavFormat.bitsPerSample = format.sampleSize;
+
+	if (writer == NULL) success = drwav_init_memory_write(&wav, data, dataSize, &wavFormat, (allocator != NULL) ? &callbacks : NULL);
+	else success = drwav_init_write(&wav, &wavFormat, WriteWaveBuffer, SeekWaveBuffer, writer, (allocator != NULL) ? &callbacks : NULL);
+
+	if (success)
+	{
+		success = WriteWaveFrames(&wav, &wave, &format, GetWaveFormatGain(&format, &stats));
+
+		// NOTE: Memory data is only final once uninitialised
+		drwav_uninit(&wav);
+	}
+
+	UnloadWave(wave, allocator);
+
+	if (!success && (writer == NULL) && (*data != NULL))
+	{
+		drwav_free(*data, (allocator != NULL) ? &callbacks : NULL);
+		*data = NULL;
+	}
+
+	return success;
+}
+
+// Render wave parameters to WAV file data in memory, returns NULL on failure
+// NOTE: params is not modified, free the data with UnloadWaveData()
+unsigned char *ExportWaveToMemory(const WaveParams *params, WaveFormat format, const WaveAllocator *allocator, size_t *dataSize)
+{
+	void *data = NULL;
+	size_t size = 0;
+
+	if (!ExportWaveData(params, format, allocator, NULL, &data, &size)) return NULL;
+
+	*dataSize = size;
+
+	return data;
+}
+
+// Render wave parameters to WAV file data in buffer, returns the size of the data
+// NOTE: Data is only written if it fits in bufferSize bytes, call again with a larger buffer
+// when the returned size is larger. Returns 0 on failure. Memory for rendering is taken from
+// allocator, which may be NULL
+size_t ExportWaveToBuffer(const WaveParams *params, WaveFormat format, const WaveAllocator *allocator, void *buffer, size_t bufferSize)
+{
+	WaveBufferWriter writer = { buffer, bufferSize, 0, 0 };
+
+	if (!ExportWaveData(params, format, allocator, &writer, NULL, NULL)) return 0;
+
+	return writer.size;
+}
+
+// Unload WAV file data exported by ExportWaveToMemory()
+void UnloadWaveData(unsigned char *data, const WaveAllocator *allocator)
+{
+	WaveFree(data, allocator);
+}
+
+// Names of the preset categories, see WavePreset
+static const char *const wavePresetNames[WAVE_PRESET_COUNT] = {
+    "pickup", "laser", "explosion", "powerup", "hit", "jump", "blip"
+};
+
+// Random value between 0 and range, with the resolution of rFXGen's GetRandomFloat()
+static float GetPresetFloat(WaveRandom *rng, float range)
+{
+    return (float)GetRandomValue(rng, 0, 10000)/10000.0f*range;
+}
+
+// Reset wave parameters to the defaults of sfxr: a 0.7 second square wave without effects
+static void ResetWaveParams(WaveParams *params)
+{
+    memset(params, 0, sizeof(WaveParams));
+
+    params->startFrequencyValue = 0.3f;
+    params->sustainTimeValue = 0.3f;
+    params->decayTimeValue = 0.4f;
+    params->lpfCutoffValue = 1.0f;
+}
+
+// Generate random wave parameters of a category, like the preset buttons of rFXGen and sfxr
+// NOTE: Follows the sfxr generators. The same preset and seed always give the same parameters,
+// an unknown preset gives the sfxr defaults.
+void GenerateWavePreset(WaveParams *params, WavePreset preset, unsigned int seed)
+{
+    WaveRandom rng;
+
+    ResetWaveParams(params);
+    SeedWaveRandom(&rng, seed);
+    params->randSeed = GetRandomValue(&rng, 0, 0xFFFE);
+
+    switch (preset)
+    {
+        case WAVE_PRESET_PICKUP:
+        {
+            params->startFrequencyValue = 0.4f + GetPresetFloat(&rng, 0.5f);
+            params->attackTimeValue = 0.0f;
+            params->sustainTimeValue = GetPresetFloat(&rng, 0.1f);
+            params->decayTimeValue = 0.1f + GetPresetFloat(&rng, 0.4f);
+            params->sustainPunchValue = 0.3f + GetPresetFloat(&rng, 0.3f);
+
+            if (GetRandomValue(&rng, 0, 1))
+            {
+                params->changeSpeedValue = 0.5f + GetPresetFloat(&rng, 0.2f);
+                params->changeAmountValue = 0.2f + GetPresetFloat(&rng, 0.4f);
+            }
+        } break;
+        case WAVE_PRESET_LASER:
+        {
+            params->waveTypeValue = GetRandomValue(&rng, 0, 2);
+            if ((params->waveTypeValue == 2) && GetRandomValue(&rng, 0, 1)) params->waveTypeValue = GetRandomValue(&rng, 0, 1);
+
+            params->startFrequencyValue = 0.5f + GetPresetFloat(&rng, 0.5f);
+            params->minFrequencyValue = params->startFrequencyValue - 0.2f - GetPresetFloat(&rng, 0.6f);
+            if (params->minFrequencyValue < 0.2f) params->minFrequencyValue = 0.2f;
+            params->slideValue = -0.15f - GetPresetFloat(&rng, 0.2f);
+
+            if (GetRandomValue(&rng, 0, 2) == 0)
+            {
+                params->startFrequencyValue = 0.3f + GetPresetFloat(&rng, 0.6f);
+                params->minFrequencyValue = GetPresetFloat(&rng, 0.1f);
+                params->slideValue = -0.35f - GetPresetFloat(&rng, 0.3f);
+            }
+
+            if (GetRandomValue(&rng, 0, 1))
+            {
+                params->squareDutyValue = GetPresetFloat(&rng, 0.5f);
+                params->dutySweepValue = GetPresetFloat(&rng, 0.2f);
+            }
+            else
+            {
+                params->squareDutyValue = 0.4f + GetPresetFloat(&rng, 0.5f);
+                params->dutySweepValue = -GetPresetFloat(&rng, 0.7f);
+            }
+
+            params->attackTimeValue = 0.0f;
+            params->sustainTimeValue = 0.1f + GetPresetFloat(&rng, 0.2f);
+            params->decayTimeValue = GetPresetFloat(&rng, 0.4f);
+            if (GetRandomValue(&rng, 0, 1)) params->sustainPunchValue = GetPresetFloat(&rng, 0.3f);
+
+            if (GetRandomValue(&rng, 0, 2) == 0)
+            {
+                params->phaserOffsetValue = GetPresetFloat(&rng, 0.2f);
+                params->phaserSweepValue = -GetPresetFloat(&rng, 0.2f);
+            }
+
+            if (GetRandomValue(&rng, 0, 1)) params->hpfCutoffValue = GetPresetFloat(&rng, 0.3f);
+        } break;
+        case WAVE_PRESET_EXPLOSION:
+        {
+            params->waveTypeValue = 3;
+
+            if (GetRandomValue(&rng, 0, 1))
+            {
+                params->startFrequencyValue = 0.1f + GetPresetFloat(&rng, 0.4f);
+                params->slideValue = -0.1f + GetPresetFloat(&rng, 0.4f);
+            }
+            else
+            {
+                params->startFrequencyValue = 0.2f + GetPresetFloat(&rng, 0.7f);
+                params->slideValue = -0.2f - GetPresetFloat(&rng, 0.2f);
+            }
+
+            params->startFrequencyValue *= params->startFrequencyValue;
+            if (GetRandomValue(&rng, 0, 4) == 0) params->slideValue = 0.0f;
+            if (GetRandomValue(&rng, 0, 2) == 0) params->repeatSpeedValue = 0.3f + GetPresetFloat(&rng, 0.5f);
+
+            params->attackTimeValue = 0.0f;
+            params->sustainTimeValue = 0.1f + GetPresetFloat(&rng, 0.3f);
+            params->decayTimeValue = GetPresetFloat(&rng, 0.5f);
+
+            if (GetRandomValue(&rng, 0, 1) == 0)
+            {
+                params->phaserOffsetValue = -0.3f + GetPresetFloat(&rng, 0.9f);
+                params->phaserSweepValue = -GetPresetFloat(&rng, 0.3f);
+            }
+
+            params->sustainPunchValue = 0.2f + GetPresetFloat(&rng, 0.6f);
+
+            if (GetRandomValue(&rng, 0, 1))
+            {
+                params->vibratoDepthValue = GetPresetFloat(&rng, 0.7f);
+                params->vibratoSpeedValue = GetPresetFloat(&rng, 0.6f);
+            }
+
+            if (GetRandomValue(&rng, 0, 2) == 0)
+            {
+                params->changeSpeedValue = 0.6f + GetPresetFloat(&rng, 0.3f);
+                params->changeAmountValue = 0.8f - GetPresetFloat(&rng, 1.6f);
+            }
+        } break;
+        case WAVE_PRESET_POWERUP:
+        {
+            if (GetRandomValue(&rng, 0, 1)) params->waveTypeValue = 1;
+            else params->squareDutyValue = GetPresetFloat(&rng, 0.6f);
+
+            params->startFrequencyValue = 0.2f + GetPresetFloat(&rng, 0.3f);
+
+            if (GetRandomValue(&rng, 0, 1))
+            {
+                params->slideValue = 0.1f + GetPresetFloat(&rng, 0.4f);
+                params->repeatSpeedValue = 0.4f + GetPresetFloat(&rng, 0.4f);
+            }
+            else
+            {
+                params->slideValue = 0.05f + GetPresetFloat(&rng, 0.2f);
+
+                if (GetRandomValue(&rng, 0, 1))
+                {
+                    params->vibratoDepthValue = GetPresetFloat(&rng, 0.7f);
+                    params->vibratoSpeedValue = GetPresetFloat(&rng, 0.6f);
+                }
+            }
+
+            params->attackTimeValue = 0.0f;
+            params->sustainTimeValue = GetPresetFloat(&rng, 0.4f);
+            params->decayTimeValue = 0.1f + GetPresetFloat(&rng, 0.4f);
+        } break;
+        case WAVE_PRESET_HIT:
+        {
+            params->waveTypeValue = GetRandomValue(&rng, 0, 2);
+            if (params->waveTypeValue == 2) params->waveTypeValue = 3;
+            if (params->waveTypeValue == 0) params->squareDutyValue = GetPresetFloat(&rng, 0.6f);
+
+            params->startFrequencyValue = 0.2f + GetPresetFloat(&rng, 0.6f);
+            params->slideValue = -0.3f - GetPresetFloat(&rng, 0.4f);
+            params->attackTimeValue = 0.0f;
+            params->sustainTimeValue = GetPresetFloat(&rng, 0.1f);
+            params->decayTimeValue = 0.1f + GetPresetFloat(&rng, 0.2f);
+
+            if (GetRandomValue(&rng, 0, 1)) params->hpfCutoffValue = GetPresetFloat(&rng, 0.3f);
+        } break;
+        case WAVE_PRESET_JUMP:
+        {
+            params->waveTypeValue = 0;
+            params->squareDutyValue = GetPresetFloat(&rng, 0.6f);
+            params->startFrequencyValue = 0.3f + GetPresetFloat(&rng, 0.3f);
+            params->slideValue = 0.1f + GetPresetFloat(&rng, 0.2f);
+            params->attackTimeValue = 0.0f;
+            params->sustainTimeValue = 0.1f + GetPresetFloat(&rng, 0.3f);
+            params->decayTimeValue = 0.1f + GetPresetFloat(&rng, 0.2f);
+
+            if (GetRandomValue(&rng, 0, 1)) params->hpfCutoffValue = GetPresetFloat(&rng, 0.3f);
+            if (GetRandomValue(&rng, 0, 1)) params->lpfCutoffValue = 1.0f - GetPresetFloat(&rng, 0.6f);
+        } break;
+        case WAVE_PRESET_BLIP:
+        {
+            params->waveTypeValue = GetRandomValue(&rng, 0, 1);
+            if (params->waveTypeValue == 0) params->squareDutyValue = GetPresetFloat(&rng, 0.6f);
+
+            params->startFrequencyValue = 0.2f + GetPresetFloat(&rng, 0.4f);
+            params->attackTimeValue = 0.0f;
+            params->sustainTimeValue = 0.1f + GetPresetFloat(&rng, 0.1f);
+            params->decayTimeValue = GetPresetFloat(&rng, 0.2f);
+            params->hpfCutoffValue = 0.1f;
+        } break;
+        default: break;
+    }
+}
+
+// Get the name of a preset category, as used on the command line
+const char *GetWavePresetName(WavePreset preset)
+{
+    if ((preset < 0) || (preset >= WAVE_PRESET_COUNT)) return NULL;
+
+    return wavePresetNames[preset];
+}
+
+// Unload wave data generated by GenerateWave()
+void UnloadWave(Wave wave, const WaveAllocator *allocator)
+{
+	WaveFree(wave.data, allocator);
+}
+
+// Load .rfx (rFXGen) sound parameters file
+// NOTE: Returns NULL if the file could not be loaded
+WaveParams *LoadWaveParams(const char *fileName, const WaveAllocator *allocator)
+{
+	WaveParams *params = NULL;
+	FILE *rfxFile;
+	char signature[4];
+	unsigned short version, length;
+
+	rfxFile = fopen(fileName, "rb");
+	if (rfxFile == NULL)
+	{
+		fprintf(stderr, "[%s] rFX file could not be opened\n", fileName);
+		goto out;
+	}
+
+	// Fx Sound File Structure (.rfx)
+	// ------------------------------------------------------
+	// Offset | Size  | Type       | Description
+	// ------------------------------------------------------
+	// 0      | 4     | char       | Signature: "rFX "
+	// 4      | 2     | short      | Version: 200
+	// 6      | 2     | short      | Data length: 96 bytes
+	// 8      | 96    | WaveParams | Wave parameters
+	// ------------------------------------------------------
+
+	// Read .rfx file header
+	if (fread(signature, 4, sizeof(char), rfxFile) != sizeof(char) ||
+		strncmp(signature, "rFX ", 4) != 0)
+	{
+		fprintf(stderr, "[%s] rFX file does not seem to be valid\n", fileName);
+		goto close;
+	}
+
+	if (fread(&version, 1, sizeof(unsigned short), rfxFile) != sizeof(unsigned short) ||
+		fread(&length, 1, sizeof(unsigned short), rfxFile) != sizeof(unsigned short))
+	{
+		fprintf(stderr, "[%s] rFX file header is truncated\n", fileName);
+		goto close;
+	}
+
+	if (version != 200)
+	{
+		fprintf(stderr, "[%s] rFX file version not supported (%i)\n", fileName, version);
+		goto close;
+	}
+
+	if (length != sizeof(WaveParams))
+	{
+		fprintf(stderr, "[%s] Wrong rFX wave parameters size\n", fileName);
+		goto close;
+	}
+
+	params = WaveMalloc(sizeof(WaveParams), allocator);
+	if (params == NULL)
+		goto close;
+
+	// Load wave generation parameters
+	if (fread(params, 1, sizeof(WaveParams), rfxFile) != sizeof(WaveParams))
+	{
+		fprintf(stderr, "[%s] rFX wave parameters are truncated\n", fileName);
+		WaveFree(params, allocator);
+		params = NULL;
+	}
+
+close:
+	fclose(rfxFile);
+
+out:
+	return params;
+}
+
+// Unload wave parameters loaded by LoadWaveParams()
+void UnloadWaveParams(WaveParams *params, const WaveAllocator *allocator)
+{
+	WaveFree(params, allocator);
+}
+
+// Save wave parameters to .rfx (rFXGen) file, in the format read by LoadWaveParams()
+bool SaveWaveParams(const WaveParams *params, const char *fileName)
+{
+	FILE *rfxFile = fopen(fileName, "wb");
+	unsigned short version = 200;
+	unsigned short length = sizeof(WaveParams);
+	bool success;
+
+	if (rfxFile == NULL)
+	{
+		fprintf(stderr, "[%s] rFX file could not be created\n", fileName);
+		return false;
+	}
+
+	success = fwrite("rFX ", 1, 4, rfxFile) == 4 &&
+		fwrite(&version, sizeof(version), 1, rfxFile) == 1 &&
+		fwrite(&length, sizeof(length), 1, rfxFile) == 1 &&
+		fwrite(params, sizeof(WaveParams), 1, rfxFile) == 1;
+
+	if (fclose(rfxFile) != 0) success = false;
+
+	if (!success) fprintf(stderr, "[%s] rFX file could not be written\n", fileName);
+
+	return success;
+}
+
+// Perturb value by up to amount with a chance of one half, keeping it within [min..max]
+static float MutateWaveValue(WaveRandom *rng, float value, float amount, float min)
+{
+	if (GetRandomValue(rng, 0, 1) == 0) return value;
+
+	value += (float)GetRandomValue(rng, 0, 10000)/10000.0f*2.0f*amount - amount;
+
+	if (value < min) value = min;
+	if (value > 1.0f) value = 1.0f;
+
+	return value;
+}
+
+// Randomly perturb wave parameters, like the mutate button of sfxr and rFXGen
+// NOTE: Each parameter but the wave type, seed and minimum frequency changes with a chance of one half,
+// by up to amount (0.05 in rFXGen). The same seed always gives the same variation.
+void MutateWaveParams(WaveParams *params, float amount, unsigned int seed)
+{
+	WaveRandom rng;
+
+	SeedWaveRandom(&rng, seed);
+
+	params->startFrequencyValue = MutateWaveValue(&rng, params->startFrequencyValue, amount, 0.0f);
+	params->slideValue = MutateWaveValue(&rng, params->slideValue, amount, -1.0f);
+	params->deltaSlideValue = MutateWaveValue(&rng, params->deltaSlideValue, amount, -1.0f);
+	params->squareDutyValue = MutateWaveValue(&rng, params->squareDutyValue, amount, 0.0f);
+	params->dutySweepValue = MutateWaveValue(&rng, params->dutySweepValue, amount, -1.0f);
+	params->vibratoDepthValue = MutateWaveValue(&rng, params->vibratoDepthValue, amount, 0.0f);
+	params->vibratoSpeedValue = MutateWaveValue(&rng, params->vibratoSpeedValue, amount, 0.0f);
+	params->attackTimeValue = MutateWaveValue(&rng, params->attackTimeValue, amount, 0.0f);
+	params->sustainTimeValue = MutateWaveValue(&rng, params->sustainTimeValue, amount, 0.0f);
+	params->decayTimeValue = MutateWaveValue(&rng, params->decayTimeValue, amount, 0.0f);
+	params->sustainPunchValue = MutateWaveValue(&rng, params->sustainPunchValue, amount, 0.0f);
+	params->lpfResonanceValue = MutateWaveValue(&rng, params->lpfResonanceValue, amount, 0.0f);
+	params->lpfCutoffValue = MutateWaveValue(&rng, params->lpfCutoffValue, amount, 0.0f);
+	params->lpfCutoffSweepValue = MutateWaveValue(&rng, params->lpfCutoffSweepValue, amount, -1.0f);
+	params->hpfCutoffValue = MutateWaveValue(&rng, params->hpfCutoffValue, amount, 0.0f);
+	params->hpfCutoffSweepValue = MutateWaveValue(&rng, params->hpfCutoffSweepValue, amount, -1.0f);
+	params->phaserOffsetValue = MutateWaveValue(&rng, params->phaserOffsetValue, amount, -1.0f);
+	params->phaserSweepValue = MutateWaveValue(&rng, params->phaserSweepValue, amount, -1.0f);
+	params->repeatSpeedValue = MutateWaveValue(&rng, params->repeatSpeedValue, amount, 0.0f);
+	params->changeSpeedValue = MutateWaveValue(&rng, params->changeSpeedValue, amount, 0.0f);
+	params->changeAmountValue = MutateWaveValue(&rng, params->changeAmountValue, amount, -1.0f);
 }
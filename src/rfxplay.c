@@ -1,40 +1,1908 @@
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-#define DR_WAV_IMPLEMENTATION
 #include <dr_wav.h>
+#include <json.h>
 #include <rfxgen.h>
+#include <ring.h>
+#include <server.h>
+#include <thread.h>
+#include <trace.h>
+#include <watch.h>
 
-int main(int argc, char *argv[])
+/* Predicted render cost of a sample, in eighths of that of a square, sawtooth
+ * or noise wave without low-pass filter, and the extra cost of each feature
+ * that slows rendering down, as measured on x86-64. */
+#define COST_SAMPLE	8
+#define COST_SINE	4
+#define COST_VIBRATO	1
+#define COST_LPF	2
+
+/* Largest change of a parameter in a --mutate variation, as in rFXGen. */
+#define MUTATE_AMOUNT	0.05f
+
+/* Predicted cost of loading and writing a file, in rendered samples. */
+#define COST_FILE	4410
+
+/* Initial arena size; enough for the largest possible wave, its parameters and
+ * its overview. */
+#define JOB_ARENA_SIZE	(MAX_WAVE_LENGTH_SECONDS * WAVE_SAMPLE_RATE * sizeof(float) + \
+		sizeof(WaveOverview) + 4096)
+
+/* Frames converted at a time when writing a wave in another sample format or
+ * with gain applied. */
+#define CONVERT_FRAMES	4096
+
+/* Frames rendered at a time into a shared memory ring, about 12 ms. */
+#define RING_FRAMES	512
+
+/* Data area of a shared memory ring, about 0.37 s of 32 bit samples. */
+#define RING_CAPACITY	65536
+
+/* Time to wait for the consumer of a ring to make space or read the rest. */
+#define RING_TIMEOUT_MS	10000
+
+enum normalize
+{
+	NORMALIZE_NONE,
+	NORMALIZE_PEAK,
+	NORMALIZE_RMS
+};
+
+struct output_opts
+{
+	/* Bits per sample of the WAV file; 8, 16, 24 or 32 (float). */
+	unsigned int sample_size;
+	enum normalize normalize;
+	/* Target level in dBFS of the normalization. */
+	float target_db;
+	/* Write a waveform overview next to each WAV file. */
+	int overview;
+	/* Leave outputs whose contents would not change untouched, so that
+	 * their modification time only moves when they do. */
+	int restat;
+};
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: rfxplay [options] file.rfx out.wav\n"
+		"       rfxplay [options] --batch DIR file.rfx...\n"
+		"       rfxplay [options] --daemon SOCKET\n"
+		"       rfxplay [options] --shm NAME file.rfx\n"
+		"       rfxplay [options] [--batch DIR] --watch DIR\n"
+		"       rfxplay [options] --batch DIR --mutate N file.rfx\n"
+		"       rfxplay [options] --batch DIR --presets N [preset...]\n"
+		"       rfxplay --merge FILE stats.json...\n"
+		"Options:\n"
+		"  --batch DIR   Convert each file.rfx to DIR/file.wav\n"
+		"  --bits N      Write 8, 16 or 24 bit PCM, or 32 bit float (default)\n"
+		"  --daemon SOCKET\n"
+		"                Render effects requested on the Unix domain socket\n"
+		"                SOCKET until interrupted, see inc/server.h; --jobs sets\n"
+		"                the number of workers, at most 256\n"
+		"  --depfile FILE\n"
+		"                Write the input of each output to FILE as a Makefile\n"
+		"                rule, for make and the ninja depfile binding\n"
+		"  --kernel NAME Convert samples to PCM with kernel NAME (generic, sse4.2,\n"
+		"                avx2 or avx512) instead of the best one the CPU supports;\n"
+		"                the rendered samples are the same with every kernel\n"
+		"  --jobs N      Convert a batch on N threads, or one per processor if N\n"
+		"                is 0 (default 1), longest predicted render first\n"
+		"  --merge FILE  Merge the --stats files of every shard of a batch into\n"
+		"                FILE, or - for stdout, in input order\n"
+		"  --mutate N    Render N random variations of file.rfx, saving each as\n"
+		"                DIR/file-N.rfx and DIR/file-N.wav\n"
+		"  --normalize-peak DB\n"
+		"                Scale each wave so that its peak is at DB dBFS\n"
+		"  --normalize-rms DB\n"
+		"                Scale each wave so that its RMS level is at DB dBFS,\n"
+		"                without the peak exceeding 0 dBFS\n"
+		"  --overview    Write a min/max waveform overview of out.wav to out.wav.ovw\n"
+		"  --presets N   Render N random effects of each preset, or of pickup,\n"
+		"                laser, explosion, powerup, hit, jump and blip if none\n"
+		"                are given, saving each as DIR/preset-N.rfx and .wav;\n"
+		"                a preset may only be given once\n"
+		"  --profile     Print time spent in each generator stage to stderr; requires\n"
+		"                a build with ENABLE_PROFILE=1\n"
+		"  --restat      Leave an output untouched if its contents would not change,\n"
+		"                for make and the ninja restat binding\n"
+		"  --seed S      Seed variation N of --mutate or effect N of --presets\n"
+		"                with S + N, S from 0 to 4294967295 (default 1); only\n"
+		"                with one of those\n"
+		"  --shard I/N   Convert only part I, from 0 to N-1, of a batch split into\n"
+		"                N parts of similar predicted render time; every part\n"
+		"                must be given the same files in the same order\n"
+		"  --shm NAME    Stream the wave through the POSIX shared memory ring NAME\n"
+		"                while rendering it, for a player to consume, see\n"
+		"                inc/ring.h; not with normalization, --stats,\n"
+		"                --overview, --trace or --profile\n"
+		"  --stats FILE  Write statistics of each wave as JSON to FILE, or - for stdout\n"
+		"  --trace FILE  Write the time each worker spent loading, rendering,\n"
+		"                converting and writing each file to FILE, in Chrome\n"
+		"                trace event format\n"
+		"  --verbose     Print allocation counts after each conversion, and how\n"
+		"                long the batch took against the shortest possible\n"
+		"  --watch DIR   Convert each .rfx file in DIR whenever it is saved, to\n"
+		"                DIR/file.wav or the --batch directory, until interrupted\n");
+}
+
+/* Parses s as a whole number from 0 to max into value. Returns -1 if it is
+ * anything else, so that -1 is not taken for a huge number nor 12x for 12. */
+static int parse_count(const char *s, unsigned long max, unsigned long *value)
+{
+	char *end;
+
+	if(*s < '0' || *s > '9')
+		return -1;
+
+	errno = 0;
+	*value = strtoul(s, &end, 10);
+
+	return *end != '\0' || errno == ERANGE || *value > max ? -1 : 0;
+}
+
+/* Writes s as a JSON string. */
+static void json_string(FILE *f, const char *s)
+{
+	fputc('"', f);
+
+	for(; *s != '\0'; s++)
+	{
+		unsigned char c = (unsigned char)*s;
+
+		if(c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if(c < 0x20)
+			fprintf(f, "\\u%04x", c);
+		else
+			fputc(c, f);
+	}
+
+	fputc('"', f);
+}
+
+/* Writes a level in dBFS, or null for silence. */
+static void json_dbfs(FILE *f, double level)
+{
+	if(level > 0.0)
+		fprintf(f, "%.2f", 20.0 * log10(level));
+	else
+		fputs("null", f);
+}
+
+/* Writes the members of a JSON object describing wave statistics. */
+static void json_stats(FILE *f, const WaveStats *st)
+{
+	double n = st->sampleCount > 0 ? st->sampleCount : 1;
+	double rms = sqrt(st->sumSquares / n);
+
+	fprintf(f, "\"samples\": %u, \"peak\": %.9g, \"peak_dbfs\": ",
+		st->sampleCount, st->peak);
+	json_dbfs(f, st->peak);
+	fprintf(f, ", \"rms\": %.9g, \"rms_dbfs\": ", rms);
+	json_dbfs(f, rms);
+	fprintf(f, ", \"clipped\": %u, \"dc_offset\": %.9g, "
+		"\"checksum\": \"%016llx\"",
+		st->clipCount, st->sum / n, st->checksum);
+}
+
+/* Opens the statistics entry of the input n, converted to out, or that could
+ * not be converted if st is NULL. gain is the normalization gain, or NULL
+ * without normalization. The caller closes the object. */
+static void json_file(FILE *f, unsigned long n, const char *in,
+		const char *out, const WaveStats *st, const double *gain)
+{
+	fputs(n > 0 ? ",\n{" : "\n{", f);
+	fputs("\"input\": ", f);
+	json_string(f, in);
+
+	if(st == NULL)
+	{
+		fputs(", \"error\": true", f);
+		return;
+	}
+
+	fputs(", \"output\": ", f);
+	json_string(f, out);
+	fputs(", ", f);
+	json_stats(f, st);
+
+	if(gain != NULL)
+	{
+		fputs(", \"gain_db\": ", f);
+		json_dbfs(f, *gain);
+	}
+}
+
+/* Ends the list of files of a statistics file with the totals. */
+static void json_total(FILE *f, unsigned long converted, unsigned long failed,
+		const WaveStats *total)
+{
+	fprintf(f, "\n],\n\"total\": {\"converted\": %lu, "
+		"\"failed\": %lu, ", converted, failed);
+	json_stats(f, total);
+	fputs("}\n}\n", f);
+}
+
+/* Prints the share of time spent in each generator stage and the counts of
+ * events that affect it. */
+static void print_profile(const char *name, const WaveProfile *p)
+{
+	unsigned long long total = 0;
+	unsigned int s;
+
+	for(s = 0; s < WAVE_STAGE_COUNT; s++)
+		total += p->ticks[s];
+
+	fprintf(stderr, "%s: %llu samples", name, p->sampleCount);
+	if(total > 0 && p->sampleCount > 0)
+		fprintf(stderr, ", %.1f ticks/sample",
+			(double)total / (double)p->sampleCount);
+	fputc('\n', stderr);
+
+	for(s = 0; s < WAVE_STAGE_COUNT && total > 0; s++)
+	{
+		fprintf(stderr, "  %-12s %5.1f%% %12llu ticks\n",
+			GetWaveStageName((WaveStage)s),
+			100.0 * (double)p->ticks[s] / (double)total, p->ticks[s]);
+	}
+
+	fprintf(stderr, "  %llu period wraps, %llu noise refills, "
+		"%llu repeat resets, %llu arpeggio fires, %llu clamp hits\n",
+		p->periodWraps, p->noiseRefills, p->repeatResets,
+		p->arpeggioFires, p->clampHits);
+}
+
+/* A file to convert and the outcome of converting it. */
+struct job
+{
+	const char *in;
+	/* Parameters to render instead of those in the file in, or NULL. */
+	const WaveParams *params;
+	/* Position of the input on the command line, among those of all
+	 * shards. */
+	unsigned long index;
+	/* Predicted cost, see predict_cost(). */
+	unsigned long long cost;
+	/* Time taken to convert the file, in nanoseconds. */
+	unsigned long long elapsed;
+	/* Output path, or NULL to derive it from the batch directory. */
+	const char *out;
+	int ok;
+	WaveStats stats;
+	WaveProfile profile;
+	/* Gain applied by normalization. */
+	float gain;
+	/* With --restat, set if every output already had its new contents. */
+	int unchanged;
+	/* Arena counters of the worker after the job, for --verbose. */
+	unsigned long alloc_count;
+	unsigned long system_alloc_count;
+	size_t arena_peak;
+};
+
+struct batch
+{
+	struct job *jobs;
+	unsigned long count;
+	const char *dir;
+	const struct output_opts *opts;
+	int profile;
+	/* NULL unless --trace was given. */
+	struct trace *trace;
+	/* Jobs in the order to start them, or NULL for input order. */
+	struct job **order;
+	/* Index of the next job to start. */
+	unsigned long next;
+	struct mutex lock;
+};
+
+struct worker
+{
+	struct thread thread;
+	struct batch *batch;
+	/* Trace buffer of this worker, or NULL. */
+	struct trace_thread *tt;
+	WaveArena arena;
+};
+
+/* Writes the samples of a wave, converting them to the sample size of the
+ * file and applying gain in the same pass. Returns -1 if not every sample
+ * could be written. */
+static int write_samples(drwav *wav, const Wave *raw, unsigned int sample_size,
+		float gain, struct worker *w, const char *in)
+{
+	unsigned char chunk[CONVERT_FRAMES * 4];
+	const float *src = raw->data;
+	unsigned int done, n;
+
+	/* Generated samples are already in the right format. */
+	if(sample_size == raw->sampleSize && gain == 1.0f)
+	{
+		return drwav_write_pcm_frames(wav, raw->sampleCount, raw->data) ==
+			raw->sampleCount ? 0 : -1;
+	}
+
+	for(done = 0; done < raw->sampleCount; done += n)
+	{
+		unsigned long long t = trace_begin(w->tt);
+
+		n = raw->sampleCount - done;
+		if(n > CONVERT_FRAMES)
+			n = CONVERT_FRAMES;
+
+		ConvertWaveSamples(chunk, src + done, n, sample_size, gain);
+		trace_span(w->batch->trace, w->tt, "convert", in, t);
+
+		if(drwav_write_pcm_frames_le(wav, n, chunk) != n)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Write and seek callbacks of dr_wav for a file opened by the caller, so that
+ * errors flushing or closing it are seen, which drwav_uninit() ignores. */
+static size_t write_file(void *f, const void *data, size_t len)
+{
+	return fwrite(data, 1, len, f);
+}
+
+static drwav_bool32 seek_file(void *f, int offset, drwav_seek_origin origin)
+{
+	return fseek(f, offset, origin == drwav_seek_origin_current ?
+		SEEK_CUR : SEEK_SET) == 0;
+}
+
+/* Returns 1 if the files a and b have the same contents, 0 if not or if either
+ * cannot be read. */
+static int same_contents(const char *a, const char *b)
+{
+	unsigned char buf_a[8192], buf_b[8192];
+	FILE *fa = fopen(a, "rb");
+	FILE *fb = fopen(b, "rb");
+	int same = fa != NULL && fb != NULL;
+
+	while(same)
+	{
+		size_t na = fread(buf_a, 1, sizeof(buf_a), fa);
+		size_t nb = fread(buf_b, 1, sizeof(buf_b), fb);
+
+		same = na == nb && memcmp(buf_a, buf_b, na) == 0;
+		if(na < sizeof(buf_a))
+			break;
+	}
+
+	same = same && !ferror(fa) && !ferror(fb);
+
+	if(fa != NULL)
+		fclose(fa);
+
+	if(fb != NULL)
+		fclose(fb);
+
+	return same;
+}
+
+/* Returns the path an output is written to before it replaces out, or out
+ * itself unless opts->restat is set. Returns NULL if the path is too long. */
+static const char *output_path(char *buf, size_t len, const char *out,
+		const struct output_opts *opts)
+{
+	int n;
+
+	if(!opts->restat)
+		return out;
+
+	n = snprintf(buf, len, "%s.tmp", out);
+	if(n < 0 || (size_t)n >= len)
+		return NULL;
+
+	return buf;
+}
+
+/* Moves the output written to path over out, unless it has the same contents
+ * as out, in which case out and its modification time are left alone.
+ * Returns 1 if out changed, 0 if it did not and -1 on error. */
+static int replace_output(const char *path, const char *out)
+{
+	if(path == out)
+		return 1;
+
+	if(same_contents(path, out))
+	{
+		remove(path);
+		return 0;
+	}
+
+#ifdef _WIN32
+	/* rename() does not replace existing files on Windows. */
+	remove(out);
+#endif
+
+	if(rename(path, out) != 0)
+	{
+		perror(out);
+		remove(path);
+		return -1;
+	}
+
+	return 1;
+}
+
+/* Converts a single .rfx file to a WAV file, allocating only from the arena of
+ * the worker. */
+static int convert(struct worker *w, struct job *job, const char *out)
 {
-	if(argc != 3)
+	const struct output_opts *opts = w->batch->opts;
+	struct trace *trace = w->batch->trace;
+	WaveAllocator allocator = GetWaveArenaAllocator(&w->arena);
+	drwav_allocation_callbacks callbacks;
+	WaveOverview *overview = NULL;
+	WaveParams *wp;
+	Wave raw;
+	unsigned long long t;
+	int ret = EXIT_FAILURE;
+
+	callbacks.pUserData = allocator.userData;
+	callbacks.onMalloc = allocator.onMalloc;
+	callbacks.onRealloc = allocator.onRealloc;
+	callbacks.onFree = allocator.onFree;
+
+	t = trace_begin(w->tt);
+	if(job->params != NULL)
 	{
-		fprintf(stderr, "Usage: rfxplay file.sfx out.wav\n");
+		/* Copied, as rendering adjusts the parameters. */
+		wp = allocator.onMalloc(sizeof(*wp), allocator.userData);
+		if(wp != NULL)
+			*wp = *job->params;
+	}
+	else
+		wp = LoadWaveParams(job->in, &allocator);
+
+	trace_span(trace, w->tt, "load", job->in, t);
+	if(wp == NULL)
 		return EXIT_FAILURE;
+
+	if(opts->overview)
+	{
+		overview = allocator.onMalloc(sizeof(*overview), allocator.userData);
+		if(overview == NULL)
+		{
+			UnloadWaveParams(wp, &allocator);
+			return EXIT_FAILURE;
+		}
+	}
+
+	t = trace_begin(w->tt);
+	raw = GenerateWaveEx(wp, &allocator, &job->stats, overview,
+		w->batch->profile ? &job->profile : NULL);
+	trace_span(trace, w->tt, "render", job->in, t);
+
+	switch(opts->normalize)
+	{
+	case NORMALIZE_PEAK:
+		job->gain = GetWavePeakGain(&job->stats, opts->target_db);
+		break;
+
+	case NORMALIZE_RMS:
+		job->gain = GetWaveRmsGain(&job->stats, opts->target_db);
+		break;
+
+	default:
+		job->gain = 1.0f;
+		break;
 	}
 
-	WaveParams *wp = LoadWaveParams(argv[1]);
-	Wave raw = GenerateWave(wp);
+	job->unchanged = opts->restat;
 
 	/* Write WAV file. */
 	{
 		drwav_data_format format;
 		drwav wav;
+		char tmp[4096];
+		const char *path = output_path(tmp, sizeof(tmp), out, opts);
+		FILE *f = path != NULL ? fopen(path, "wb") : NULL;
+		int changed, failed;
 
 		format.container = drwav_container_riff;
-		format.format = DR_WAVE_FORMAT_IEEE_FLOAT;
+		format.format = opts->sample_size == 32 ?
+			DR_WAVE_FORMAT_IEEE_FLOAT : DR_WAVE_FORMAT_PCM;
 		format.channels = raw.channels;
 		format.sampleRate = WAVE_SAMPLE_RATE;
-		format.bitsPerSample = raw.sampleSize;
+		format.bitsPerSample = opts->sample_size;
+
+		t = trace_begin(w->tt);
 
-		if(drwav_init_file_write(&wav, argv[2], &format, NULL) != DRWAV_TRUE)
+		if(f == NULL || drwav_init_write(&wav, &format, write_file,
+			seek_file, f, &callbacks) != DRWAV_TRUE)
 		{
 			fprintf(stderr, "Error writing wav file.\n");
-			return EXIT_FAILURE;
+			if(f != NULL)
+			{
+				fclose(f);
+				remove(path);
+			}
+
+			goto out;
+		}
+
+		failed = write_samples(&wav, &raw, opts->sample_size, job->gain,
+			w, job->in) != 0;
+		failed |= drwav_uninit(&wav) != DRWAV_SUCCESS;
+		failed |= ferror(f) != 0;
+		failed |= fclose(f) != 0;
+
+		/* A partial file must not replace the previous output. */
+		if(failed)
+		{
+			fprintf(stderr, "Error writing wav file %s.\n", out);
+			remove(path);
+			goto out;
+		}
+
+		changed = replace_output(path, out);
+		if(changed < 0)
+			goto out;
+
+		job->unchanged &= !changed;
+		trace_span(trace, w->tt, "write", job->in, t);
+	}
+
+	if(overview != NULL)
+	{
+		char ovw[4096], tmp[4096];
+		const char *path = NULL;
+		int n = snprintf(ovw, sizeof(ovw), "%s.ovw", out);
+		int changed;
+
+		t = trace_begin(w->tt);
+
+		if(n > 0 && (size_t)n < sizeof(ovw))
+			path = output_path(tmp, sizeof(tmp), ovw, opts);
+
+		if(path == NULL ||
+			ExportWaveOverview(overview, job->gain, path) == false)
+		{
+			fprintf(stderr, "Error writing overview file.\n");
+			goto out;
+		}
+
+		changed = replace_output(path, ovw);
+		if(changed < 0)
+			goto out;
+
+		job->unchanged &= !changed;
+		trace_span(trace, w->tt, "overview", job->in, t);
+	}
+
+	ret = EXIT_SUCCESS;
+
+out:
+	UnloadWave(raw, &allocator);
+	allocator.onFree(overview, allocator.userData);
+	UnloadWaveParams(wp, &allocator);
+	return ret;
+}
+
+/* Renders a .rfx file block by block into the shared memory ring name, so that
+ * a player in another process can consume the first blocks while the rest is
+ * rendered. Waits for the player to read everything before removing the
+ * ring. */
+static int stream(const char *in, const char *name,
+		const struct output_opts *opts)
+{
+	float samples[RING_FRAMES];
+	unsigned char block[RING_FRAMES * 4];
+	WaveGenerator *gen;
+	WaveParams *wp;
+	struct ring ring;
+	unsigned int n;
+	size_t len;
+	int ok;
+
+	wp = LoadWaveParams(in, NULL);
+	if(wp == NULL)
+		return EXIT_FAILURE;
+
+	gen = LoadWaveGenerator(wp, NULL);
+	UnloadWaveParams(wp, NULL);
+
+	if(gen == NULL)
+	{
+		fprintf(stderr, "Unable to allocate memory.\n");
+		return EXIT_FAILURE;
+	}
+
+	if(ring_create(&ring, name, RING_CAPACITY, WAVE_SAMPLE_RATE, 1,
+		opts->sample_size) != 0)
+	{
+		UnloadWaveGenerator(gen, NULL);
+		return EXIT_FAILURE;
+	}
+
+	do
+	{
+		n = RenderWaveBlock(gen, samples, RING_FRAMES);
+		len = ConvertWaveSamples(block, samples, n, opts->sample_size,
+			1.0f);
+
+		if(ring_write(&ring, block, len, RING_TIMEOUT_MS) != len)
+		{
+			fprintf(stderr, "Timed out waiting for a reader of %s\n",
+				name);
+			ring_finish(&ring, RING_FAILED);
+			break;
+		}
+	} while(n == RING_FRAMES);
+
+	if(ring_state(&ring) == RING_STREAMING)
+	{
+		ring_finish(&ring, RING_FINISHED);
+
+		if(ring_wait_drained(&ring, RING_TIMEOUT_MS) != 0)
+		{
+			fprintf(stderr, "Timed out waiting for a reader of %s\n",
+				name);
+			ring_finish(&ring, RING_FAILED);
+		}
+	}
+
+	ok = ring_state(&ring) == RING_FINISHED;
+	ring_close(&ring);
+	UnloadWaveGenerator(gen, NULL);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Returns the file name of path without its directory and extension, whose
+ * length is stored in len. */
+static const char *file_stem(const char *path, int *len)
+{
+	const char *base = path;
+	const char *ext;
+	const char *p;
+
+	for(p = path; *p != '\0'; p++)
+	{
+		if(*p == '/' || *p == '\\')
+			base = p + 1;
+	}
+
+	ext = strrchr(base, '.');
+	if(ext == NULL)
+		ext = base + strlen(base);
+
+	*len = (int)(ext - base);
+	return base;
+}
+
+/* Builds DIR/name.wav from DIR and a path to name.rfx. Returns NULL if the
+ * resulting path is too long. */
+static const char *batch_out_path(char *buf, size_t len, const char *dir,
+		const char *in)
+{
+	int stem_len;
+	const char *stem = file_stem(in, &stem_len);
+	int n = snprintf(buf, len, "%s/%.*s.wav", dir, stem_len, stem);
+
+	if(n < 0 || (size_t)n >= len)
+		return NULL;
+
+	return buf;
+}
+
+/* Returns the number of digits of the numbers of count generated files. */
+static int generated_digits(unsigned long count)
+{
+	unsigned long limit;
+	int digits = 3;
+
+	for(limit = 1000; count > limit && digits < 10; limit *= 10)
+		digits++;
+
+	return digits;
+}
+
+/* Saves the parameters of each job of a batch of generated effects as the
+ * .rfx file it is named after, len bytes apart in names, so that the ones
+ * worth keeping can be edited further. Returns -1 on error. */
+static int save_generated(struct batch *b, const WaveParams *params,
+		char *names, size_t len)
+{
+	unsigned long n;
+
+	for(n = 0; n < b->count; n++)
+	{
+		char *name = names + n * len;
+
+		if(SaveWaveParams(&params[n], name) == false)
+			return -1;
+
+		b->jobs[n].in = name;
+		b->jobs[n].params = &params[n];
+		b->jobs[n].index = n;
+	}
+
+	return 0;
+}
+
+/* Sets up the jobs of the batch to render its count variations of the .rfx
+ * file in, numbered from 0 and saved as DIR/name-N.rfx next to their WAV
+ * files. Variation N is seeded with seed + N. The parameters and names of the
+ * variations are returned in params and names, for the caller to free.
+ * Returns -1 on error. Each variation is a job of its own, so that it gets the
+ * normalization, statistics and outputs of any other input;
+ * GenerateWaveVariations() renders them in memory instead. */
+static int mutate_batch(struct batch *b, const char *in, unsigned long seed,
+		WaveParams **params, char **names)
+{
+	WaveParams *base = LoadWaveParams(in, NULL);
+	int digits = generated_digits(b->count);
+	int stem_len;
+	const char *stem = file_stem(in, &stem_len);
+	/* DIR/name-N.rfx */
+	size_t len = strlen(b->dir) + (size_t)stem_len + (size_t)digits + 7;
+	unsigned long n;
+	int ret;
+
+	*params = NULL;
+	*names = NULL;
+
+	if(base == NULL)
+		return -1;
+
+	*params = malloc(b->count * sizeof(**params));
+	*names = malloc(b->count * len);
+
+	if(*params == NULL || *names == NULL)
+	{
+		fprintf(stderr, "Unable to allocate memory.\n");
+		UnloadWaveParams(base, NULL);
+		return -1;
+	}
+
+	for(n = 0; n < b->count; n++)
+	{
+		(*params)[n] = *base;
+		MutateWaveParams(&(*params)[n], MUTATE_AMOUNT,
+			(unsigned int)(seed + n));
+		snprintf(*names + n * len, len, "%s/%.*s-%0*lu.rfx", b->dir,
+			stem_len, stem, digits, n);
+	}
+
+	ret = save_generated(b, *params, *names, len);
+	UnloadWaveParams(base, NULL);
+	return ret;
+}
+
+/* Sets up the jobs of the batch to render count effects of each preset named
+ * in presets, or of every preset if there are none, saved as
+ * DIR/preset-N.rfx next to their WAV files. Effect N of every preset is
+ * seeded with seed + N. The parameters and names of the effects are returned
+ * in params and names, for the caller to free. Returns -1 on error, which
+ * includes a preset named twice, as its effects would be rendered twice to
+ * the same files. */
+static int preset_batch(struct batch *b, unsigned long count,
+		char *presets[], int preset_count, unsigned long seed,
+		WaveParams **params, char **names)
+{
+	int digits = generated_digits(count);
+	size_t longest = 0, len;
+	unsigned long n;
+	int i, j;
+
+	*params = NULL;
+	*names = NULL;
+
+	for(i = 0; i < preset_count; i++)
+	{
+		for(j = 0; j < i; j++)
+		{
+			if(strcmp(presets[i], presets[j]) == 0)
+			{
+				fprintf(stderr, "Preset %s is given more than once\n",
+					presets[i]);
+				return -1;
+			}
+		}
+	}
+
+	for(i = 0; i < WAVE_PRESET_COUNT; i++)
+	{
+		size_t name_len = strlen(GetWavePresetName((WavePreset)i));
+
+		if(name_len > longest)
+			longest = name_len;
+	}
+
+	/* DIR/preset-N.rfx */
+	len = strlen(b->dir) + longest + (size_t)digits + 7;
+
+	*params = malloc(b->count * sizeof(**params));
+	*names = malloc(b->count * len);
+
+	if(*params == NULL || *names == NULL)
+	{
+		fprintf(stderr, "Unable to allocate memory.\n");
+		return -1;
+	}
+
+	for(n = 0; n < b->count; n++)
+	{
+		WavePreset preset = (WavePreset)(n / count);
+
+		if(preset_count > 0)
+		{
+			for(i = 0; i < WAVE_PRESET_COUNT; i++)
+			{
+				if(strcmp(presets[n / count],
+					GetWavePresetName((WavePreset)i)) == 0)
+					break;
+			}
+
+			if(i == WAVE_PRESET_COUNT)
+			{
+				fprintf(stderr, "Unknown preset %s\n",
+					presets[n / count]);
+				return -1;
+			}
+
+			preset = (WavePreset)i;
 		}
 
-		drwav_write_pcm_frames(&wav, raw.sampleCount, raw.data);
-		drwav_uninit(&wav);
+		GenerateWavePreset(&(*params)[n], preset,
+			(unsigned int)(seed + n % count));
+		snprintf(*names + n * len, len, "%s/%s-%0*lu.rfx", b->dir,
+			GetWavePresetName(preset), digits, n % count);
 	}
 
-	return EXIT_SUCCESS;
+	return save_generated(b, *params, *names, len);
+}
+
+/* Writes a path to a depfile, escaping the characters that make and ninja
+ * treat specially as GCC does: spaces and '#' get a backslash, doubling any
+ * backslashes before them, and '$' is doubled. Make and ninja disagree on
+ * escaped colons and neither can escape a newline, so paths with either are
+ * refused, apart from a drive letter. Returns 0 on success. */
+static int dep_path(FILE *f, const char *path)
+{
+	const char *s;
+
+	for(s = path; *s != '\0'; s++)
+	{
+		int drive = s == path + 1 && ((path[0] >= 'A' && path[0] <= 'Z') ||
+			(path[0] >= 'a' && path[0] <= 'z')) &&
+			(s[1] == '/' || s[1] == '\\');
+
+		if((*s == ':' && !drive) || *s == '\n' || *s == '\r')
+		{
+			fprintf(stderr, "Path %s cannot be written to a depfile\n",
+				path);
+			return -1;
+		}
+	}
+
+	for(s = path; *s != '\0'; s++)
+	{
+		if(*s == '\\')
+		{
+			const char *end = s;
+
+			while(*end == '\\')
+				end++;
+
+			/* Backslashes only escape a following space or '#'. */
+			if(*end == ' ' || *end == '#')
+				fwrite(s, 1, (size_t)(end - s), f);
+
+			fwrite(s, 1, (size_t)(end - s), f);
+			s = end - 1;
+			continue;
+		}
+
+		if(*s == ' ' || *s == '#')
+			fputc('\\', f);
+		else if(*s == '$')
+			fputc('$', f);
+
+		fputc(*s, f);
+	}
+
+	return 0;
+}
+
+/* Writes a Makefile rule for each converted file of the batch, naming its
+ * outputs as targets and the .rfx file as their prerequisite. Returns 0 on
+ * success. */
+static int write_depfile(const char *path, const struct batch *b)
+{
+	FILE *f = fopen(path, "w");
+	unsigned long n;
+
+	if(f == NULL)
+		return -1;
+
+	for(n = 0; n < b->count; n++)
+	{
+		const struct job *job = &b->jobs[n];
+		char buf[4096];
+		const char *out = job->out;
+
+		if(!job->ok)
+			continue;
+
+		if(out == NULL)
+			out = batch_out_path(buf, sizeof(buf), b->dir, job->in);
+
+		if(dep_path(f, out) != 0)
+			break;
+
+		if(b->opts->overview)
+		{
+			fputc(' ', f);
+			dep_path(f, out);
+			fputs(".ovw", f);
+		}
+
+		fputs(": ", f);
+		if(dep_path(f, job->in) != 0)
+			break;
+
+		fputc('\n', f);
+	}
+
+	return (fclose(f) == 0 && n == b->count) ? 0 : -1;
+}
+
+/* Converts a file saved in a watched directory. */
+static void watch_changed(const char *path, void *arg)
+{
+	struct worker *w = arg;
+	unsigned long long t = trace_now();
+	char buf[4096];
+	const char *out;
+	struct job job;
+
+	memset(&job, 0, sizeof(job));
+	job.in = path;
+	out = batch_out_path(buf, sizeof(buf), w->batch->dir, path);
+
+	if(out == NULL || convert(w, &job, out) != EXIT_SUCCESS)
+		fprintf(stderr, "Unable to convert %s\n", path);
+	else
+	{
+		fprintf(stderr, "%s: %s%.2f ms\n", out,
+			job.unchanged ? "unchanged, " : "",
+			(trace_now() - t) / 1e6);
+	}
+
+	ResetWaveArena(&w->arena);
+}
+
+/* Converts .rfx files saved in dir to WAV files in out_dir until interrupted,
+ * with a single worker whose arena is reused for every file. Returns -1 if
+ * dir cannot be watched. */
+static int watch(const char *dir, const char *out_dir,
+		const struct output_opts *opts)
+{
+	struct batch b;
+	struct worker w;
+	int ret;
+
+	memset(&b, 0, sizeof(b));
+	memset(&w, 0, sizeof(w));
+	b.dir = out_dir;
+	b.opts = opts;
+	w.batch = &b;
+
+	if(InitWaveArena(&w.arena, JOB_ARENA_SIZE) == false)
+	{
+		fprintf(stderr, "Unable to allocate memory.\n");
+		return -1;
+	}
+
+	fprintf(stderr, "Watching %s\n", dir);
+	ret = watch_run(dir, ".rfx", watch_changed, &w);
+	FreeWaveArena(&w.arena);
+	return ret;
+}
+
+/* Returns the predicted cost of converting a job, in samples of the cheapest
+ * kind. */
+static unsigned long long predict_cost(const struct job *job)
+{
+	WaveParams *wp = job->params != NULL ? NULL :
+		LoadWaveParams(job->in, NULL);
+	const WaveParams *p = job->params != NULL ? job->params : wp;
+	unsigned long long cost = COST_FILE;
+	unsigned int sample_cost = COST_SAMPLE;
+
+	if(p == NULL)
+		return cost;
+
+	/* Each sample takes eight sinf() calls. */
+	if(p->waveTypeValue == 2)
+		sample_cost += COST_SINE;
+
+	if(p->vibratoDepthValue > 0.0f)
+		sample_cost += COST_VIBRATO;
+
+	if(p->lpfCutoffValue != 1.0f)
+		sample_cost += COST_LPF;
+
+	cost += (unsigned long long)GetWaveSampleCount(p) * sample_cost /
+		COST_SAMPLE;
+	UnloadWaveParams(wp, NULL);
+	return cost;
+}
+
+/* Orders jobs by descending cost, then by input path and position, so that
+ * every shard of a batch sorts them the same way. */
+static int compare_jobs(const void *a, const void *b)
+{
+	const struct job *x = *(struct job *const *)a;
+	const struct job *y = *(struct job *const *)b;
+	int c;
+
+	if(x->cost != y->cost)
+		return x->cost < y->cost ? 1 : -1;
+
+	c = strcmp(x->in, y->in);
+	if(c != 0)
+		return c;
+
+	return x->index < y->index ? -1 : x->index > y->index;
+}
+
+/* Returns the jobs of the batch, most expensive first, or NULL if memory could
+ * not be allocated. Starting those first keeps a long render from starting
+ * last and finishing long after the other workers have run out of jobs. */
+static struct job **sort_jobs(const struct batch *b)
+{
+	struct job **order = malloc(b->count * sizeof(*order));
+	unsigned long n;
+
+	if(order == NULL)
+		return NULL;
+
+	for(n = 0; n < b->count; n++)
+		order[n] = &b->jobs[n];
+
+	qsort(order, b->count, sizeof(*order), compare_jobs);
+	return order;
+}
+
+/* Converts jobs of the batch until there are none left. */
+static void worker_main(void *arg)
+{
+	struct worker *w = arg;
+	struct batch *b = w->batch;
+
+	for(;;)
+	{
+		char path[4096];
+		const char *out;
+		struct job *job;
+		unsigned long long t;
+
+		mutex_lock(&b->lock);
+		if(b->next < b->count)
+			job = b->order != NULL ? b->order[b->next] : &b->jobs[b->next];
+		else
+			job = NULL;
+
+		b->next++;
+		mutex_unlock(&b->lock);
+
+		if(job == NULL)
+			break;
+
+		job->elapsed = trace_now();
+		t = trace_begin(w->tt);
+		out = job->out;
+		if(out == NULL)
+			out = batch_out_path(path, sizeof(path), b->dir, job->in);
+
+		job->ok = out != NULL && convert(w, job, out) == EXIT_SUCCESS;
+		if(!job->ok)
+			fprintf(stderr, "Unable to convert %s\n", job->in);
+
+		job->alloc_count = w->arena.allocCount;
+		job->system_alloc_count = w->arena.systemAllocCount;
+		job->arena_peak = w->arena.peak;
+		ResetWaveArena(&w->arena);
+		trace_span(b->trace, w->tt, "file", job->in, t);
+		job->elapsed = trace_now() - job->elapsed;
+	}
+}
+
+/* Converts every job of the batch on worker_count workers. The calling thread
+ * is the first worker. Returns the number of workers that could be started. */
+static unsigned int run_batch(struct batch *b, unsigned int worker_count)
+{
+	struct worker *workers = calloc(worker_count, sizeof(*workers));
+	unsigned int started = 0, i;
+
+	if(workers == NULL || mutex_init(&b->lock) != 0)
+	{
+		free(workers);
+		return 0;
+	}
+
+	for(i = 0; i < worker_count; i++)
+	{
+		struct worker *w = &workers[started];
+
+		w->batch = b;
+		w->tt = b->trace != NULL ? &b->trace->threads[started] : NULL;
+
+		if(InitWaveArena(&w->arena, JOB_ARENA_SIZE) == false)
+			break;
+
+		if(started > 0 && thread_start(&w->thread, worker_main, w) != 0)
+		{
+			FreeWaveArena(&w->arena);
+			break;
+		}
+
+		started++;
+	}
+
+	if(started > 0)
+		worker_main(&workers[0]);
+
+	for(i = 0; i < started; i++)
+	{
+		if(i > 0)
+			thread_join(&workers[i].thread);
+
+		FreeWaveArena(&workers[i].arena);
+	}
+
+	mutex_free(&b->lock);
+	free(workers);
+	return started;
+}
+
+/* Prints the time workers took to convert the whole batch, and how far it is
+ * from the shortest possible: the time of the longest job, or the time of all
+ * jobs spread evenly over the workers, whichever is longer. */
+static void print_makespan(const struct batch *b, unsigned int workers,
+		unsigned long long makespan)
+{
+	unsigned long long sum = 0, longest = 0, bound;
+	unsigned long n;
+
+	for(n = 0; n < b->count; n++)
+	{
+		sum += b->jobs[n].elapsed;
+		if(b->jobs[n].elapsed > longest)
+			longest = b->jobs[n].elapsed;
+	}
+
+	bound = sum / workers;
+	if(bound < longest)
+		bound = longest;
+
+	fprintf(stderr, "Makespan %.2f ms on %u workers, lower bound %.2f ms "
+		"(%+.1f%%)\n", makespan / 1e6, workers, bound / 1e6,
+		bound > 0 ? 100.0 * ((double)makespan - bound) / bound : 0.0);
+}
+
+/* Part of a batch converted by this process, see --shard. */
+struct shard
+{
+	unsigned int index;
+	/* Number of shards, or 0 if the batch is not sharded. */
+	unsigned int count;
+};
+
+/* Keeps only the jobs of the batch that belong to shard s. Every shard
+ * predicts the cost of every input and deals the inputs out, most expensive
+ * first, to the shard with the least cost so far. The result only depends on
+ * the inputs, so shards agree on it without talking to each other. Returns -1
+ * if memory could not be allocated. */
+static int shard_batch(struct batch *b, const struct shard *s, int verbose)
+{
+	struct job **order = sort_jobs(b);
+	unsigned long long *load = calloc(s->count, sizeof(*load));
+	unsigned char *mine = calloc(b->count, 1);
+	unsigned long long total = 0;
+	unsigned long n, kept = 0;
+
+	if(order == NULL || load == NULL || mine == NULL)
+	{
+		free(order);
+		free(load);
+		free(mine);
+		return -1;
+	}
+
+	for(n = 0; n < b->count; n++)
+	{
+		unsigned int least = 0, k;
+
+		for(k = 1; k < s->count; k++)
+		{
+			if(load[k] < load[least])
+				least = k;
+		}
+
+		load[least] += order[n]->cost;
+		total += order[n]->cost;
+		if(least == s->index)
+			mine[order[n] - b->jobs] = 1;
+	}
+
+	for(n = 0; n < b->count; n++)
+	{
+		if(mine[n])
+			b->jobs[kept++] = b->jobs[n];
+	}
+
+	if(verbose)
+	{
+		fprintf(stderr, "Shard %u/%u: %lu of %lu files, predicted cost "
+			"%llu of %llu\n", s->index, s->count, kept, b->count,
+			load[s->index], total);
+	}
+
+	b->count = kept;
+	free(order);
+	free(load);
+	free(mine);
+	return 0;
+}
+
+/* Reads the statistics of a file entry written with --shard. Returns -1 if a
+ * member is missing. */
+static int json_read_stats(const struct json *entry, WaveStats *st)
+{
+	const struct json *samples = json_get(entry, "samples");
+	const struct json *peak = json_get(entry, "peak");
+	const struct json *clipped = json_get(entry, "clipped");
+	const struct json *sum = json_get(entry, "sum");
+	const struct json *sum_squares = json_get(entry, "sum_squares");
+	const struct json *checksum = json_get(entry, "checksum");
+
+	if(samples == NULL || samples->type != JSON_NUMBER ||
+		peak == NULL || peak->type != JSON_NUMBER ||
+		clipped == NULL || clipped->type != JSON_NUMBER ||
+		sum == NULL || sum->type != JSON_NUMBER ||
+		sum_squares == NULL || sum_squares->type != JSON_NUMBER ||
+		checksum == NULL || checksum->type != JSON_STRING)
+		return -1;
+
+	st->sampleCount = (unsigned int)samples->number;
+	st->peak = (float)peak->number;
+	st->clipCount = (unsigned int)clipped->number;
+	st->sum = sum->number;
+	st->sumSquares = sum_squares->number;
+	st->checksum = strtoull(checksum->string, NULL, 16);
+	return 0;
+}
+
+/* Returns the number member key of obj, or -1 if there is none. */
+static double json_number(const struct json *obj, const char *key)
+{
+	const struct json *j = json_get(obj, key);
+
+	return j != NULL && j->type == JSON_NUMBER ? j->number : -1.0;
+}
+
+/* Returns the number member key of obj if it is a whole number that fits an
+ * unsigned long, or -1 otherwise, so that 1.5 is not taken for 1. */
+static double json_count(const struct json *obj, const char *key)
+{
+	double x = json_number(obj, key);
+
+	return x >= 0.0 && x == floor(x) && x < 4294967296.0 ? x : -1.0;
+}
+
+/* Merges the statistics files written by every shard of a batch into path, or
+ * stdout if path is -, as a single process converting the whole batch would
+ * have written it. */
+static int merge_stats(const char *path, int count, char *files[])
+{
+	struct json **docs = calloc((size_t)count, sizeof(*docs));
+	const struct json **entries = NULL;
+	unsigned char *seen = calloc((size_t)count, 1);
+	unsigned long inputs = 0, converted = 0, failed = 0, n;
+	WaveStats total;
+	FILE *f = NULL;
+	int ret = EXIT_FAILURE;
+	int i;
+
+	if(docs == NULL || seen == NULL)
+	{
+		fprintf(stderr, "Unable to allocate memory.\n");
+		goto out;
+	}
+
+	for(i = 0; i < count; i++)
+	{
+		const struct json *shard, *e;
+		double index, shards, total_inputs;
+
+		docs[i] = json_load(files[i]);
+		shard = docs[i] != NULL ? json_get(docs[i], "shard") : NULL;
+		e = shard != NULL ? json_get(docs[i], "files") : NULL;
+
+		if(e == NULL || e->type != JSON_ARRAY)
+		{
+			fprintf(stderr, "%s is not the statistics of a shard\n",
+				files[i]);
+			goto out;
+		}
+
+		index = json_count(shard, "index");
+		shards = json_count(shard, "count");
+		total_inputs = json_count(shard, "inputs");
+
+		if(index < 0.0 || shards < 0.0 || total_inputs < 0.0)
+		{
+			fprintf(stderr, "%s has a shard index, count or number of "
+				"inputs that is not a whole number\n", files[i]);
+			goto out;
+		}
+
+		if(i == 0)
+		{
+			inputs = (unsigned long)total_inputs;
+			entries = calloc(inputs > 0 ? inputs : 1,
+				sizeof(*entries));
+			if(entries == NULL)
+			{
+				fprintf(stderr, "Unable to allocate memory.\n");
+				goto out;
+			}
+		}
+
+		if(shards != count)
+		{
+			fprintf(stderr, "%s is one of %g shards, but %d files were "
+				"given\n", files[i], shards, count);
+			goto out;
+		}
+
+		if(total_inputs != inputs || index < 0 || index >= shards ||
+			seen[(int)index])
+		{
+			fprintf(stderr, "%s is a repeated shard or from another "
+				"batch than %s\n", files[i], files[0]);
+			goto out;
+		}
+
+		seen[(int)index] = 1;
+
+		for(e = e->child; e != NULL; e = e->next)
+		{
+			double k = json_count(e, "index");
+
+			if(k < 0 || k >= inputs || entries[(unsigned long)k])
+			{
+				fprintf(stderr, "%s: bad or repeated input "
+					"index\n", files[i]);
+				goto out;
+			}
+
+			entries[(unsigned long)k] = e;
+		}
+	}
+
+	for(n = 0; n < inputs; n++)
+	{
+		if(entries[n] == NULL)
+		{
+			fprintf(stderr, "No shard converted input %lu\n", n);
+			goto out;
+		}
+	}
+
+	f = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+	if(f == NULL)
+	{
+		fprintf(stderr, "Unable to open %s\n", path);
+		goto out;
+	}
+
+	ResetWaveStats(&total);
+	fputs("{\n\"files\": [", f);
+
+	for(n = 0; n < inputs; n++)
+	{
+		const struct json *in = json_get(entries[n], "input");
+		const struct json *out = json_get(entries[n], "output");
+		const struct json *gain_db = json_get(entries[n], "gain_db");
+		double gain = 0.0;
+		WaveStats st;
+
+		if(in == NULL || in->type != JSON_STRING)
+		{
+			fprintf(stderr, "Input %lu has no name\n", n);
+			goto out;
+		}
+
+		if(out == NULL || out->type != JSON_STRING ||
+			json_read_stats(entries[n], &st) != 0)
+		{
+			json_file(f, n, in->string, NULL, NULL, NULL);
+			fputc('}', f);
+			failed++;
+			continue;
+		}
+
+		if(gain_db != NULL && gain_db->type == JSON_NUMBER)
+			gain = pow(10.0, gain_db->number / 20.0);
+
+		json_file(f, n, in->string, out->string, &st,
+			gain_db != NULL ? &gain : NULL);
+		fputc('}', f);
+		MergeWaveStats(&total, &st);
+		converted++;
+	}
+
+	json_total(f, converted, failed, &total);
+	ret = EXIT_SUCCESS;
+
+out:
+	if(f != NULL && f != stdout && fclose(f) != 0)
+		ret = EXIT_FAILURE;
+
+	for(i = 0; docs != NULL && i < count; i++)
+		json_free(docs[i]);
+
+	free(docs);
+	free(entries);
+	free(seen);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *batch_dir = NULL;
+	const char *daemon_path = NULL;
+	const char *shm_name = NULL;
+	const char *watch_dir = NULL;
+	const char *stats_path = NULL;
+	const char *trace_path = NULL;
+	const char *depfile_path = NULL;
+	const char *merge_path = NULL;
+	const char *kernel = NULL;
+	struct output_opts opts = { 32, NORMALIZE_NONE, 0.0f, 0, 0 };
+	FILE *stats_file = NULL;
+	WaveStats total;
+	WaveProfile profile_total;
+	struct trace trace;
+	struct batch batch;
+	struct shard shard = { 0, 0 };
+	/* Parameters and names of effects made by --mutate or --presets. */
+	WaveParams *generated = NULL;
+	char *generated_names = NULL;
+	unsigned long mutate_count = 0, preset_count = 0, seed = 1;
+	unsigned long converted = 0, failed = 0, n;
+	unsigned long long start;
+	unsigned int jobs = 1, workers;
+	int verbose = 0, profile = 0, seeded = 0, usage_ok;
+	int ret = EXIT_SUCCESS;
+	int i;
+
+	for(i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++)
+	{
+		if(strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+			batch_dir = argv[++i];
+		else if(strcmp(argv[i], "--bits") == 0 && i + 1 < argc)
+		{
+			opts.sample_size = (unsigned int)atoi(argv[++i]);
+
+			if(opts.sample_size != 8 && opts.sample_size != 16 &&
+				opts.sample_size != 24 && opts.sample_size != 32)
+			{
+				usage();
+				return EXIT_FAILURE;
+			}
+		}
+		else if(strcmp(argv[i], "--daemon") == 0 && i + 1 < argc)
+			daemon_path = argv[++i];
+		else if(strcmp(argv[i], "--depfile") == 0 && i + 1 < argc)
+			depfile_path = argv[++i];
+		else if(strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+		{
+			unsigned long count;
+
+			if(parse_count(argv[++i], UINT_MAX, &count) != 0)
+			{
+				usage();
+				return EXIT_FAILURE;
+			}
+
+			jobs = count > 0 ? (unsigned int)count : thread_cpu_count();
+		}
+		else if(strcmp(argv[i], "--kernel") == 0 && i + 1 < argc)
+			kernel = argv[++i];
+		else if(strcmp(argv[i], "--merge") == 0 && i + 1 < argc)
+			merge_path = argv[++i];
+		else if(strcmp(argv[i], "--mutate") == 0 && i + 1 < argc)
+		{
+			if(parse_count(argv[++i], ULONG_MAX, &mutate_count) != 0 ||
+				mutate_count == 0)
+			{
+				usage();
+				return EXIT_FAILURE;
+			}
+		}
+		else if(strcmp(argv[i], "--normalize-peak") == 0 && i + 1 < argc)
+		{
+			opts.normalize = NORMALIZE_PEAK;
+			opts.target_db = (float)atof(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--normalize-rms") == 0 && i + 1 < argc)
+		{
+			opts.normalize = NORMALIZE_RMS;
+			opts.target_db = (float)atof(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--overview") == 0)
+			opts.overview = 1;
+		else if(strcmp(argv[i], "--presets") == 0 && i + 1 < argc)
+		{
+			if(parse_count(argv[++i], ULONG_MAX, &preset_count) != 0 ||
+				preset_count == 0)
+			{
+				usage();
+				return EXIT_FAILURE;
+			}
+		}
+		else if(strcmp(argv[i], "--profile") == 0)
+			profile = 1;
+		else if(strcmp(argv[i], "--restat") == 0)
+			opts.restat = 1;
+		else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+		{
+			if(parse_count(argv[++i], UINT_MAX, &seed) != 0)
+			{
+				usage();
+				return EXIT_FAILURE;
+			}
+			seeded = 1;
+		}
+		else if(strcmp(argv[i], "--shard") == 0 && i + 1 < argc)
+		{
+			char end;
+
+			if(sscanf(argv[++i], "%u/%u%c", &shard.index,
+				&shard.count, &end) != 2 ||
+				shard.index >= shard.count)
+			{
+				usage();
+				return EXIT_FAILURE;
+			}
+		}
+		else if(strcmp(argv[i], "--shm") == 0 && i + 1 < argc)
+			shm_name = argv[++i];
+		else if(strcmp(argv[i], "--stats") == 0 && i + 1 < argc)
+			stats_path = argv[++i];
+		else if(strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			trace_path = argv[++i];
+		else if(strcmp(argv[i], "--verbose") == 0)
+			verbose = 1;
+		else if(strcmp(argv[i], "--watch") == 0 && i + 1 < argc)
+			watch_dir = argv[++i];
+		else
+		{
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* Inputs each mode takes. */
+	if(seeded && mutate_count == 0 && preset_count == 0)
+		usage_ok = 0;
+	else if(merge_path != NULL)
+	{
+		usage_ok = argc - i >= 1 && batch_dir == NULL &&
+			daemon_path == NULL && shm_name == NULL &&
+			watch_dir == NULL;
+	}
+	else if(shard.count > 0 && batch_dir == NULL)
+		usage_ok = 0;
+	else if(mutate_count > 0 || preset_count > 0)
+	{
+		usage_ok = (mutate_count == 0 || argc - i == 1) &&
+			(mutate_count == 0 || preset_count == 0) &&
+			batch_dir != NULL && shard.count == 0 &&
+			daemon_path == NULL && shm_name == NULL &&
+			watch_dir == NULL;
+	}
+	else if(daemon_path != NULL)
+	{
+		usage_ok = argc == i && batch_dir == NULL && shm_name == NULL &&
+			watch_dir == NULL && depfile_path == NULL && !opts.restat;
+	}
+	else if(watch_dir != NULL)
+		usage_ok = argc == i && shm_name == NULL && depfile_path == NULL;
+	else if(shm_name != NULL)
+	{
+		usage_ok = argc - i == 1 && batch_dir == NULL &&
+			opts.normalize == NORMALIZE_NONE && depfile_path == NULL &&
+			!opts.restat && stats_path == NULL && !opts.overview &&
+			trace_path == NULL && !profile;
+	}
+	else if(batch_dir != NULL)
+		usage_ok = argc - i >= 1;
+	else
+		usage_ok = argc - i == 2;
+
+	if(!usage_ok)
+	{
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	if(merge_path != NULL)
+		return merge_stats(merge_path, argc - i, argv + i);
+
+	if(profile && IsWaveProfileEnabled() == false)
+	{
+		fprintf(stderr, "--profile requires a build with ENABLE_PROFILE=1\n");
+		return EXIT_FAILURE;
+	}
+
+	if(kernel != NULL && SetWaveKernel(kernel) == false)
+	{
+		fprintf(stderr, "Render kernel %s is not supported\n", kernel);
+		return EXIT_FAILURE;
+	}
+
+	kernel = GetActiveWaveKernel();
+	if(verbose)
+		fprintf(stderr, "Rendering with the %s kernel\n", kernel);
+
+	if(daemon_path != NULL)
+	{
+		return server_run(daemon_path, jobs, verbose) == 0 ?
+			EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if(shm_name != NULL)
+		return stream(argv[i], shm_name, &opts);
+
+	if(watch_dir != NULL)
+	{
+		return watch(watch_dir, batch_dir != NULL ? batch_dir : watch_dir,
+			&opts) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if(stats_path != NULL)
+	{
+		if(strcmp(stats_path, "-") == 0)
+			stats_file = stdout;
+		else
+			stats_file = fopen(stats_path, "w");
+
+		if(stats_file == NULL)
+		{
+			fprintf(stderr, "Unable to open %s\n", stats_path);
+			return EXIT_FAILURE;
+		}
+
+		fputs("{\n", stats_file);
+		if(shard.count > 0)
+		{
+			fprintf(stats_file, "\"shard\": {\"index\": %u, "
+				"\"count\": %u, \"inputs\": %d},\n", shard.index,
+				shard.count, argc - i);
+		}
+
+		fputs("\"files\": [", stats_file);
+	}
+
+	memset(&batch, 0, sizeof(batch));
+	if(mutate_count > 0)
+		batch.count = mutate_count;
+	else if(preset_count > 0)
+	{
+		batch.count = preset_count * (unsigned long)(argc > i ?
+			argc - i : WAVE_PRESET_COUNT);
+	}
+	else
+		batch.count = batch_dir != NULL ? (unsigned long)(argc - i) : 1;
+
+	batch.jobs = calloc(batch.count, sizeof(*batch.jobs));
+	batch.dir = batch_dir;
+	batch.opts = &opts;
+	batch.profile = profile;
+
+	if(batch.jobs == NULL)
+	{
+		fprintf(stderr, "Unable to allocate memory.\n");
+		ret = EXIT_FAILURE;
+		goto out;
+	}
+
+	if(mutate_count > 0)
+	{
+		if(mutate_batch(&batch, argv[i], seed, &generated,
+			&generated_names) != 0)
+		{
+			ret = EXIT_FAILURE;
+			goto out;
+		}
+	}
+	else if(preset_count > 0)
+	{
+		if(preset_batch(&batch, preset_count, argv + i, argc - i, seed,
+			&generated, &generated_names) != 0)
+		{
+			ret = EXIT_FAILURE;
+			goto out;
+		}
+	}
+	else
+	{
+		for(n = 0; n < batch.count; n++)
+		{
+			batch.jobs[n].in = argv[i + (int)n];
+			batch.jobs[n].index = n;
+		}
+	}
+
+	if(batch_dir == NULL)
+		batch.jobs[0].out = argv[i + 1];
+
+	/* Only sharding and scheduling across workers need costs. */
+	if(shard.count > 0 || jobs > 1)
+	{
+		for(n = 0; n < batch.count; n++)
+			batch.jobs[n].cost = predict_cost(&batch.jobs[n]);
+	}
+
+	if(shard.count > 0 && shard_batch(&batch, &shard, verbose) != 0)
+	{
+		fprintf(stderr, "Unable to allocate memory.\n");
+		ret = EXIT_FAILURE;
+		goto out;
+	}
+
+	if(jobs > batch.count && batch.count > 0)
+		jobs = (unsigned int)batch.count;
+
+	if(jobs > 1)
+	{
+		batch.order = sort_jobs(&batch);
+		if(batch.order == NULL)
+		{
+			fprintf(stderr, "Unable to allocate memory.\n");
+			ret = EXIT_FAILURE;
+			goto out;
+		}
+	}
+
+	if(trace_path != NULL)
+	{
+		if(trace_init(&trace, jobs) != 0)
+		{
+			fprintf(stderr, "Unable to allocate memory.\n");
+			trace_path = NULL;
+			ret = EXIT_FAILURE;
+			goto out;
+		}
+
+		batch.trace = &trace;
+	}
+
+	start = trace_now();
+	workers = batch.count > 0 ? run_batch(&batch, jobs) : 1;
+	if(workers == 0)
+	{
+		fprintf(stderr, "Unable to allocate memory.\n");
+		ret = EXIT_FAILURE;
+		goto out;
+	}
+
+	if(verbose && batch.count > 0)
+		print_makespan(&batch, workers, trace_now() - start);
+
+	ResetWaveStats(&total);
+	ResetWaveProfile(&profile_total);
+
+	/* Results are reported in input order, whichever worker produced
+	 * them. */
+	for(n = 0; n < batch.count; n++)
+	{
+		const struct job *job = &batch.jobs[n];
+
+		if(job->ok)
+		{
+			MergeWaveStats(&total, &job->stats);
+			converted++;
+
+			if(profile)
+			{
+				print_profile(job->in, &job->profile);
+				MergeWaveProfile(&profile_total, &job->profile);
+			}
+		}
+		else
+		{
+			ret = EXIT_FAILURE;
+			failed++;
+		}
+
+		if(stats_file != NULL)
+		{
+			char path[4096];
+			const char *out = job->out;
+			double gain = job->gain;
+
+			if(out == NULL)
+			{
+				out = batch_out_path(path, sizeof(path),
+					batch_dir, job->in);
+			}
+
+			json_file(stats_file, n, job->in, out,
+				job->ok ? &job->stats : NULL,
+				opts.normalize != NORMALIZE_NONE ? &gain : NULL);
+
+			/* What merge_stats() needs to put the entry back in
+			 * input order and recompute the totals exactly. */
+			if(shard.count > 0)
+			{
+				fprintf(stats_file, ", \"index\": %lu", job->index);
+
+				if(job->ok)
+				{
+					fprintf(stats_file, ", \"sum\": %.17g, "
+						"\"sum_squares\": %.17g",
+						job->stats.sum,
+						job->stats.sumSquares);
+				}
+			}
+
+			fputc('}', stats_file);
+		}
+
+		if(verbose)
+		{
+			fprintf(stderr, "%s: %lu allocations, %lu system allocations, "
+				"%lu bytes peak\n", job->in, job->alloc_count,
+				job->system_alloc_count,
+				(unsigned long)job->arena_peak);
+		}
+	}
+
+	if(profile && converted > 1)
+		print_profile("total", &profile_total);
+
+	if(stats_file != NULL)
+		json_total(stats_file, converted, failed, &total);
+
+	if(depfile_path != NULL && write_depfile(depfile_path, &batch) != 0)
+	{
+		fprintf(stderr, "Unable to write %s\n", depfile_path);
+		ret = EXIT_FAILURE;
+	}
+
+	if(trace_path != NULL && trace_write(&trace, trace_path) != 0)
+	{
+		fprintf(stderr, "Unable to write %s\n", trace_path);
+		ret = EXIT_FAILURE;
+	}
+
+out:
+	if(stats_file != NULL && stats_file != stdout)
+		fclose(stats_file);
+
+	if(trace_path != NULL)
+		trace_free(&trace);
+
+	free(generated);
+	free(generated_names);
+	free(batch.order);
+	free(batch.jobs);
+	return ret;
 }
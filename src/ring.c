@@ -0,0 +1,344 @@
+/* Required for shm_open(), ftruncate(), nanosleep() and clock_gettime(). */
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ring.h>
+
+#ifdef _WIN32
+
+int ring_create(struct ring *r, const char *name, size_t capacity,
+		unsigned int sample_rate, unsigned int channels,
+		unsigned int bits)
+{
+	(void)r;
+	(void)name;
+	(void)capacity;
+	(void)sample_rate;
+	(void)channels;
+	(void)bits;
+
+	fprintf(stderr, "Shared memory output is not supported on Windows\n");
+	return -1;
+}
+
+int ring_open(struct ring *r, const char *name)
+{
+	(void)r;
+	(void)name;
+	return -1;
+}
+
+size_t ring_write(struct ring *r, const void *buf, size_t len,
+		unsigned int timeout_ms)
+{
+	(void)r;
+	(void)buf;
+	(void)len;
+	(void)timeout_ms;
+	return 0;
+}
+
+size_t ring_read(struct ring *r, void *buf, size_t len)
+{
+	(void)r;
+	(void)buf;
+	(void)len;
+	return 0;
+}
+
+void ring_finish(struct ring *r, enum ring_state state)
+{
+	(void)r;
+	(void)state;
+}
+
+enum ring_state ring_state(const struct ring *r)
+{
+	(void)r;
+	return RING_FAILED;
+}
+
+int ring_wait_drained(struct ring *r, unsigned int timeout_ms)
+{
+	(void)r;
+	(void)timeout_ms;
+	return -1;
+}
+
+void ring_close(struct ring *r)
+{
+	(void)r;
+}
+
+#else
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Time between checks of a ring that is full or not yet drained. */
+#define RING_POLL_US	100
+
+/* The layout is part of the protocol with consumers. */
+typedef char ring_header_size_check[sizeof(struct ring_header) == 192 ? 1 : -1];
+
+static uint64_t load_acquire(const uint64_t *p)
+{
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void store_release(uint64_t *p, uint64_t v)
+{
+	__atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static void ring_sleep(void)
+{
+	struct timespec ts = { 0, RING_POLL_US * 1000L };
+
+	nanosleep(&ts, NULL);
+}
+
+/* Returns a monotonic time in milliseconds. */
+static unsigned long long ring_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000ULL +
+		(unsigned long long)ts.tv_nsec / 1000000ULL;
+}
+
+int ring_create(struct ring *r, const char *name, size_t capacity,
+		unsigned int sample_rate, unsigned int channels,
+		unsigned int bits)
+{
+	size_t size = 1;
+	int fd;
+
+	while(size < capacity)
+		size <<= 1;
+
+	memset(r, 0, sizeof(*r));
+	r->map_size = sizeof(struct ring_header) + size;
+	r->name = malloc(strlen(name) + 1);
+	if(r->name == NULL)
+		return -1;
+
+	strcpy(r->name, name);
+	shm_unlink(name);
+
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if(fd < 0)
+	{
+		perror(name);
+		free(r->name);
+		return -1;
+	}
+
+	if(ftruncate(fd, (off_t)r->map_size) != 0)
+	{
+		perror(name);
+		close(fd);
+		shm_unlink(name);
+		free(r->name);
+		return -1;
+	}
+
+	r->header = mmap(NULL, r->map_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	close(fd);
+
+	if(r->header == MAP_FAILED)
+	{
+		perror(name);
+		shm_unlink(name);
+		free(r->name);
+		return -1;
+	}
+
+	r->data = (unsigned char *)(r->header + 1);
+	r->capacity = size;
+	memcpy(r->header->magic, RING_MAGIC, 4);
+	r->header->version = RING_VERSION;
+	r->header->sample_rate = sample_rate;
+	r->header->channels = channels;
+	r->header->bits = bits;
+	r->header->capacity = (uint32_t)size;
+	__atomic_store_n(&r->header->state, RING_STREAMING, __ATOMIC_RELEASE);
+	return 0;
+}
+
+int ring_open(struct ring *r, const char *name)
+{
+	struct ring_header h;
+	struct stat st;
+	void *p;
+	int fd;
+
+	memset(r, 0, sizeof(*r));
+
+	fd = shm_open(name, O_RDWR, 0);
+	if(fd < 0)
+		return -1;
+
+	if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(h))
+	{
+		close(fd);
+		return -1;
+	}
+
+	/* Map the header alone first to find the size of the data area. */
+	p = mmap(NULL, sizeof(h), PROT_READ, MAP_SHARED, fd, 0);
+	if(p == MAP_FAILED)
+	{
+		close(fd);
+		return -1;
+	}
+
+	memcpy(&h, p, sizeof(h));
+	h.state = __atomic_load_n(&((struct ring_header *)p)->state,
+		__ATOMIC_ACQUIRE);
+	munmap(p, sizeof(h));
+
+	/* The object may not be a ring, or be corrupt: only trust a capacity
+	 * that is a power of two the object is large enough for. */
+	if(h.state == RING_INIT || memcmp(h.magic, RING_MAGIC, 4) != 0 ||
+		h.version != RING_VERSION || h.capacity == 0 ||
+		(h.capacity & (h.capacity - 1)) != 0 ||
+		(uintmax_t)st.st_size - sizeof(h) < h.capacity)
+	{
+		close(fd);
+		return -1;
+	}
+
+	r->capacity = h.capacity;
+	r->map_size = sizeof(struct ring_header) + h.capacity;
+	r->header = mmap(NULL, r->map_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	close(fd);
+
+	if(r->header == MAP_FAILED)
+		return -1;
+
+	r->data = (unsigned char *)(r->header + 1);
+	return 0;
+}
+
+size_t ring_write(struct ring *r, const void *buf, size_t len,
+		unsigned int timeout_ms)
+{
+	struct ring_header *h = r->header;
+	const unsigned char *src = buf;
+	uint64_t write = h->write;
+	unsigned long long since = ring_now_ms();
+	size_t done = 0;
+
+	while(done < len)
+	{
+		uint64_t space = r->capacity - (write - load_acquire(&h->read));
+		size_t n = len - done;
+		size_t at = (size_t)(write & (r->capacity - 1));
+		size_t first;
+
+		if(space == 0)
+		{
+			if(ring_now_ms() - since >= timeout_ms)
+				break;
+
+			ring_sleep();
+			continue;
+		}
+
+		since = ring_now_ms();
+
+		if(n > space)
+			n = (size_t)space;
+
+		first = r->capacity - at;
+		if(first > n)
+			first = n;
+
+		memcpy(r->data + at, src + done, first);
+		memcpy(r->data, src + done + first, n - first);
+
+		write += n;
+		done += n;
+		store_release(&h->write, write);
+	}
+
+	return done;
+}
+
+size_t ring_read(struct ring *r, void *buf, size_t len)
+{
+	struct ring_header *h = r->header;
+	unsigned char *dst = buf;
+	uint64_t read = h->read;
+	uint64_t avail = load_acquire(&h->write) - read;
+	size_t at = (size_t)(read & (r->capacity - 1));
+	size_t first;
+
+	/* A producer can never be more than the capacity ahead. */
+	if(avail > r->capacity)
+		avail = r->capacity;
+
+	if(len > avail)
+		len = (size_t)avail;
+
+	first = r->capacity - at;
+	if(first > len)
+		first = len;
+
+	memcpy(dst, r->data + at, first);
+	memcpy(dst + first, r->data, len - first);
+	store_release(&h->read, read + len);
+	return len;
+}
+
+void ring_finish(struct ring *r, enum ring_state state)
+{
+	__atomic_store_n(&r->header->state, (uint32_t)state, __ATOMIC_RELEASE);
+}
+
+enum ring_state ring_state(const struct ring *r)
+{
+	return (enum ring_state)__atomic_load_n(&r->header->state,
+		__ATOMIC_ACQUIRE);
+}
+
+int ring_wait_drained(struct ring *r, unsigned int timeout_ms)
+{
+	unsigned long long since = ring_now_ms();
+
+	while(load_acquire(&r->header->read) != r->header->write)
+	{
+		if(ring_now_ms() - since >= timeout_ms)
+			return -1;
+
+		ring_sleep();
+	}
+
+	return 0;
+}
+
+void ring_close(struct ring *r)
+{
+	if(r->header != NULL)
+		munmap(r->header, r->map_size);
+
+	if(r->name != NULL)
+	{
+		shm_unlink(r->name);
+		free(r->name);
+	}
+
+	memset(r, 0, sizeof(*r));
+}
+
+#endif
@@ -0,0 +1,806 @@
+/* Required for sigwait(), struct sockaddr_un and MSG_NOSIGNAL. */
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+
+#include <server.h>
+
+#ifdef _WIN32
+
+int server_run(const char *path, unsigned int worker_count, int verbose)
+{
+	(void)path;
+	(void)worker_count;
+	(void)verbose;
+
+	fprintf(stderr, "The render server is not supported on Windows\n");
+	return -1;
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include <rfxgen.h>
+#include <thread.h>
+#include <trace.h>
+
+/* Arena of a worker; enough for the largest possible wave and its
+ * parameters, so that no request allocates once the worker is warm. */
+#define WORKER_ARENA_SIZE	(MAX_WAVE_LENGTH_SECONDS * WAVE_SAMPLE_RATE * \
+		sizeof(float) + 4096)
+
+/* Response buffer of a worker; enough for the header and WAV file of the
+ * largest possible wave. */
+#define WORKER_RESPONSE_SIZE	(SERVER_RESPONSE_SIZE + 64 + \
+		MAX_WAVE_LENGTH_SECONDS * WAVE_SAMPLE_RATE * 4)
+
+/* Bucket 0 counts latencies under 1 microsecond, bucket b latencies of
+ * 2^(b-1) up to 2^b microseconds. */
+#define LATENCY_BUCKETS		32
+
+struct latency
+{
+	unsigned long long count;
+	unsigned long long total;
+	unsigned long long min;
+	unsigned long long max;
+	unsigned long long buckets[LATENCY_BUCKETS];
+};
+
+/* Counters of the requests a worker served. */
+struct served
+{
+	unsigned long long commands[SERVER_STATS + 1];
+	unsigned long long errors;
+	/* From receiving the request header to sending the response. */
+	struct latency request;
+	/* Rendering and converting samples only. */
+	struct latency render;
+};
+
+struct server_worker
+{
+	struct thread thread;
+	struct server *server;
+	unsigned int index;
+	WaveArena arena;
+	/* Payload of the request being served. */
+	unsigned char payload[SERVER_MAX_PATH];
+	unsigned char *response;
+	/* Connection being served or -1, protected by the server lock. */
+	int fd;
+	struct mutex lock;
+	/* Protected by lock. */
+	struct served served;
+};
+
+struct server
+{
+	int fd;
+	/* Self-pipe that wakes every worker waiting for a connection once a
+	 * byte is written to it, when the server stops. */
+	int wake[2];
+	int verbose;
+	struct server_worker *workers;
+	unsigned int worker_count;
+	struct mutex lock;
+	/* Protected by lock. */
+	int stopping;
+};
+
+/* A decoded request header. */
+struct request
+{
+	enum server_command command;
+	enum server_output output;
+	WaveFormat format;
+	unsigned long length;
+};
+
+/* Text written into a fixed buffer, truncated if it does not fit. */
+struct text
+{
+	char *buf;
+	size_t len;
+	size_t cap;
+};
+
+static unsigned long get_u32(const unsigned char *p)
+{
+	return (unsigned long)p[0] | (unsigned long)p[1] << 8 |
+		(unsigned long)p[2] << 16 | (unsigned long)p[3] << 24;
+}
+
+static void put_u32(unsigned char *p, unsigned long v)
+{
+	p[0] = (unsigned char)(v & 0xFF);
+	p[1] = (unsigned char)((v >> 8) & 0xFF);
+	p[2] = (unsigned char)((v >> 16) & 0xFF);
+	p[3] = (unsigned char)((v >> 24) & 0xFF);
+}
+
+/* Reads exactly len bytes. Returns 0 on success, -1 if the connection was
+ * closed or failed. */
+static int read_full(int fd, void *buf, size_t len)
+{
+	unsigned char *p = buf;
+
+	while(len > 0)
+	{
+		ssize_t n = recv(fd, p, len, 0);
+
+		if(n < 0 && errno == EINTR)
+			continue;
+
+		if(n <= 0)
+			return -1;
+
+		p += n;
+		len -= (size_t)n;
+	}
+
+	return 0;
+}
+
+/* Writes exactly len bytes. Returns 0 on success. */
+static int write_full(int fd, const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+
+	while(len > 0)
+	{
+		ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+
+		if(n < 0 && errno == EINTR)
+			continue;
+
+		if(n <= 0)
+			return -1;
+
+		p += n;
+		len -= (size_t)n;
+	}
+
+	return 0;
+}
+
+static void text_printf(struct text *t, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	if(t->len >= t->cap)
+		return;
+
+	va_start(ap, fmt);
+	n = vsnprintf(t->buf + t->len, t->cap - t->len, fmt, ap);
+	va_end(ap);
+
+	if(n > 0)
+		t->len += (size_t)n;
+
+	if(t->len > t->cap)
+		t->len = t->cap;
+}
+
+static void latency_add(struct latency *l, unsigned long long ns)
+{
+	unsigned long long us = ns / 1000;
+	unsigned int b = 0;
+
+	while(us > 0 && b < LATENCY_BUCKETS - 1)
+	{
+		us >>= 1;
+		b++;
+	}
+
+	if(l->count == 0 || ns < l->min)
+		l->min = ns;
+
+	if(ns > l->max)
+		l->max = ns;
+
+	l->count++;
+	l->total += ns;
+	l->buckets[b]++;
+}
+
+static void latency_merge(struct latency *total, const struct latency *l)
+{
+	unsigned int b;
+
+	if(l->count == 0)
+		return;
+
+	if(total->count == 0 || l->min < total->min)
+		total->min = l->min;
+
+	if(l->max > total->max)
+		total->max = l->max;
+
+	total->count += l->count;
+	total->total += l->total;
+
+	for(b = 0; b < LATENCY_BUCKETS; b++)
+		total->buckets[b] += l->buckets[b];
+}
+
+/* Returns the upper bound in microseconds of the bucket holding fraction p of
+ * the latencies, which is exact to within a factor of two. */
+static double latency_percentile(const struct latency *l, double p)
+{
+	unsigned long long rank = (unsigned long long)(p * (double)l->count);
+	unsigned long long seen = 0;
+	unsigned int b;
+
+	for(b = 0; b < LATENCY_BUCKETS; b++)
+	{
+		seen += l->buckets[b];
+		if(seen > rank)
+			break;
+	}
+
+	/* Bucket bounds beyond the largest latency are meaningless. */
+	if((double)(1ULL << b) > l->max / 1e3)
+		return l->max / 1e3;
+
+	return (double)(1ULL << b);
+}
+
+static void json_latency(struct text *t, const char *name,
+		const struct latency *l)
+{
+	unsigned int b;
+	int first = 1;
+
+	text_printf(t, "\"%s\": {\"count\": %llu", name, l->count);
+
+	if(l->count > 0)
+	{
+		text_printf(t, ", \"min\": %.3f, \"mean\": %.3f, \"max\": %.3f, "
+			"\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f",
+			l->min / 1e3, l->total / 1e3 / (double)l->count,
+			l->max / 1e3, latency_percentile(l, 0.5),
+			latency_percentile(l, 0.9), latency_percentile(l, 0.99));
+	}
+
+	text_printf(t, ", \"buckets\": [");
+
+	for(b = 0; b < LATENCY_BUCKETS; b++)
+	{
+		if(l->buckets[b] == 0)
+			continue;
+
+		text_printf(t, "%s{\"lt\": %llu, \"count\": %llu}",
+			first ? "" : ", ", 1ULL << b, l->buckets[b]);
+		first = 0;
+	}
+
+	text_printf(t, "]}");
+}
+
+/* Writes the counters of all workers as JSON into buf. Returns its length. */
+static size_t format_stats(struct server *s, char *buf, size_t cap)
+{
+	struct text t = { buf, 0, cap };
+	struct served total;
+	unsigned int i, c;
+
+	memset(&total, 0, sizeof(total));
+
+	for(i = 0; i < s->worker_count; i++)
+	{
+		struct server_worker *w = &s->workers[i];
+
+		mutex_lock(&w->lock);
+
+		for(c = 0; c <= SERVER_STATS; c++)
+			total.commands[c] += w->served.commands[c];
+
+		total.errors += w->served.errors;
+		latency_merge(&total.request, &w->served.request);
+		latency_merge(&total.render, &w->served.render);
+		mutex_unlock(&w->lock);
+	}
+
+	text_printf(&t, "{\"workers\": %u, \"kernel\": \"%s\", "
+		"\"requests\": {\"render_params\": %llu, \"render_file\": %llu, "
+		"\"stats\": %llu, \"errors\": %llu},\n"
+		"\"latency_us\": {", s->worker_count, GetActiveWaveKernel(),
+		total.commands[SERVER_RENDER_PARAMS],
+		total.commands[SERVER_RENDER_FILE],
+		total.commands[SERVER_STATS], total.errors);
+	json_latency(&t, "request", &total.request);
+	text_printf(&t, ",\n");
+	json_latency(&t, "render", &total.render);
+	text_printf(&t, "}}\n");
+
+	return t.len;
+}
+
+/* Decodes and checks a request header. Returns an error message, or NULL if
+ * the request is valid. */
+static const char *parse_request(const unsigned char *h, struct request *r)
+{
+	unsigned long bits;
+
+	if(memcmp(h, SERVER_MAGIC, 4) != 0)
+		return "bad magic";
+
+	r->command = (enum server_command)h[4];
+	r->output = (enum server_output)h[5];
+	r->format.sampleSize = h[6];
+	r->format.normalize = (WaveNormalize)h[7];
+	bits = get_u32(h + 8);
+	memcpy(&r->format.targetDb, &bits, sizeof(r->format.targetDb));
+	r->length = get_u32(h + 12);
+
+	switch(r->command)
+	{
+	case SERVER_RENDER_PARAMS:
+		if(r->length != sizeof(WaveParams))
+			return "parameters must be 96 bytes";
+		break;
+
+	case SERVER_RENDER_FILE:
+		if(r->length == 0 || r->length >= SERVER_MAX_PATH)
+			return "bad path length";
+		break;
+
+	case SERVER_STATS:
+		if(r->length != 0)
+			return "unexpected payload";
+		return NULL;
+
+	default:
+		return "unknown command";
+	}
+
+	if(r->output != SERVER_OUTPUT_WAV && r->output != SERVER_OUTPUT_PCM)
+		return "unknown output";
+
+	if(r->format.sampleSize != 8 && r->format.sampleSize != 16 &&
+		r->format.sampleSize != 24 && r->format.sampleSize != 32)
+		return "bits per sample must be 8, 16, 24 or 32";
+
+	if(r->format.normalize > WAVE_NORMALIZE_RMS)
+		return "unknown normalization";
+
+	return NULL;
+}
+
+/* Renders the effect of a request into the response buffer of the worker,
+ * after the header, and stores the length of the output in len. Returns 0 on
+ * success. */
+static int render(struct server_worker *w, const struct request *r,
+		size_t *len)
+{
+	WaveAllocator allocator = GetWaveArenaAllocator(&w->arena);
+	unsigned char *out = w->response + SERVER_RESPONSE_SIZE;
+	size_t cap = WORKER_RESPONSE_SIZE - SERVER_RESPONSE_SIZE;
+	WaveParams wp;
+	int ret = -1;
+
+	*len = 0;
+
+	if(r->command == SERVER_RENDER_FILE)
+	{
+		WaveParams *loaded;
+
+		w->payload[r->length] = '\0';
+		loaded = LoadWaveParams((const char *)w->payload, &allocator);
+		if(loaded == NULL)
+			return -1;
+
+		wp = *loaded;
+	}
+	else
+		memcpy(&wp, w->payload, sizeof(wp));
+
+	if(r->output == SERVER_OUTPUT_WAV)
+	{
+		*len = ExportWaveToBuffer(&wp, r->format, &allocator, out, cap);
+		if(*len > 0 && *len <= cap)
+			ret = 0;
+	}
+	else
+	{
+		WaveStats stats;
+		Wave wave = GenerateWaveEx(&wp, &allocator, &stats, NULL, NULL);
+		float gain = 1.0f;
+
+		if(r->format.normalize == WAVE_NORMALIZE_PEAK)
+			gain = GetWavePeakGain(&stats, r->format.targetDb);
+		else if(r->format.normalize == WAVE_NORMALIZE_RMS)
+			gain = GetWaveRmsGain(&stats, r->format.targetDb);
+
+		if(wave.data != NULL || wave.sampleCount == 0)
+		{
+			*len = ConvertWaveSamples(out, wave.data, wave.sampleCount,
+				r->format.sampleSize, gain);
+			ret = 0;
+		}
+
+		UnloadWave(wave, &allocator);
+	}
+
+	ResetWaveArena(&w->arena);
+	return ret;
+}
+
+/* Sends a response of len bytes already in the response buffer. */
+static int respond(struct server_worker *w, int fd, enum server_status status,
+		size_t len)
+{
+	put_u32(w->response, status);
+	put_u32(w->response + 4, (unsigned long)len);
+	return write_full(fd, w->response, SERVER_RESPONSE_SIZE + len);
+}
+
+/* Sends an error response with a message. */
+static int respond_error(struct server_worker *w, int fd,
+		enum server_status status, const char *msg)
+{
+	size_t len = strlen(msg);
+
+	memcpy(w->response + SERVER_RESPONSE_SIZE, msg, len);
+	return respond(w, fd, status, len);
+}
+
+/* Serves requests on a connection until it is closed or a request is
+ * malformed. */
+static void serve(struct server_worker *w, int fd)
+{
+	static const char *const names[] = {
+		"render_params", "render_file", "stats"
+	};
+	struct server *s = w->server;
+
+	for(;;)
+	{
+		unsigned char header[SERVER_REQUEST_SIZE];
+		unsigned long long start, render_start, render_ns = 0;
+		enum server_status status = SERVER_OK;
+		struct request r;
+		const char *error;
+		size_t len;
+		int ret;
+
+		if(read_full(fd, header, sizeof(header)) != 0)
+			return;
+
+		start = trace_now();
+		error = parse_request(header, &r);
+
+		if(error != NULL)
+		{
+			mutex_lock(&w->lock);
+			w->served.errors++;
+			mutex_unlock(&w->lock);
+
+			respond_error(w, fd, SERVER_BAD_REQUEST, error);
+			return;
+		}
+
+		if(read_full(fd, w->payload, r.length) != 0)
+			return;
+
+		if(r.command == SERVER_STATS)
+		{
+			len = format_stats(s, (char *)w->response +
+				SERVER_RESPONSE_SIZE,
+				WORKER_RESPONSE_SIZE - SERVER_RESPONSE_SIZE);
+		}
+		else
+		{
+			render_start = trace_now();
+			ret = render(w, &r, &len);
+			render_ns = trace_now() - render_start;
+
+			if(ret != 0)
+			{
+				status = SERVER_RENDER_FAILED;
+				len = strlen("render failed");
+				memcpy(w->response + SERVER_RESPONSE_SIZE,
+					"render failed", len);
+			}
+		}
+
+		ret = respond(w, fd, status, len);
+
+		mutex_lock(&w->lock);
+		w->served.commands[r.command]++;
+		if(status != SERVER_OK)
+			w->served.errors++;
+		else if(r.command != SERVER_STATS)
+			latency_add(&w->served.render, render_ns);
+		latency_add(&w->served.request, trace_now() - start);
+		mutex_unlock(&w->lock);
+
+		if(s->verbose)
+		{
+			fprintf(stderr, "worker %u: %s, %lu bytes in %.3f ms%s\n",
+				w->index, names[r.command], (unsigned long)len,
+				(trace_now() - start) / 1e6,
+				status != SERVER_OK ? ", failed" : "");
+		}
+
+		if(ret != 0)
+			return;
+	}
+}
+
+/* Makes an accepted connection blocking, as it may inherit O_NONBLOCK from
+ * the listening socket, with timeouts so that the connection is closed once
+ * the client has neither sent nor read anything for SERVER_IDLE_TIMEOUT
+ * seconds. Idle clients then cannot hold every worker. */
+static int prepare_connection(int fd)
+{
+	struct timeval timeout;
+	int flags = fcntl(fd, F_GETFL);
+
+	timeout.tv_sec = SERVER_IDLE_TIMEOUT;
+	timeout.tv_usec = 0;
+
+	if(flags < 0 || fcntl(fd, F_SETFL, flags & ~O_NONBLOCK) != 0)
+		return -1;
+
+	if(setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+		sizeof(timeout)) != 0)
+		return -1;
+
+	return setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+		sizeof(timeout));
+}
+
+/* Accepts and serves connections until the server stops. The listening socket
+ * is non-blocking: every waiting worker wakes for a connection and all but
+ * one find nothing to accept. */
+static void worker_main(void *arg)
+{
+	struct server_worker *w = arg;
+	struct server *s = w->server;
+
+	for(;;)
+	{
+		struct pollfd fds[2];
+		int fd, stopping;
+
+		fds[0].fd = s->fd;
+		fds[0].events = POLLIN;
+		fds[1].fd = s->wake[0];
+		fds[1].events = POLLIN;
+
+		if(poll(fds, 2, -1) < 0)
+		{
+			if(errno != EINTR)
+			{
+				perror("poll");
+				break;
+			}
+
+			continue;
+		}
+
+		if(fds[1].revents != 0)
+			break;
+
+		fd = accept(s->fd, NULL, NULL);
+		if(fd < 0)
+		{
+			if(errno != EAGAIN && errno != EWOULDBLOCK &&
+				errno != EINTR && errno != ECONNABORTED)
+				perror("accept");
+
+			continue;
+		}
+
+		mutex_lock(&s->lock);
+		stopping = s->stopping;
+		if(!stopping)
+			w->fd = fd;
+		mutex_unlock(&s->lock);
+
+		if(stopping)
+		{
+			close(fd);
+			break;
+		}
+
+		if(prepare_connection(fd) == 0)
+			serve(w, fd);
+		else
+			perror("setsockopt");
+
+		mutex_lock(&s->lock);
+		w->fd = -1;
+		mutex_unlock(&s->lock);
+		close(fd);
+	}
+}
+
+/* Stops the workers: ends the connections being served and wakes workers
+ * waiting for a connection through the self-pipe, which stays readable. */
+static void stop_workers(struct server *s)
+{
+	unsigned int i;
+	ssize_t n;
+
+	mutex_lock(&s->lock);
+	s->stopping = 1;
+
+	for(i = 0; i < s->worker_count; i++)
+	{
+		if(s->workers[i].fd >= 0)
+			shutdown(s->workers[i].fd, SHUT_RDWR);
+	}
+
+	mutex_unlock(&s->lock);
+
+	do
+		n = write(s->wake[1], "", 1);
+	while(n < 0 && errno == EINTR);
+
+	if(n != 1)
+		perror("write");
+}
+
+int server_run(const char *path, unsigned int worker_count, int verbose)
+{
+	struct server s;
+	struct sockaddr_un addr;
+	sigset_t signals, old;
+	unsigned int ready, started = 0, i;
+	int sig, ret = -1;
+
+	if(strlen(path) >= sizeof(addr.sun_path))
+	{
+		fprintf(stderr, "Socket path %s is too long\n", path);
+		return -1;
+	}
+
+	if(worker_count == 0)
+		worker_count = 1;
+	else if(worker_count > SERVER_MAX_WORKERS)
+		worker_count = SERVER_MAX_WORKERS;
+
+	memset(&s, 0, sizeof(s));
+	s.fd = -1;
+	s.wake[0] = -1;
+	s.wake[1] = -1;
+	s.verbose = verbose;
+	s.workers = calloc(worker_count, sizeof(*s.workers));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if(s.workers == NULL || mutex_init(&s.lock) != 0)
+	{
+		fprintf(stderr, "Unable to allocate memory.\n");
+		free(s.workers);
+		return -1;
+	}
+
+	if(pipe(s.wake) != 0)
+	{
+		perror("pipe");
+		goto out;
+	}
+
+	s.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(s.fd < 0 || fcntl(s.fd, F_SETFL, O_NONBLOCK) != 0)
+	{
+		perror("socket");
+		goto out;
+	}
+
+	unlink(path);
+
+	if(bind(s.fd, (const struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+		listen(s.fd, SOMAXCONN) != 0)
+	{
+		fprintf(stderr, "Unable to listen on %s: %s\n", path,
+			strerror(errno));
+		goto out;
+	}
+
+	/* Workers inherit the mask, so that only sigwait() below receives
+	 * the signals that stop the server. */
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, &old);
+
+	/* Every worker is ready before any starts, as a stats request reads
+	 * the counters of all of them. */
+	for(ready = 0; ready < worker_count; ready++)
+	{
+		struct server_worker *w = &s.workers[ready];
+
+		w->server = &s;
+		w->index = ready;
+		w->fd = -1;
+		w->response = malloc(WORKER_RESPONSE_SIZE);
+
+		if(w->response == NULL ||
+			InitWaveArena(&w->arena, WORKER_ARENA_SIZE) == false)
+		{
+			free(w->response);
+			break;
+		}
+
+		if(mutex_init(&w->lock) != 0)
+		{
+			FreeWaveArena(&w->arena);
+			free(w->response);
+			break;
+		}
+	}
+
+	s.worker_count = ready;
+
+	while(started < ready &&
+		thread_start(&s.workers[started].thread, worker_main,
+			&s.workers[started]) == 0)
+		started++;
+
+	if(started == 0)
+		fprintf(stderr, "Unable to start workers.\n");
+	else
+	{
+		if(verbose)
+		{
+			fprintf(stderr, "Listening on %s with %u workers\n", path,
+				started);
+		}
+
+		sigwait(&signals, &sig);
+
+		if(verbose)
+			fprintf(stderr, "Stopping on signal %d\n", sig);
+
+		stop_workers(&s);
+		ret = 0;
+	}
+
+	for(i = 0; i < ready; i++)
+	{
+		if(i < started)
+			thread_join(&s.workers[i].thread);
+
+		mutex_free(&s.workers[i].lock);
+		FreeWaveArena(&s.workers[i].arena);
+		free(s.workers[i].response);
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	unlink(path);
+
+out:
+	if(s.fd >= 0)
+		close(s.fd);
+
+	for(i = 0; i < 2; i++)
+	{
+		if(s.wake[i] >= 0)
+			close(s.wake[i]);
+	}
+
+	mutex_free(&s.lock);
+	free(s.workers);
+	return ret;
+}
+
+#endif
@@ -0,0 +1,110 @@
+/* Required for sysconf(_SC_NPROCESSORS_ONLN) and the pthread types. */
+#define _DEFAULT_SOURCE
+
+#include <thread.h>
+
+#ifdef _WIN32
+
+static DWORD WINAPI thread_main(LPVOID param)
+{
+	struct thread *t = param;
+
+	t->fn(t->arg);
+	return 0;
+}
+
+int thread_start(struct thread *t, void (*fn)(void *arg), void *arg)
+{
+	t->fn = fn;
+	t->arg = arg;
+	t->handle = CreateThread(NULL, 0, thread_main, t, 0, NULL);
+	return t->handle == NULL;
+}
+
+void thread_join(struct thread *t)
+{
+	WaitForSingleObject(t->handle, INFINITE);
+	CloseHandle(t->handle);
+}
+
+unsigned int thread_cpu_count(void)
+{
+	SYSTEM_INFO si;
+
+	GetSystemInfo(&si);
+	return si.dwNumberOfProcessors > 0 ? si.dwNumberOfProcessors : 1;
+}
+
+int mutex_init(struct mutex *m)
+{
+	InitializeCriticalSection(&m->cs);
+	return 0;
+}
+
+void mutex_free(struct mutex *m)
+{
+	DeleteCriticalSection(&m->cs);
+}
+
+void mutex_lock(struct mutex *m)
+{
+	EnterCriticalSection(&m->cs);
+}
+
+void mutex_unlock(struct mutex *m)
+{
+	LeaveCriticalSection(&m->cs);
+}
+
+#else
+
+#include <unistd.h>
+
+static void *thread_main(void *param)
+{
+	struct thread *t = param;
+
+	t->fn(t->arg);
+	return NULL;
+}
+
+int thread_start(struct thread *t, void (*fn)(void *arg), void *arg)
+{
+	t->fn = fn;
+	t->arg = arg;
+	return pthread_create(&t->handle, NULL, thread_main, t);
+}
+
+void thread_join(struct thread *t)
+{
+	pthread_join(t->handle, NULL);
+}
+
+unsigned int thread_cpu_count(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return n > 0 ? (unsigned int)n : 1;
+}
+
+int mutex_init(struct mutex *m)
+{
+	return pthread_mutex_init(&m->m, NULL);
+}
+
+void mutex_free(struct mutex *m)
+{
+	pthread_mutex_destroy(&m->m);
+}
+
+void mutex_lock(struct mutex *m)
+{
+	pthread_mutex_lock(&m->m);
+}
+
+void mutex_unlock(struct mutex *m)
+{
+	pthread_mutex_unlock(&m->m);
+}
+
+#endif
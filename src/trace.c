@@ -0,0 +1,172 @@
+/* Required for clock_gettime(). */
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <time.h>
+#endif
+
+#include <trace.h>
+
+/* Spans a thread buffer grows by when it is full. */
+#define TRACE_GROW	1024
+
+int trace_init(struct trace *t, unsigned int thread_count)
+{
+	t->threads = calloc(thread_count, sizeof(*t->threads));
+	if(t->threads == NULL)
+		return -1;
+
+	t->thread_count = thread_count;
+	t->origin = trace_now();
+	return 0;
+}
+
+void trace_free(struct trace *t)
+{
+	unsigned int i;
+
+	for(i = 0; i < t->thread_count; i++)
+		free(t->threads[i].events);
+
+	free(t->threads);
+	t->threads = NULL;
+	t->thread_count = 0;
+}
+
+unsigned long long trace_now(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq, count;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (unsigned long long)((double)count.QuadPart * 1e9 /
+		(double)freq.QuadPart);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL +
+		(unsigned long long)ts.tv_nsec;
+#endif
+}
+
+unsigned long long trace_begin(const struct trace_thread *tt)
+{
+	return tt != NULL ? trace_now() : 0;
+}
+
+unsigned long long trace_span(struct trace *t, struct trace_thread *tt,
+		const char *name, const char *file, unsigned long long start)
+{
+	struct trace_event *e;
+	unsigned long long end;
+
+	if(tt == NULL)
+		return 0;
+
+	end = trace_now();
+
+	if(tt->count == tt->capacity)
+	{
+		size_t capacity = tt->capacity + TRACE_GROW;
+		e = realloc(tt->events, capacity * sizeof(*e));
+		if(e == NULL)
+		{
+			tt->dropped++;
+			return end;
+		}
+
+		tt->events = e;
+		tt->capacity = capacity;
+	}
+
+	e = &tt->events[tt->count++];
+	e->name = name;
+	e->file = file;
+	e->start = start - t->origin;
+	e->duration = end - start;
+	return end;
+}
+
+static void write_string(FILE *f, const char *s)
+{
+	fputc('"', f);
+
+	for(; *s != '\0'; s++)
+	{
+		unsigned char c = (unsigned char)*s;
+
+		if(c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if(c < 0x20)
+			fprintf(f, "\\u%04x", c);
+		else
+			fputc(c, f);
+	}
+
+	fputc('"', f);
+}
+
+int trace_write(const struct trace *t, const char *path)
+{
+	FILE *f = fopen(path, "w");
+	unsigned int i;
+	size_t n;
+	int ret;
+
+	if(f == NULL)
+		return -1;
+
+	fputs("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n"
+		"{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, "
+		"\"args\": {\"name\": \"rfx2wav\"}}", f);
+
+	for(i = 0; i < t->thread_count; i++)
+	{
+		const struct trace_thread *tt = &t->threads[i];
+
+		fprintf(f, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", "
+			"\"pid\": 1, \"tid\": %u, \"args\": {\"name\": "
+			"\"worker %u\"}}", i, i);
+
+		for(n = 0; n < tt->count; n++)
+		{
+			const struct trace_event *e = &tt->events[n];
+
+			/* Timestamps are in microseconds. */
+			fprintf(f, ",\n{\"name\": \"%s\", \"ph\": \"X\", "
+				"\"pid\": 1, \"tid\": %u, \"ts\": %.3f, "
+				"\"dur\": %.3f", e->name, i, e->start / 1e3,
+				e->duration / 1e3);
+
+			if(e->file != NULL)
+			{
+				fputs(", \"args\": {\"file\": ", f);
+				write_string(f, e->file);
+				fputc('}', f);
+			}
+
+			fputc('}', f);
+		}
+
+		if(tt->dropped > 0)
+		{
+			fprintf(stderr, "Trace of worker %u is missing %lu spans\n",
+				i, (unsigned long)tt->dropped);
+		}
+	}
+
+	fputs("\n]}\n", f);
+
+	ret = ferror(f) ? -1 : 0;
+	if(fclose(f) != 0)
+		ret = -1;
+
+	return ret;
+}
@@ -0,0 +1,239 @@
+/* Required for poll(), clock_gettime() and the dirent types. */
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <watch.h>
+
+#ifndef __linux__
+
+int watch_run(const char *dir, const char *suffix, watch_fn changed,
+		void *arg)
+{
+	(void)dir;
+	(void)suffix;
+	(void)changed;
+	(void)arg;
+
+	fprintf(stderr, "Watching directories is only supported on Linux\n");
+	return -1;
+}
+
+#else
+
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+/* Names of files changed during the current burst. */
+struct pending
+{
+	char **names;
+	size_t count;
+	size_t capacity;
+	/* Time of the first change of the burst. */
+	unsigned long long since;
+};
+
+static unsigned long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000ULL +
+		(unsigned long long)ts.tv_nsec / 1000000ULL;
+}
+
+static int has_suffix(const char *name, const char *suffix)
+{
+	size_t n = strlen(name), s = strlen(suffix);
+
+	return n > s && strcmp(name + n - s, suffix) == 0;
+}
+
+static int add_pending(struct pending *p, const char *name)
+{
+	if(p->count == p->capacity)
+	{
+		size_t capacity = p->capacity > 0 ? p->capacity * 2 : 16;
+		char **names = realloc(p->names, capacity * sizeof(*names));
+
+		if(names == NULL)
+			return -1;
+
+		p->names = names;
+		p->capacity = capacity;
+	}
+
+	p->names[p->count] = malloc(strlen(name) + 1);
+	if(p->names[p->count] == NULL)
+		return -1;
+
+	strcpy(p->names[p->count], name);
+
+	if(p->count++ == 0)
+		p->since = now_ms();
+
+	return 0;
+}
+
+/* Adds every file in dir ending with suffix. */
+static int add_all(struct pending *p, const char *dir, const char *suffix)
+{
+	DIR *d = opendir(dir);
+	struct dirent *e;
+	int ret = 0;
+
+	if(d == NULL)
+		return -1;
+
+	while(ret == 0 && (e = readdir(d)) != NULL)
+	{
+		if(has_suffix(e->d_name, suffix))
+			ret = add_pending(p, e->d_name);
+	}
+
+	closedir(d);
+	return ret;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Reports each pending file once and starts a new burst. */
+static void flush_pending(struct pending *p, const char *dir, watch_fn changed,
+		void *arg)
+{
+	char path[4096];
+	size_t i;
+
+	qsort(p->names, p->count, sizeof(*p->names), compare_names);
+
+	for(i = 0; i < p->count; i++)
+	{
+		int n;
+
+		if(i > 0 && strcmp(p->names[i], p->names[i - 1]) == 0)
+			continue;
+
+		n = snprintf(path, sizeof(path), "%s/%s", dir, p->names[i]);
+		if(n > 0 && (size_t)n < sizeof(path))
+			changed(path, arg);
+	}
+
+	for(i = 0; i < p->count; i++)
+		free(p->names[i]);
+
+	p->count = 0;
+}
+
+/* Reads the pending events of fd. Returns -1 on error. */
+static int read_events(int fd, struct pending *p, const char *dir,
+		const char *suffix)
+{
+	/* Aligned for struct inotify_event, as inotify(7) recommends. */
+	char buf[65536] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len = read(fd, buf, sizeof(buf));
+	ssize_t off;
+
+	if(len < 0)
+		return errno == EINTR || errno == EAGAIN ? 0 : -1;
+
+	for(off = 0; off < len; )
+	{
+		const struct inotify_event *e =
+			(const struct inotify_event *)(buf + off);
+
+		if(e->mask & IN_Q_OVERFLOW)
+		{
+			fprintf(stderr, "Missed changes in %s, converting "
+				"everything\n", dir);
+			if(add_all(p, dir, suffix) != 0)
+				return -1;
+		}
+		else if(e->len > 0 && has_suffix(e->name, suffix) &&
+			add_pending(p, e->name) != 0)
+			return -1;
+
+		off += (ssize_t)(sizeof(*e) + e->len);
+	}
+
+	return 0;
+}
+
+int watch_run(const char *dir, const char *suffix, watch_fn changed,
+		void *arg)
+{
+	struct pending p = { NULL, 0, 0, 0 };
+	struct pollfd pfd;
+	int ret = -1;
+
+	pfd.fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+	pfd.events = POLLIN;
+
+	if(pfd.fd < 0)
+	{
+		perror("inotify_init1");
+		return -1;
+	}
+
+	/* Editors either rewrite a file in place or rename a new one over
+	 * it; either way, the file is complete once one of these arrives. */
+	if(inotify_add_watch(pfd.fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		fprintf(stderr, "Unable to watch %s: %s\n", dir,
+			strerror(errno));
+		goto out;
+	}
+
+	for(;;)
+	{
+		int timeout = -1;
+		int n;
+
+		if(p.count > 0)
+		{
+			unsigned long long age = now_ms() - p.since;
+
+			timeout = age >= WATCH_MAX_DELAY_MS ? 0 :
+				(int)(WATCH_MAX_DELAY_MS - age);
+			if(timeout > WATCH_QUIET_MS)
+				timeout = WATCH_QUIET_MS;
+		}
+
+		n = poll(&pfd, 1, timeout);
+
+		if(n < 0 && errno != EINTR)
+		{
+			perror("poll");
+			break;
+		}
+
+		if(n > 0 && read_events(pfd.fd, &p, dir, suffix) != 0)
+		{
+			perror(dir);
+			break;
+		}
+
+		if(n == 0 || (p.count > 0 &&
+			now_ms() - p.since >= WATCH_MAX_DELAY_MS))
+			flush_pending(&p, dir, changed, arg);
+	}
+
+out:
+	for(; p.count > 0; p.count--)
+		free(p.names[p.count - 1]);
+
+	free(p.names);
+	close(pfd.fd);
+	return ret;
+}
+
+#endif